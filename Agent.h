@@ -1,8 +1,19 @@
 #ifndef AGENT_H
 #define AGENT_H
 
+#include <stddef.h>
 #include <stdint.h>
 
+#include "Field.h"
+#include "FieldOled.h"
+#include "FieldOledDirty.h"
+#include "HuntTarget.h"
+#include "Journal.h"
+#include "Parity.h"
+#include "Protocol.h"
+#include "Scheduler.h"
+#include "Targeting.h"
+
 /**
  * Defines the various states used within the agent state machines. All states should be used
  * within a valid agent implementation. Additionally there is no need for states outside of
@@ -38,14 +49,142 @@ typedef enum {
  * when errors occur:
  *   * AGENT_ERROR_STRING_NEG_DATA: Displayed when the negotiation data from the opponent didn't
  *                                     validate, as in they cheated.
- *   * AGENT_ERROR_STRING_PARSING: Displayed whenever a message fails to parse. This should happen
+ *   * AGENT_ERROR_STRING_PARSING: Displayed whenever a message fails to parse during the game and
+ *                                 the opponent can't be asked to send it again. This should happen
  *                                 very rarely, so we treat it as a game-ending fatal error.
  *   * AGENT_ERROR_STRING_ORDERING: Displayed when turn ordering results in a tie. Also a very rare
  *                                  occurance, so treated as a fatal error.
+ *   * AGENT_ERROR_STRING_LINK: Displayed when the opponent hasn't answered AGENT_MAX_RETRIES NAKs
+ *                              in a row.
  */
 #define AGENT_ERROR_STRING_NEG_DATA "Received invalid\nnegotiation data"
 #define AGENT_ERROR_STRING_PARSING     "Message parsing\nfailed"
 #define AGENT_ERROR_STRING_ORDERING    "Turn ordering\nfailed"
+#define AGENT_ERROR_STRING_LINK        "Lost contact with\nthe opponent"
+
+/**
+ * When both agents offered PROTOCOL_NEGOTIATION_NAK, a message that fails to parse doesn't end the
+ * game. Instead the agent sends a NAK, and the opponent answers it by sending its last
+ * AGENT_RESEND_MESSAGES messages again, except for a COO it already has the HIT for. Messages that
+ * are lost without a trace are caught by a timeout: an agent that has waited on its opponent for
+ * AGENT_RETRY_TICKS sends a NAK of its own, and gives up after AGENT_MAX_RETRIES of them in a row
+ * go unanswered. A message that arrives twice is recognized by its contents: a COO whose HIT never
+ * arrived, or a CHA whose DET never did, is answered again, and anything else is ignored. A COO for
+ * the cell last fired at that arrives once the agent is waiting for the next shot is a new shot at
+ * the same cell, and is answered like any other.
+ *
+ * An agent that has won or lost still answers NAKs and messages that arrive twice, so it should be
+ * kept running after the game, in case its last message didn't get through.
+ *
+ * Until the turn order is settled it isn't known whether the opponent understands NAKs, so instead
+ * the CHA and DET messages are simply sent again every AGENT_RETRY_TICKS for as long as the
+ * opponent's are missing. This also lets the two agents be started at different times.
+ */
+#define AGENT_RETRY_TICKS SCHEDULER_MS_TO_TICKS(1000)
+#define AGENT_MAX_RETRIES 8
+#define AGENT_RESEND_MESSAGES 2
+
+/**
+ * The ways the agent can choose where to fire next:
+ *   * AGENT_POLICY_RANDOM: Fire at a uniformly random cell that hasn't been tried yet.
+ *   * AGENT_POLICY_DENSITY: Fire at the cell covered by the most legal boat placements, see
+ *                           Targeting.h. This is the default.
+ *   * AGENT_POLICY_SAMPLING: Fire at the cell holding a boat in the most randomly drawn fleets
+ *                            that fit what's known, see Sampler.h. Falls back to
+ *                            AGENT_POLICY_DENSITY when no such fleet turns up.
+ *   * AGENT_POLICY_HUNT_TARGET: Hunt on a lattice until something is hit, then finish off the
+ *                               boat along its axis, see HuntTarget.h.
+ *   * AGENT_POLICY_PARITY: Target like AGENT_POLICY_HUNT_TARGET, but hunt at a random cell of the
+ *                          lattice in constant time, see Parity.h.
+ */
+typedef enum {
+    AGENT_POLICY_RANDOM,
+    AGENT_POLICY_DENSITY,
+    AGENT_POLICY_SAMPLING,
+    AGENT_POLICY_HUNT_TARGET,
+    AGENT_POLICY_PARITY
+} AgentPolicy;
+
+/**
+ * Where the agent's fleet layout comes from:
+ *   * AGENT_FLEET_UNIFORM: Each boat at a uniformly random spot, see PlacementFleet().
+ *   * AGENT_FLEET_TABLE: A layout from the table of those that are hardest to find, see
+ *                        PlacementFromTable(). This is the default, unless the table is empty for
+ *                        this field, in which case AGENT_FLEET_UNIFORM is used instead.
+ */
+typedef enum {
+    AGENT_FLEET_UNIFORM,
+    AGENT_FLEET_TABLE
+} AgentFleet;
+
+/**
+ * Contexts are aligned to whole cache lines on the host, so that games running on different threads
+ * never share one. The PIC32 has no data cache, so there it's only word-aligned.
+ */
+#ifdef HOST_BUILD
+#define AGENT_CONTEXT_ALIGNMENT 64
+#else
+#define AGENT_CONTEXT_ALIGNMENT 4
+#endif
+
+/**
+ * Draws an agent's game as it goes, see AgentContextSetDisplay(). Each function is handed
+ * everything it draws, so that an agent only ever touches the display it was given.
+ */
+typedef struct {
+    // Replaces the whole screen with an error message.
+    void (*drawError)(const char *message);
+    // Draws both fields and whose turn it is over the whole screen.
+    void (*drawScreen)(const Field *myField, const Field *theirField, FieldOledTurn turn);
+    // Redraws the cell (row, col) of one of the fields after a shot, and whose turn it is now.
+    void (*drawShot)(const Field *f, FieldOledDirtySide side, uint8_t row, uint8_t col,
+            FieldOledTurn turn);
+} AgentDisplay;
+
+// The OLED of the Uno32, which AgentInit() gives the built-in agent. Its screen buffer and the
+// transfer to the display are shared, so only one agent may draw on it at a time.
+extern const AgentDisplay agentOledDisplay;
+
+/**
+ * AgentContext holds everything one agent needs to play a game: both fields, the negotiation data,
+ * the parser for its incoming message stream, its state machine and its own random number
+ * generator. Contexts share nothing with each other, so any number of games can be played at once
+ * and each can be run on a different thread. The members should be treated as private to the agent
+ * implementation, use the AgentContext*() functions instead.
+ */
+typedef struct {
+    Field myField;
+    Field yourField;
+    NegotiationData myData;
+    NegotiationData yourData;
+    NegotiationData nData;
+    GuessData gData;
+    GuessData guess;
+    ProtocolParser parser;
+    TargetingState targeting;
+    HuntTargetState hunt;
+    ParityState parity;
+    AgentPolicy policy;
+    ProtocolWireFormat wireOffer;  // The format offered for COO and HIT messages.
+    ProtocolWireFormat wireFormat; // The format agreed on with the opponent, text until then.
+    AgentState state;
+    TurnOrder turnOrder;
+    ProtocolParserStatus protocolStatus;
+    uint32_t randomState;
+    SchedulerTimer guessTimer; // Holds back each COO for a moment, see AGENT_GUESS_DELAY_TICKS.
+    SchedulerTimer retryTimer; // How long to wait on the opponent, see AGENT_RETRY_TICKS.
+    uint8_t nakOffer;          // Whether to offer PROTOCOL_NEGOTIATION_NAK.
+    uint8_t nakAgreed;         // Whether both agents offered it.
+    uint8_t nakSent;           // Whether a NAK is still waiting for an answer.
+    uint8_t retries;           // Timeouts in a row without the game moving on.
+    GuessData answered;        // The last HIT sent, to send again if its COO arrives twice.
+    uint32_t seed;             // The seed the agent was started from, for the journal.
+    Journal *journal;          // Where the game is recorded, if anywhere.
+    const AgentDisplay *display; // Where the game is drawn, if anywhere.
+    uint8_t journalIdle;       // Whether the agent is being run without input, see JournalEvent.
+    char sent[AGENT_RESEND_MESSAGES][PROTOCOL_MAX_MESSAGE_LEN]; // The last messages sent, oldest
+                                                                // first, to send again on a NAK.
+} __attribute__((aligned(AGENT_CONTEXT_ALIGNMENT))) AgentContext;
 
 /**
  * The Init() function for an Agent sets up everything necessary for an agent before the game
@@ -69,6 +208,26 @@ void AgentInit(void);
  */
 int AgentRun(char in, char *outBuffer);
 
+// How big the output buffer of AgentRunBuffer() must be for `len` bytes of input: room for a reply
+// to every message that fits in them, plus one more sent on the agent's own initiative before and
+// after them. Each reply may be the last AGENT_RESEND_MESSAGES messages sent again.
+#define AGENT_RUN_BUFFER_OUT_LEN(len) (((len) / PROTOCOL_MIN_MESSAGE_LEN + 2) * \
+    AGENT_RESEND_MESSAGES * (PROTOCOL_MAX_MESSAGE_LEN - 1) + 1)
+
+/**
+ * Works like calling AgentRun() on every byte of `in` in turn, but much cheaper. The bytes are fed
+ * straight to the protocol decoder, and the agent's state machine only runs when a complete
+ * message has been decoded (or decoding failed), plus once before and once after the whole buffer
+ * so that the agent can act on its own, e.g. to send its challenge or its next guess. Passing no
+ * input (`len` of 0) is the equivalent of AgentRun('\0').
+ * @param in The next bytes of the incoming message stream.
+ * @param len The number of bytes in `in`.
+ * @param outBuffer Where to store everything the agent wants to transmit, as one string. Must be at
+ *                  least AGENT_RUN_BUFFER_OUT_LEN(len) long.
+ * @return The length of the string stored in outBuffer (excludes \0 character).
+ */
+int AgentRunBuffer(const char *in, size_t len, char *outBuffer);
+
 /**
  * StateCheck() returns a 4-bit number indicating the status of that agent's ships. The smallest
  * ship, the 3-length one, is indicated by the 0th bit, the medium-length ship (4 tiles) is the
@@ -92,4 +251,116 @@ uint8_t AgentGetStatus(void);
  */
 uint8_t AgentGetEnemyStatus(void);
 
+/**
+ * Returns the state of the agent. The game is over for it once it reaches AGENT_STATE_WON,
+ * AGENT_STATE_LOST or AGENT_STATE_INVALID, but it should still be run after winning or losing, as
+ * the opponent may yet need its last message again.
+ */
+AgentState AgentGetState(void);
+
+/**
+ * Sets up `ctx` for a new game, exactly like AgentInit() does for the single built-in agent. All
+ * randomness used by the agent, both now and during AgentContextRun(), comes from a generator
+ * seeded with `seed`, so the same seed and the same input always produce the same game. Unlike the
+ * built-in agent it neither records nor draws its game, so that contexts share nothing and can be
+ * run on separate threads.
+ * @param ctx The context to initialize.
+ * @param seed The seed for this agent's random number generator.
+ */
+void AgentContextInit(AgentContext *ctx, uint32_t seed);
+
+/**
+ * Selects how the agent in `ctx` chooses its shots. Should be called after AgentContextInit() and
+ * before the game starts.
+ * @param ctx The context of the agent.
+ * @param policy The targeting policy to use from now on.
+ */
+void AgentContextSetPolicy(AgentContext *ctx, AgentPolicy policy);
+
+/**
+ * Selects the best format the agent in `ctx` offers for its COO and HIT messages. The best format
+ * the opponent offers too is used, see ProtocolGetWireFormat(). By default binary frames are
+ * offered, unless the field is too big for them, in which case text with a CRC-16 is. Should be
+ * called after AgentContextInit() and before the game starts.
+ * @param ctx The context of the agent.
+ * @param format The best format to offer, PROTOCOL_WIRE_TEXT to stick to plain text.
+ */
+void AgentContextSetWireFormat(AgentContext *ctx, ProtocolWireFormat format);
+
+/**
+ * Selects whether the agent in `ctx` offers to recover lost messages with NAKs, see
+ * AGENT_RETRY_TICKS. It does by default. Should be called after AgentContextInit() and before the
+ * game starts.
+ * @param ctx The context of the agent.
+ * @param offer TRUE to offer it, FALSE to end the game on the first message that fails to parse.
+ */
+void AgentContextSetNak(AgentContext *ctx, uint8_t offer);
+
+/**
+ * Places the fleet of the agent in `ctx` afresh from the given source. Should be called after
+ * AgentContextInit() and before the game starts.
+ * @param ctx The context of the agent.
+ * @param fleet Where to take the layout from.
+ */
+void AgentContextSetFleet(AgentContext *ctx, AgentFleet fleet);
+
+/**
+ * Records the game of the agent in `ctx` in `journal` from now on, see Journal.h. The journal is
+ * started afresh with the agent's seed and its current policy, wire format and NAK offer, so this
+ * should be called right after AgentContextInit(), before AgentContextSetFleet() if that is called.
+ * @param ctx The context of the agent.
+ * @param journal The journal to record in, NULL to stop recording.
+ */
+void AgentContextSetJournal(AgentContext *ctx, Journal *journal);
+
+/**
+ * Draws the game of the agent in `ctx` on `display` from now on. Agents start out drawing nothing,
+ * except for the built-in one, which draws on agentOledDisplay.
+ * @param ctx The context of the agent.
+ * @param display Where to draw, NULL to draw nothing.
+ */
+void AgentContextSetDisplay(AgentContext *ctx, const AgentDisplay *display);
+
+/**
+ * Prints the journal of the built-in agent, which records every game since AgentInit(), see
+ * JournalDump(). On the board that is UART1, the link to the opponent, so BattleBoats only does it
+ * when built with JOURNAL_DUMP_ENABLED, and only once the game is over for both sides.
+ */
+void AgentDumpJournal(void);
+
+/**
+ * Runs the agent in `ctx` on the next incoming character, exactly like AgentRun().
+ * @param ctx The context of the agent to run.
+ * @param in The next character in the incoming message stream, or '\0' if there is none.
+ * @param outBuffer A string that should be transmit to the other agent.
+ * @return The length of the string pointed to by outBuffer (excludes \0 character).
+ */
+int AgentContextRun(AgentContext *ctx, char in, char *outBuffer);
+
+/**
+ * Runs the agent in `ctx` on a buffer of incoming bytes, exactly like AgentRunBuffer().
+ * @param ctx The context of the agent to run.
+ * @param in The next bytes of the incoming message stream.
+ * @param len The number of bytes in `in`.
+ * @param outBuffer Where to store the output, at least AGENT_RUN_BUFFER_OUT_LEN(len) long.
+ * @return The length of the string stored in outBuffer (excludes \0 character).
+ */
+int AgentContextRunBuffer(AgentContext *ctx, const char *in, size_t len, char *outBuffer);
+
+/**
+ * Returns the status of the ships of the agent in `ctx`, like AgentGetStatus().
+ */
+uint8_t AgentContextGetStatus(const AgentContext *ctx);
+
+/**
+ * Returns the status of the enemy's ships as known by the agent in `ctx`, like
+ * AgentGetEnemyStatus().
+ */
+uint8_t AgentContextGetEnemyStatus(const AgentContext *ctx);
+
+/**
+ * Returns the state of the agent in `ctx`, like AgentGetState().
+ */
+AgentState AgentContextGetState(const AgentContext *ctx);
+
 #endif // AGENT_H
@@ -5,25 +5,66 @@
 #include "BOARD.h"
 #include "xc.h"
 #include "FieldOled.h"
+#include "FieldOledDirty.h"
+#include "OledDirty.h"
 #include "Uart1.h"
+#include "Targeting.h"
+#include "Sampler.h"
+#include "HuntTarget.h"
+#include "Journal.h"
+#include "Parity.h"
+#include "Placement.h"
+#include "Profile.h"
+#include "Scheduler.h"
+#include <stdlib.h>
+#include <string.h>
 
-typedef struct {
-    Field myField;
-    Field yourField;
-    NegotiationData myData;
-    NegotiationData yourData;
-    GuessData gData;
-    NegotiationData nData;
-} AgentStruct;
-AgentStruct AgentData;
+// The agent waits a moment before each COO so the opponent has time to get ready for it. The wait
+// is a scheduler timer, so incoming bytes keep being decoded meanwhile. The host build runs the
+// engine as fast as possible, so it skips the wait entirely.
+#ifdef HOST_BUILD
+#define AGENT_GUESS_DELAY_TICKS 0
+#else
+#define AGENT_GUESS_DELAY_TICKS SCHEDULER_MS_TO_TICKS(200)
+#endif
 
-static GuessData guess;
-static int i;
-static int turnOrder = 0;
-static AgentState state = AGENT_STATE_GENERATE_NEG_DATA;
-static ProtocolParserStatus protocolStatus;
+// Binary frames carry the row and column in 4 bits each and the HitStatus in 3, so they're only
+// offered if the field fits and the fleet's sinkings, HIT_SUNK_SMALL_BOAT (2) onwards, do too.
+// Otherwise the best that's offered is text with a CRC-16.
+#if FIELD_ROWS <= 16 && FIELD_COLS <= 16 && FIELD_NUM_BOATS <= 6
+#define AGENT_WIRE_FORMAT_BEST PROTOCOL_WIRE_BINARY
+#else
+#define AGENT_WIRE_FORMAT_BEST PROTOCOL_WIRE_TEXT_CRC16
+#endif
 
-int RandomFunct(Field *field, BoatType boat);
+// The agent behind AgentInit(), AgentRun() and friends, and the journal of its games.
+static AgentContext AgentData;
+static Journal AgentJournalData;
+
+static uint32_t AgentRandom(AgentContext *ctx);
+static void AgentOledDrawError(const char *message);
+static void AgentOledDrawScreen(const Field *myField, const Field *theirField, FieldOledTurn turn);
+static void AgentOledDrawShot(const Field *f, FieldOledDirtySide side, uint8_t row, uint8_t col,
+        FieldOledTurn turn);
+static void AgentDrawError(const AgentContext *ctx, const char *message);
+static void AgentDrawScreen(const AgentContext *ctx, FieldOledTurn turn);
+static void AgentDrawShot(const AgentContext *ctx, FieldOledDirtySide side, FieldOledTurn turn);
+static int AgentStep(AgentContext *ctx, char *outBuffer);
+static uint8_t AgentRecover(AgentContext *ctx, char *outBuffer);
+static void AgentRetry(AgentContext *ctx, char *outBuffer);
+static void AgentNak(AgentContext *ctx, char *outBuffer);
+static void AgentResend(const AgentContext *ctx, char *outBuffer);
+static void AgentRemember(AgentContext *ctx, const char *message);
+static Journal *AgentJournal(AgentContext *ctx);
+static void AgentRecord(AgentContext *ctx, JournalEvent event, uint32_t value);
+static void AgentRecordDecoded(AgentContext *ctx, ProtocolParserStatus status);
+static void AgentRecordSent(AgentContext *ctx, const char *outBuffer, int length);
+
+const AgentDisplay agentOledDisplay = {
+    AgentOledDrawError,
+    AgentOledDrawScreen,
+    AgentOledDrawShot
+};
 
 /**
  * The Init() function for an Agent sets up everything necessary for an agent before the game
@@ -33,38 +74,46 @@ int RandomFunct(Field *field, BoatType boat);
  */
 void AgentInit(void)
 {
-    int temp1 = 0;
-    int temp2 = 0;
-    int temp3 = 0;
-    int temp4 = 0;
-    BoatType type;
-    FieldInit(&AgentData.myField, FIELD_POSITION_EMPTY);
-    FieldInit(&AgentData.yourField, FIELD_POSITION_UNKNOWN);
-    //initializes my field and enemy's field 
-    while (temp1 == 0) { //continues randomizing until adding each boat works
-        type = FIELD_BOAT_SMALL;
-        if (RandomFunct(&AgentData.myField, type) == SUCCESS) {
-            temp1 = 1;
-        }
-    }
-    while (temp2 == 0) {
-        type = FIELD_BOAT_MEDIUM;
-        if (RandomFunct(&AgentData.myField, type) == SUCCESS) {
-            temp2 = 1;
-        }
-    }
-    while (temp3 == 0) {
-        type = FIELD_BOAT_LARGE;
-        if (RandomFunct(&AgentData.myField, type) == SUCCESS) {
-            temp3 = 1;
-        }
-    }
-    while (temp4 == 0) {
-        type = FIELD_BOAT_HUGE;
-        if (RandomFunct(&AgentData.myField, type) == SUCCESS) {
-            temp4 = 1;
-        }
-    }
+    AgentContextInit(&AgentData, rand());
+    AgentContextSetJournal(&AgentData, &AgentJournalData);
+    AgentContextSetDisplay(&AgentData, &agentOledDisplay);
+}
+
+/**
+ * Sets up `ctx` for a new game, exactly like AgentInit() does for the single built-in agent.
+ * @param ctx The context to initialize.
+ * @param seed The seed for this agent's random number generator.
+ */
+void AgentContextInit(AgentContext *ctx, uint32_t seed)
+{
+    //xorshift can never leave the all-zero state, so avoid starting there
+    ctx->randomState = seed ? seed : 0x9E3779B9;
+    ctx->seed = seed;
+    ctx->journal = NULL;
+    ctx->journalIdle = 0;
+    ctx->display = NULL;
+    ctx->state = AGENT_STATE_GENERATE_NEG_DATA;
+    ctx->turnOrder = TURN_ORDER_DEFER;
+    ctx->protocolStatus = PROTOCOL_WAITING;
+    ctx->policy = AGENT_POLICY_DENSITY;
+    ctx->wireOffer = AGENT_WIRE_FORMAT_BEST;
+    ctx->wireFormat = PROTOCOL_WIRE_TEXT;
+    ctx->guessTimer.armed = FALSE;
+    ctx->retryTimer.armed = FALSE;
+    ctx->nakOffer = TRUE;
+    ctx->nakAgreed = FALSE;
+    ctx->nakSent = FALSE;
+    ctx->retries = 0;
+    //no COO has been answered yet, and none can be for a cell off the field
+    ctx->answered.row = FIELD_ROWS;
+    ctx->answered.col = FIELD_COLS;
+    memset(ctx->sent, 0, sizeof(ctx->sent));
+    ProtocolParserInit(&ctx->parser);
+    TargetingInit(&ctx->targeting);
+    HuntTargetInit(&ctx->hunt);
+    ParityInit(&ctx->parity, AgentRandom(ctx));
+    FieldInit(&ctx->yourField, FIELD_POSITION_UNKNOWN);
+    AgentContextSetFleet(ctx, AGENT_FLEET_TABLE);
 }
 
 /**
@@ -81,99 +130,210 @@ void AgentInit(void)
  */
 int AgentRun(char in, char *outBuffer)
 {
-    outBuffer[0] = '\0';
+    return AgentContextRun(&AgentData, in, outBuffer);
+}
+
+/**
+ * Runs the agent on a whole buffer of incoming bytes, see Agent.h.
+ * @param in The next bytes of the incoming message stream.
+ * @param len The number of bytes in `in`.
+ * @param outBuffer Where to store the output, at least AGENT_RUN_BUFFER_OUT_LEN(len) long.
+ * @return The length of the string stored in outBuffer (excludes \0 character).
+ */
+int AgentRunBuffer(const char *in, size_t len, char *outBuffer)
+{
+    return AgentContextRunBuffer(&AgentData, in, len, outBuffer);
+}
+
+/**
+ * Runs the agent in `ctx` on the next incoming character, exactly like AgentRun().
+ * @param ctx The context of the agent to run.
+ * @param in The next character in the incoming message stream, or '\0' if there is none.
+ * @param outBuffer A string that should be transmit to the other agent.
+ * @return The length of the string pointed to by outBuffer (excludes \0 character).
+ */
+int AgentContextRun(AgentContext *ctx, char in, char *outBuffer)
+{
+    int length;
+    //a message is only acted on in the pass that completes it
+    ctx->protocolStatus = PROTOCOL_WAITING;
+    ctx->journalIdle = in == '\0' ? JOURNAL_EVENT_RUN : 0;
     if (in != '\0') { //check status when input isnt null
-        protocolStatus = ProtocolDecode(in, &AgentData.nData, &AgentData.gData);
+        AgentRecord(ctx, JOURNAL_EVENT_RUN, (uint8_t) in);
+        PROFILE(PROFILE_PROTOCOL_DECODE, ctx->protocolStatus =
+                ProtocolParserDecode(&ctx->parser, in, &ctx->nData, &ctx->gData));
+        AgentRecordDecoded(ctx, ctx->protocolStatus);
+    }
+    length = AgentStep(ctx, outBuffer);
+    AgentRecordSent(ctx, outBuffer, length);
+    return length;
+}
+
+/**
+ * Runs the agent in `ctx` on a buffer of incoming bytes, exactly like AgentRunBuffer().
+ * @param ctx The context of the agent to run.
+ * @param in The next bytes of the incoming message stream.
+ * @param len The number of bytes in `in`.
+ * @param outBuffer Where to store the output, at least AGENT_RUN_BUFFER_OUT_LEN(len) long.
+ * @return The length of the string stored in outBuffer (excludes \0 character).
+ */
+int AgentContextRunBuffer(AgentContext *ctx, const char *in, size_t len, char *outBuffer)
+{
+    ProtocolParserStatus status;
+    int length;
+    size_t i;
+
+    ctx->journalIdle = len == 0 ? JOURNAL_EVENT_RUN_BUFFER : 0;
+    if (len > 0 && ctx->journal != NULL) {
+        JournalBytes(ctx->journal, JOURNAL_EVENT_RUN_BUFFER, in, len);
     }
-    if (protocolStatus == PROTOCOL_PARSING_FAILURE) { 
-        //when status fails print error
-        OledClear(OLED_COLOR_BLACK);
-        OledDrawString(AGENT_ERROR_STRING_PARSING);
-        OledUpdate();
-        state = AGENT_STATE_INVALID;
+    //let the agent act on its own first, so a message that's already waiting can't overtake it
+    ctx->protocolStatus = PROTOCOL_WAITING;
+    length = AgentStep(ctx, outBuffer);
+    for (i = 0; i < len; i++) {
+        PROFILE(PROFILE_PROTOCOL_DECODE,
+                status = ProtocolParserDecode(&ctx->parser, in[i], &ctx->nData, &ctx->gData));
+        if (status >= PROTOCOL_PARSED_COO_MESSAGE || status == PROTOCOL_PARSING_FAILURE) {
+            AgentRecordDecoded(ctx, status);
+            ctx->protocolStatus = status;
+            length += AgentStep(ctx, outBuffer + length);
+        }
     }
-    switch (state) {
+    //and again afterwards, to act on whatever the messages changed
+    ctx->protocolStatus = PROTOCOL_WAITING;
+    length += AgentStep(ctx, outBuffer + length);
+    AgentRecordSent(ctx, outBuffer, length);
+    return length;
+}
+
+/**
+ * Runs one pass of the agent's state machine on the protocol status it was last given.
+ * @param ctx The context of the agent to run.
+ * @param outBuffer Where to store the message the agent wants to transmit, if any.
+ * @return The length of the string stored in outBuffer (excludes \0 character).
+ */
+static int AgentStep(AgentContext *ctx, char *outBuffer)
+{
+    AgentState state = ctx->state;
+
+    outBuffer[0] = '\0';
+    if (AgentRecover(ctx, outBuffer)) {
+        if (ctx->state != state) {
+            AgentRecord(ctx, JOURNAL_EVENT_STATE, ctx->state);
+        }
+        return strlen(outBuffer);
+    }
+    switch (ctx->state) {
     case AGENT_STATE_GENERATE_NEG_DATA: //creates negotiation data and sends it
-        ProtocolGenerateNegotiationData(&AgentData.myData);
-        ProtocolEncodeChaMessage(outBuffer, &AgentData.myData);
+        ctx->myData.encryptionKey = AgentRandom(ctx) & 0xFFFF;
+        ctx->myData.guess = AgentRandom(ctx) & 0xFFFF;
+        //offer a better format for COO and HIT, which only shows in the DET message
+        ProtocolOfferWireFormat(&ctx->myData, ctx->wireOffer);
+        if (ctx->nakOffer) {
+            ProtocolOfferNak(&ctx->myData);
+        }
+        ProtocolEncryptNegotiationData(&ctx->myData);
+        ProtocolEncodeChaMessage(outBuffer, &ctx->myData);
         //sends challenge message
-        state = AGENT_STATE_SEND_CHALLENGE_DATA;
+        ctx->state = AGENT_STATE_SEND_CHALLENGE_DATA;
         break;
     case AGENT_STATE_SEND_CHALLENGE_DATA: //once recieve enemy's challenge
-        if (protocolStatus == PROTOCOL_PARSED_CHA_MESSAGE) {
+        if (ctx->protocolStatus == PROTOCOL_PARSED_CHA_MESSAGE) {
             //send determine message
-            AgentData.yourData.encryptedGuess = AgentData.nData.encryptedGuess;
-            AgentData.yourData.hash = AgentData.nData.hash;
-            ProtocolEncodeDetMessage(outBuffer, &AgentData.myData);
-            state = AGENT_STATE_DETERMINE_TURN_ORDER;
+            ctx->yourData.encryptedGuess = ctx->nData.encryptedGuess;
+            ctx->yourData.hash = ctx->nData.hash;
+            ProtocolEncodeDetMessage(outBuffer, &ctx->myData);
+            ctx->state = AGENT_STATE_DETERMINE_TURN_ORDER;
         }
         break;
     case AGENT_STATE_DETERMINE_TURN_ORDER: //determines turn order
-        if (protocolStatus == PROTOCOL_PARSED_DET_MESSAGE) {
-            AgentData.yourData.guess = AgentData.nData.guess;
-            AgentData.yourData.encryptionKey = AgentData.nData.encryptionKey;
-            if (ProtocolValidateNegotiationData(&AgentData.yourData) == FALSE) {
-                OledClear(OLED_COLOR_BLACK);
-                OledDrawString(AGENT_ERROR_STRING_NEG_DATA);
-                OledUpdate();
-                state = AGENT_STATE_INVALID;
+        if (ctx->protocolStatus == PROTOCOL_PARSED_DET_MESSAGE) {
+            ctx->yourData.guess = ctx->nData.guess;
+            ctx->yourData.encryptionKey = ctx->nData.encryptionKey;
+            if (ProtocolValidateNegotiationData(&ctx->yourData) == FALSE) {
+                AgentDrawError(ctx, AGENT_ERROR_STRING_NEG_DATA);
+                ctx->state = AGENT_STATE_INVALID;
             } else {
-                if (turnOrder == TURN_ORDER_TIE) {
-                    OledClear(OLED_COLOR_BLACK);
-                    OledDrawString(AGENT_ERROR_STRING_ORDERING);
-                    OledUpdate();
-                    state = AGENT_STATE_INVALID;
-                } else if (turnOrder == TURN_ORDER_START) {
+                ctx->wireFormat = ProtocolGetWireFormat(&ctx->myData, &ctx->yourData);
+                ctx->nakAgreed = ProtocolGetNak(&ctx->myData, &ctx->yourData);
+                ctx->turnOrder = ProtocolGetTurnOrder(&ctx->myData, &ctx->yourData);
+                if (ctx->turnOrder == TURN_ORDER_TIE) {
+                    AgentDrawError(ctx, AGENT_ERROR_STRING_ORDERING);
+                    ctx->state = AGENT_STATE_INVALID;
+                } else if (ctx->turnOrder == TURN_ORDER_START) {
                     //Won turn order update oled to my turn
-                    FieldOledDrawScreen(&AgentData.myField, &AgentData.yourField, FIELD_OLED_TURN_MINE);
-                    state = AGENT_STATE_SEND_GUESS;
-                } else if (turnOrder == TURN_ORDER_DEFER) {
+                    AgentDrawScreen(ctx, FIELD_OLED_TURN_MINE);
+                    ctx->state = AGENT_STATE_SEND_GUESS;
+                } else if (ctx->turnOrder == TURN_ORDER_DEFER) {
                     //Lost turn order update oled to your turn
-                    FieldOledDrawScreen(&AgentData.myField, &AgentData.yourField, FIELD_OLED_TURN_THEIRS);
-                    state = AGENT_STATE_WAIT_FOR_GUESS;
+                    AgentDrawScreen(ctx, FIELD_OLED_TURN_THEIRS);
+                    ctx->state = AGENT_STATE_WAIT_FOR_GUESS;
                 }
             }
         }
         break;
-    case AGENT_STATE_SEND_GUESS: //send random guess encoded with coo
-        for (i = 0; i < BOARD_GetPBClock() / 8; i++); //delays coo msg
-        guess.row = (rand() % (FIELD_ROWS));
-        guess.col = (rand() % (FIELD_COLS));
-        while (FieldAt(&AgentData.yourField, guess.row, guess.col) != FIELD_POSITION_UNKNOWN) {
-            //guess until valid
-            guess.row = (rand() % (FIELD_ROWS));
-            guess.col = (rand() % (FIELD_COLS));
+    case AGENT_STATE_SEND_GUESS: //send a guess encoded with coo
+        //delays coo msg without blocking: start the timer on the first pass, then wait it out
+        if (!SchedulerTimerRunning(&ctx->guessTimer)) {
+            SchedulerTimerStart(&ctx->guessTimer, AGENT_GUESS_DELAY_TICKS);
+        }
+        if (!SchedulerTimerExpired(&ctx->guessTimer)) {
+            break;
+        }
+        if (ctx->policy == AGENT_POLICY_RANDOM) {
+            //any cell that hasn't been tried yet
+            ParityChooseAny(&ctx->parity, AgentRandom(ctx), &ctx->guess);
+        } else if (ctx->policy == AGENT_POLICY_PARITY) {
+            //finish off the boats that have been hit, otherwise hunt on the lattice
+            if (!HuntTargetChooseTarget(&ctx->hunt, &ctx->targeting, AgentRandom(ctx),
+                    &ctx->guess)) {
+                ParityChoose(&ctx->parity, AgentContextGetEnemyStatus(ctx), AgentRandom(ctx),
+                        &ctx->guess);
+            }
+        } else if (ctx->policy == AGENT_POLICY_HUNT_TARGET) {
+            //finish off the boats that have been hit, otherwise hunt for the next one
+            HuntTargetChoose(&ctx->hunt, &ctx->targeting, AgentRandom(ctx), &ctx->guess);
+        } else if (ctx->policy != AGENT_POLICY_SAMPLING ||
+                SamplerChoose(&ctx->yourField, AgentContextGetEnemyStatus(ctx), AgentRandom(ctx),
+                SAMPLER_SAMPLES, &ctx->guess) != SUCCESS) {
+            //fire where the most boat placements overlap
+            TargetingChoose(&ctx->targeting, &ctx->yourField, AgentRandom(ctx), &ctx->guess);
         }
-        ProtocolEncodeCooMessage(outBuffer, &guess);
-        state = AGENT_STATE_WAIT_FOR_HIT;
+        ProtocolEncodeCoo(outBuffer, &ctx->guess, ctx->wireFormat);
+        ctx->state = AGENT_STATE_WAIT_FOR_HIT;
         break;
     case AGENT_STATE_WAIT_FOR_HIT: //if hit update field and check if you won
-        if (protocolStatus == PROTOCOL_PARSED_HIT_MESSAGE) {
-            if (AgentGetEnemyStatus() != 0) { 
-                //still alive update field with hitmark
-                FieldUpdateKnowledge(&AgentData.yourField, &AgentData.gData);
-                FieldOledDrawScreen(&AgentData.myField, &AgentData.yourField, FIELD_OLED_TURN_THEIRS);
-                state = AGENT_STATE_WAIT_FOR_GUESS;
+        if (ctx->protocolStatus == PROTOCOL_PARSED_HIT_MESSAGE) {
+            //update field with hitmark
+            FieldUpdateKnowledge(&ctx->yourField, &ctx->gData);
+            TargetingUpdate(&ctx->targeting, &ctx->gData);
+            HuntTargetUpdate(&ctx->hunt, &ctx->gData);
+            ParityRemove(&ctx->parity, &ctx->gData);
+            if (AgentContextGetEnemyStatus(ctx) != 0) {
+                //still alive
+                AgentDrawShot(ctx, FIELD_OLED_DIRTY_THEIRS, FIELD_OLED_TURN_THEIRS);
+                ctx->state = AGENT_STATE_WAIT_FOR_GUESS;
             } else {
-                //else move to win state
-                FieldOledDrawScreen(&AgentData.myField, &AgentData.yourField, FIELD_OLED_TURN_NONE);
-                state = AGENT_STATE_WON;
+                //that sank their last ship, so move to win state
+                AgentDrawShot(ctx, FIELD_OLED_DIRTY_THEIRS, FIELD_OLED_TURN_NONE);
+                ctx->state = AGENT_STATE_WON;
             }
         }
         break;
     case AGENT_STATE_WAIT_FOR_GUESS:
-        if (protocolStatus == PROTOCOL_PARSED_COO_MESSAGE) {
-            if (AgentGetStatus() == 0) {
-                //if no ships you lose
-                FieldOledDrawScreen(&AgentData.myField, &AgentData.yourField, FIELD_OLED_TURN_NONE);
-                state = AGENT_STATE_LOST;
+        if (ctx->protocolStatus == PROTOCOL_PARSED_COO_MESSAGE) {
+            //register enemy attacks and update then send hit msg to enemy
+            FieldRegisterEnemyAttack(&ctx->myField, &ctx->gData);
+            if (AgentContextGetStatus(ctx) == 0) {
+                //that sank our last ship, so we lose
+                AgentDrawShot(ctx, FIELD_OLED_DIRTY_MINE, FIELD_OLED_TURN_NONE);
+                ctx->state = AGENT_STATE_LOST;
             } else {
-                //register enemy attacks and updatethen  send coo msg to enemy
-                FieldRegisterEnemyAttack(&AgentData.myField, &AgentData.gData);
-                FieldOledDrawScreen(&AgentData.myField, &AgentData.yourField, FIELD_OLED_TURN_MINE);
-                state = AGENT_STATE_SEND_GUESS;
+                AgentDrawShot(ctx, FIELD_OLED_DIRTY_MINE, FIELD_OLED_TURN_MINE);
+                ctx->state = AGENT_STATE_SEND_GUESS;
             }
-            ProtocolEncodeHitMessage(outBuffer, &AgentData.gData);
+            ProtocolEncodeHit(outBuffer, &ctx->gData, ctx->wireFormat);
+            ctx->answered = ctx->gData;
         }
         break;
     case AGENT_STATE_WON:
@@ -183,9 +343,179 @@ int AgentRun(char in, char *outBuffer)
     case AGENT_STATE_INVALID:
         break;
     }
+    if (outBuffer[0] != '\0') {
+        AgentRemember(ctx, outBuffer);
+    }
+    if (ctx->state != state) {
+        AgentRecord(ctx, JOURNAL_EVENT_STATE, ctx->state);
+        //the game moved on, so the opponent gets the full time to answer again
+        ctx->retries = 0;
+        ctx->nakSent = FALSE;
+        SchedulerTimerStart(&ctx->retryTimer, AGENT_RETRY_TICKS);
+    }
     return strlen(outBuffer);
 }
 
+/**
+ * Deals with everything that keeps the link going rather than the game: broken messages, NAKs,
+ * messages that arrive twice and opponents that go quiet, see AGENT_RETRY_TICKS.
+ * @param ctx The agent to run.
+ * @param outBuffer Where to store the messages to send, if any.
+ * @return TRUE if the agent's state machine shouldn't run in this pass.
+ */
+static uint8_t AgentRecover(AgentContext *ctx, char *outBuffer)
+{
+    const GuessData *g = &ctx->gData;
+
+    if (ctx->state == AGENT_STATE_INVALID) {
+        return FALSE;
+    }
+    if (ctx->protocolStatus == PROTOCOL_PARSED_HIT_MESSAGE &&
+            (g->row >= FIELD_ROWS || g->col >= FIELD_COLS ||
+            (!ctx->nakAgreed && ctx->state == AGENT_STATE_WAIT_FOR_HIT &&
+            (g->row != ctx->guess.row || g->col != ctx->guess.col)))) {
+        //garbled in a way the checksum missed: nothing answers a shot off the field, and without
+        //NAKs nothing is sent twice, so a HIT that isn't for our shot can't be an old one again
+        ctx->protocolStatus = PROTOCOL_PARSING_FAILURE;
+    }
+    if (ctx->protocolStatus >= PROTOCOL_PARSED_COO_MESSAGE) {
+        //the opponent is getting through, so it's fine to ask it again
+        ctx->nakSent = FALSE;
+    }
+    switch (ctx->protocolStatus) {
+    case PROTOCOL_PARSING_FAILURE:
+        if (ctx->nakAgreed) {
+            //ask for whatever it was to be sent again, rather than giving up on the game
+            AgentNak(ctx, outBuffer);
+        } else if (ctx->state > AGENT_STATE_DETERMINE_TURN_ORDER) {
+            AgentDrawError(ctx, AGENT_ERROR_STRING_PARSING);
+            ctx->state = AGENT_STATE_INVALID;
+        }
+        //while shaking hands the opponent's messages come again anyway, see AgentRetry()
+        return TRUE;
+    case PROTOCOL_PARSED_NAK_MESSAGE:
+        AgentResend(ctx, outBuffer);
+        return TRUE;
+    case PROTOCOL_PARSED_CHA_MESSAGE:
+        if (ctx->state > AGENT_STATE_SEND_CHALLENGE_DATA) {
+            //the opponent is still waiting for our DET
+            ProtocolEncodeDetMessage(outBuffer, &ctx->myData);
+            return TRUE;
+        }
+        return FALSE;
+    case PROTOCOL_PARSED_COO_MESSAGE:
+        if (!ctx->nakAgreed) {
+            return FALSE;
+        }
+        if (ctx->state != AGENT_STATE_WAIT_FOR_GUESS &&
+                g->row == ctx->answered.row && g->col == ctx->answered.col) {
+            //the opponent is still waiting for our HIT, rather than firing at the same cell again
+            ProtocolEncodeHit(outBuffer, &ctx->answered, ctx->wireFormat);
+            return TRUE;
+        }
+        if (ctx->state == AGENT_STATE_WAIT_FOR_HIT) {
+            //the opponent has moved on, so its HIT must have been lost
+            AgentNak(ctx, outBuffer);
+            return TRUE;
+        }
+        return FALSE;
+    case PROTOCOL_PARSED_HIT_MESSAGE:
+        //a HIT that was sent again after it had already arrived, or one from an earlier turn
+        return ctx->nakAgreed && (ctx->state != AGENT_STATE_WAIT_FOR_HIT ||
+                g->row != ctx->guess.row || g->col != ctx->guess.col);
+    case PROTOCOL_PARSED_DET_MESSAGE:
+        return FALSE;
+    default:
+        break;
+    }
+    if ((ctx->state == AGENT_STATE_SEND_CHALLENGE_DATA ||
+            ctx->state == AGENT_STATE_DETERMINE_TURN_ORDER ||
+            ctx->state == AGENT_STATE_WAIT_FOR_HIT || ctx->state == AGENT_STATE_WAIT_FOR_GUESS) &&
+            SchedulerTimerExpired(&ctx->retryTimer)) {
+        AgentRetry(ctx, outBuffer);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * Acts on having waited AGENT_RETRY_TICKS for the opponent.
+ * @param ctx The agent that has been waiting.
+ * @param outBuffer Where to store the messages to send, if any.
+ */
+static void AgentRetry(AgentContext *ctx, char *outBuffer)
+{
+    SchedulerTimerStart(&ctx->retryTimer, AGENT_RETRY_TICKS);
+    if (ctx->state <= AGENT_STATE_DETERMINE_TURN_ORDER) {
+        //ours may have been lost, and the opponent answers them again if its answers were
+        AgentResend(ctx, outBuffer);
+    } else if (!ctx->nakAgreed) {
+        //there's no asking this opponent, so wait as long as it takes like before
+    } else if (++ctx->retries > AGENT_MAX_RETRIES) {
+        AgentDrawError(ctx, AGENT_ERROR_STRING_LINK);
+        ctx->state = AGENT_STATE_INVALID;
+    } else {
+        //the last NAK went unanswered, if there was one
+        ctx->nakSent = FALSE;
+        AgentNak(ctx, outBuffer);
+    }
+}
+
+/**
+ * Asks the opponent to send its last messages again, unless that has been asked already and not
+ * yet answered.
+ * @param ctx The agent that is missing a message.
+ * @param outBuffer Where to store the NAK.
+ */
+static void AgentNak(AgentContext *ctx, char *outBuffer)
+{
+    ProtocolParserStatus waitingFor = PROTOCOL_WAITING;
+    if (ctx->nakSent) {
+        return;
+    }
+    if (ctx->state == AGENT_STATE_WAIT_FOR_HIT) {
+        waitingFor = PROTOCOL_PARSED_HIT_MESSAGE;
+    } else if (ctx->state == AGENT_STATE_WAIT_FOR_GUESS) {
+        waitingFor = PROTOCOL_PARSED_COO_MESSAGE;
+    }
+    ProtocolEncodeNak(outBuffer, waitingFor, ctx->wireFormat);
+    ctx->nakSent = TRUE;
+}
+
+/**
+ * Sends the last AGENT_RESEND_MESSAGES messages again, oldest first, leaving out a COO the opponent
+ * has already answered.
+ * @param ctx The agent whose messages to send.
+ * @param outBuffer Where to store them, as one string.
+ */
+static void AgentResend(const AgentContext *ctx, char *outBuffer)
+{
+    int m = 0;
+    if (ctx->state == AGENT_STATE_SEND_GUESS || ctx->state == AGENT_STATE_LOST) {
+        //the last message is our HIT for the opponent's shot, and the one before our own shot,
+        //which it answered: once it has our HIT it would take that for a new shot at the same cell
+        m = AGENT_RESEND_MESSAGES - 1;
+    }
+    for (; m < AGENT_RESEND_MESSAGES; m++) {
+        strcpy(outBuffer, ctx->sent[m]);
+        outBuffer += strlen(outBuffer);
+    }
+}
+
+/**
+ * Keeps a copy of a message as it's sent, to send it again on a NAK.
+ * @param ctx The agent sending the message.
+ * @param message The whole message.
+ */
+static void AgentRemember(AgentContext *ctx, const char *message)
+{
+    int m;
+    for (m = 1; m < AGENT_RESEND_MESSAGES; m++) {
+        strcpy(ctx->sent[m - 1], ctx->sent[m]);
+    }
+    strcpy(ctx->sent[AGENT_RESEND_MESSAGES - 1], message);
+}
+
 /**
  * StateCheck() returns a 4-bit number indicating the status of that agent's ships. The smallest
  * ship, the 3-length one, is indicated by the 0th bit, the medium-length ship (4 tiles) is the
@@ -199,7 +529,17 @@ int AgentRun(char in, char *outBuffer)
  */
 uint8_t AgentGetStatus(void)
 {
-    return FieldGetBoatStates(&AgentData.myField);
+    return AgentContextGetStatus(&AgentData);
+}
+
+/**
+ * Draws the game of the agent in `ctx` on `display` from now on, see Agent.h.
+ * @param ctx The context of the agent.
+ * @param display Where to draw, NULL to draw nothing.
+ */
+void AgentContextSetDisplay(AgentContext *ctx, const AgentDisplay *display)
+{
+    ctx->display = display;
 }
 
 /**
@@ -212,36 +552,220 @@ uint8_t AgentGetStatus(void)
  */
 uint8_t AgentGetEnemyStatus(void)
 {
-    return FieldGetBoatStates(&AgentData.yourField);
+    return AgentContextGetEnemyStatus(&AgentData);
+}
+
+/**
+ * Returns the state of the built-in agent, see Agent.h.
+ */
+AgentState AgentGetState(void)
+{
+    return AgentContextGetState(&AgentData);
+}
+
+void AgentContextSetPolicy(AgentContext *ctx, AgentPolicy policy)
+{
+    AgentRecord(ctx, JOURNAL_EVENT_POLICY, policy);
+    ctx->policy = policy;
+}
+
+void AgentContextSetWireFormat(AgentContext *ctx, ProtocolWireFormat format)
+{
+    AgentRecord(ctx, JOURNAL_EVENT_WIRE, format);
+    ctx->wireOffer = format > AGENT_WIRE_FORMAT_BEST ? AGENT_WIRE_FORMAT_BEST : format;
+}
+
+void AgentContextSetNak(AgentContext *ctx, uint8_t offer)
+{
+    AgentRecord(ctx, JOURNAL_EVENT_NAK, offer);
+    ctx->nakOffer = offer;
+}
+
+void AgentContextSetFleet(AgentContext *ctx, AgentFleet fleet)
+{
+    AgentRecord(ctx, JOURNAL_EVENT_FLEET, fleet);
+    //a layout that held out long against the targeting policies, otherwise each boat at a random
+    //spot out of all those where it fits
+    if (fleet != AGENT_FLEET_TABLE || !PlacementFromTable(&ctx->myField, AgentRandom(ctx))) {
+        PlacementFleet(&ctx->myField, AgentRandom(ctx));
+    }
+}
+
+void AgentContextSetJournal(AgentContext *ctx, Journal *journal)
+{
+    ctx->journal = journal;
+    if (journal != NULL) {
+        JournalInit(journal);
+        JournalValue(journal, JOURNAL_EVENT_SEED, ctx->seed);
+        JournalValue(journal, JOURNAL_EVENT_POLICY, ctx->policy);
+        JournalValue(journal, JOURNAL_EVENT_WIRE, ctx->wireOffer);
+        JournalValue(journal, JOURNAL_EVENT_NAK, ctx->nakOffer);
+    }
+}
+
+void AgentDumpJournal(void)
+{
+    JournalDump(&AgentJournalData);
+}
+
+uint8_t AgentContextGetStatus(const AgentContext *ctx)
+{
+    return FieldGetBoatStates(&ctx->myField);
+}
+
+uint8_t AgentContextGetEnemyStatus(const AgentContext *ctx)
+{
+    return FieldGetBoatStates(&ctx->yourField);
+}
+
+AgentState AgentContextGetState(const AgentContext *ctx)
+{
+    return ctx->state;
+}
+
+/**
+ * Replaces the whole screen with an error message, if the agent has a display.
+ * @param ctx The agent that ran into the error.
+ * @param message The message to show.
+ */
+static void AgentDrawError(const AgentContext *ctx, const char *message)
+{
+    if (ctx->display != NULL) {
+        ctx->display->drawError(message);
+    }
+}
+
+/**
+ * Redraws the agent's view of both fields, if it has a display.
+ * @param ctx The agent whose fields to draw.
+ * @param turn Whose turn to show.
+ */
+static void AgentDrawScreen(const AgentContext *ctx, FieldOledTurn turn)
+{
+    if (ctx->display != NULL) {
+        ctx->display->drawScreen(&ctx->myField, &ctx->yourField, turn);
+    }
+}
+
+/**
+ * Updates the agent's screen after a shot, if it has a display.
+ * @param ctx The agent whose screen to update.
+ * @param side Which field was shot at. The coordinates are taken from the last message received.
+ * @param turn Whose turn to show.
+ */
+static void AgentDrawShot(const AgentContext *ctx, FieldOledDirtySide side, FieldOledTurn turn)
+{
+    const Field *f = side == FIELD_OLED_DIRTY_MINE ? &ctx->myField : &ctx->yourField;
+    if (ctx->display != NULL) {
+        ctx->display->drawShot(f, side, ctx->gData.row, ctx->gData.col, turn);
+    }
+}
+
+/**
+ * Replaces the whole screen of the OLED with an error message.
+ * @param message The message to show.
+ */
+static void AgentOledDrawError(const char *message)
+{
+    OledClear(OLED_COLOR_BLACK);
+    OledDrawString(message);
+    OledDirtyMarkAll();
+    PROFILE(PROFILE_OLED_UPDATE, OledDirtyUpdate());
+}
+
+/**
+ * Redraws both fields on the OLED.
+ * @param myField The agent's own field.
+ * @param theirField What the agent knows of the enemy's field.
+ * @param turn Whose turn to show.
+ */
+static void AgentOledDrawScreen(const Field *myField, const Field *theirField, FieldOledTurn turn)
+{
+    PROFILE(PROFILE_FIELD_OLED_DRAW_SCREEN, {
+        FieldOledDirtyDrawScreen(myField, theirField, turn);
+        OledDirtyUpdate();
+    });
 }
 
 /**
- * The function randomizes the row, column, and direction of the boat
- * @par f the field the boat is to be added to
- * @par t the type of boat to be added
- * @return SUCCESS if successfully added. STANDARD_ERROR if failed
+ * Updates the OLED after a shot by redrawing only the cell that was shot at and the turn
+ * indicator, and sending just those to the display. The whole screen must have been drawn by
+ * AgentOledDrawScreen() before.
+ * @param f The field that was shot at.
+ * @param side Which of the two fields on the screen `f` is.
+ * @param row The row of the cell that was shot at.
+ * @param col The column of the cell that was shot at.
+ * @param turn Whose turn to show.
  */
+static void AgentOledDrawShot(const Field *f, FieldOledDirtySide side, uint8_t row, uint8_t col,
+        FieldOledTurn turn)
+{
+    PROFILE(PROFILE_FIELD_OLED_DRAW_SCREEN, {
+        FieldOledDirtyDrawCell(f, side, row, col);
+        FieldOledDirtyDrawTurn(turn);
+        OledDirtyUpdate();
+    });
+}
 
-int RandomFunct(Field *field, BoatType boat) 
-//randomizes direction and coordinates for boat
-{ 
-    int chooseDir = 0;
-    int Row, Col;
-    BoatDirection Dir;
-    chooseDir = (rand() % 4);
-    if (chooseDir == 0) { //randomizes direction
-        Dir = FIELD_BOAT_DIRECTION_SOUTH;
-    } else if (chooseDir == 1) {
-        Dir = FIELD_BOAT_DIRECTION_WEST;
-    } else if (chooseDir == 2) {
-        Dir = FIELD_BOAT_DIRECTION_NORTH;
-    } else if (chooseDir == 3) {
-        Dir = FIELD_BOAT_DIRECTION_EAST;
+/**
+ * Returns the journal the agent records in, if it has one. The first event of a run without input
+ * is preceded by a JOURNAL_EVENT_IDLE, so that the run can be told apart from the one before.
+ * @param ctx The agent about to record an event.
+ * @return The journal to record it in, NULL if the agent isn't recording.
+ */
+static Journal *AgentJournal(AgentContext *ctx)
+{
+    if (ctx->journal != NULL && ctx->journalIdle) {
+        JournalValue(ctx->journal, JOURNAL_EVENT_IDLE, ctx->journalIdle);
+        ctx->journalIdle = 0;
     }
-    Row = (rand() % (FIELD_ROWS)); //then randomizes row and col
-    Col = (rand() % (FIELD_COLS));
-    if (FieldAddBoat(field, Row, Col, Dir, boat) == TRUE) { //if adds properly success
-        return SUCCESS;
+    return ctx->journal;
+}
+
+/**
+ * Records an event that carries a single value in the agent's journal, if it has one.
+ */
+static void AgentRecord(AgentContext *ctx, JournalEvent event, uint32_t value)
+{
+    if (AgentJournal(ctx) != NULL) {
+        JournalValue(ctx->journal, event, value);
+    }
+}
+
+/**
+ * Records the outcome of decoding a message in the agent's journal, if it has one and a message was
+ * decoded or failed to be.
+ */
+static void AgentRecordDecoded(AgentContext *ctx, ProtocolParserStatus status)
+{
+    if ((status >= PROTOCOL_PARSED_COO_MESSAGE || status == PROTOCOL_PARSING_FAILURE) &&
+            AgentJournal(ctx) != NULL) {
+        JournalDecoded(ctx->journal, status, &ctx->nData, &ctx->gData);
     }
-    return STANDARD_ERROR;
-}
\ No newline at end of file
+}
+
+/**
+ * Records what the agent sent in one run in its journal, if it has one and sent anything.
+ */
+static void AgentRecordSent(AgentContext *ctx, const char *outBuffer, int length)
+{
+    if (length > 0 && AgentJournal(ctx) != NULL) {
+        JournalBytes(ctx->journal, JOURNAL_EVENT_SENT, outBuffer, length);
+    }
+}
+
+/**
+ * Returns the next number from the agent's own xorshift generator. Every agent has its own so that
+ * games don't depend on each other, or on anything else calling rand().
+ * @param ctx The agent to draw a number for.
+ * @return A pseudo-random 32-bit number.
+ */
+static uint32_t AgentRandom(AgentContext *ctx)
+{
+    uint32_t x = ctx->randomState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    ctx->randomState = x;
+    return x;
+}
@@ -24,9 +24,18 @@
 #include "Uart1.h"
 #include "Field.h"
 #include "OledDriver.h"
+#include "OledDirty.h"
+#include "OledDma.h"
 #include "FieldOled.h"
+#include "Profile.h"
+#include "Scheduler.h"
 
 // **** Set any macros or preprocessor directives here ****
+// How long the LEDs stay on and off while blinking for a win, for an approximately 1Hz pattern.
+#define WIN_BLINK_TICKS SCHEDULER_MS_TO_TICKS(500)
+
+// The most received bytes handed to the agent at once.
+#define AGENT_INPUT_CHUNK_LEN 64
 
 // **** Declare any data types here ****
 
@@ -35,6 +44,7 @@ static uint32_t counter;
 static uint8_t buttonEvents;
 
 // **** Declare any function prototypes here ****
+static void RunAgent(const char *in, size_t len);
 
 int main()
 {
@@ -61,11 +71,15 @@ int main()
     LEDS_INIT();
 
     OledInit();
+    OledDmaInit();
 
     // Prompt the user to start the game and block until the first character press.
     OledDrawString("Press BTN4 to start.");
-    OledUpdate();
-    while ((buttonEvents & BUTTON_EVENT_4UP) == 0);
+    OledDirtyMarkAll();
+    PROFILE(PROFILE_OLED_UPDATE, OledDirtyUpdate());
+    while ((buttonEvents & BUTTON_EVENT_4UP) == 0) {
+        SchedulerIdle();
+    }
 
     // The first part of our seed is a hash of the compilation time string. The lowest-8 bits
     // are xor'd from the first-half of the string and the highest 8-bits are xor'd from the
@@ -85,51 +99,119 @@ int main()
 
     // Initialize the human agent.
     AgentInit();
+    PROFILE_RESET();
+
+    // Whether the profile and the journal have been dumped for the finished game.
+    uint8_t reported = FALSE;
+
+    // Once the agent has finished, how long the opponent has been quiet, and whether that was long
+    // enough for the game to be over on its side too.
+    SchedulerTimer quietTimer = {0, FALSE};
+    uint8_t linkQuiet = FALSE;
+
+    // Toggles the LEDs on and off once the enemy has been sunk.
+    SchedulerTimer blinkTimer = {0, FALSE};
+    uint8_t blinkOn = TRUE;
 
     while (TRUE) {
+        uint8_t events = SchedulerTakeEvents();
 
         // Check to see that the agent is still alive, updating the LED display as needed.
         uint8_t agentLives = AgentGetStatus();
-        LEDS_SET(agentLives);
 
-        // Also check if the enemy is still alive. If not, flash all the LEDs for this agent.
+        // Also check if the enemy is still alive. If not, blink the LEDs signifying the winner.
         uint8_t enemyLives = AgentGetEnemyStatus();
         if (enemyLives == 0) {
-            // Otherwise blink the LEDs signifying the winner. We just turn off all LEDs here,
-            // because they'll be turned back on at the beginning of the event loop. This creates
-            // an approximately 1Hz blinking pattern.
-            uint32_t i;
-            for (i = 0; i < 5000000; ++i);
-            LEDS_SET(0);
-            for (i = 0; i < 5000000; ++i);
-        }// Now only if the enemy is still alive do we run the main event loop.
-        else if (agentLives > 0) {
-            // Grab an ASCII byte from the UART to pass to the agent. 0 indicates no new data.
-            uint8_t inData = 0;
-            Uart1ReadByte(&inData);
-
-            // And then output this agents response
-            char outData[64];
-            int outDataLength = AgentRun((char) inData, outData);
-            if (outDataLength > 0) {
-                Uart1WriteData(outData, outDataLength);
+            if (!SchedulerTimerRunning(&blinkTimer)) {
+                SchedulerTimerStart(&blinkTimer, WIN_BLINK_TICKS);
+            }
+            if (SchedulerTimerExpired(&blinkTimer)) {
+                blinkOn = !blinkOn;
+                SchedulerTimerStart(&blinkTimer, WIN_BLINK_TICKS);
             }
+            LEDS_SET(blinkOn ? agentLives : 0);
+        } else {
+            LEDS_SET(agentLives);
         }
+
+        // Run the agent on every byte that has arrived since the last pass in one go. It runs even
+        // when there are none so that it can act on timers, like the one that holds back its next
+        // guess, and it keeps running once it has won or lost, as it then still answers the
+        // opponent's NAKs: if our last HIT was corrupted, the winner would otherwise never get it.
+        char inData[AGENT_INPUT_CHUNK_LEN];
+        size_t inDataLength = 0;
+        uint8_t datum;
+        while (inDataLength < AGENT_INPUT_CHUNK_LEN && Uart1ReadByte(&datum)) {
+            inData[inDataLength++] = (char) datum;
+        }
+        RunAgent(inData, inDataLength);
+
+        // Dump the profile and the journal, when they're built in. They go over UART1, which is the
+        // link to the opponent, so only once the game is over for both sides: our agent has won,
+        // lost or given up, and the opponent has sent nothing for AGENT_RETRY_TICKS, as it would
+        // have if it still needed our last message. After that BTN3 dumps them again.
+        AgentState state = AgentGetState();
+        if ((state != AGENT_STATE_WON && state != AGENT_STATE_LOST &&
+                state != AGENT_STATE_INVALID) || inDataLength > 0) {
+            SchedulerTimerStart(&quietTimer, AGENT_RETRY_TICKS);
+            linkQuiet = FALSE;
+        } else if (SchedulerTimerExpired(&quietTimer)) {
+            linkQuiet = TRUE;
+        }
+        if (linkQuiet && (!reported ||
+                ((events & SCHEDULER_EVENT_BUTTONS) && (buttonEvents & BUTTON_EVENT_3UP)))) {
+            reported = TRUE;
+            PROFILE_REPORT();
+#ifdef JOURNAL_DUMP_ENABLED
+            AgentDumpJournal();
+#endif
+        }
+
+        // Send anything the agent drew while the display was still busy with its previous update.
+        OledDirtyUpdate();
+
+        // Sleep until the next interrupt: a timer tick, a button, a byte from the UART or the end
+        // of a display transfer.
+        if (!Uart1HasData()) {
+            SchedulerIdle();
+        }
+    }
+}
+
+/**
+ * Runs the agent on the bytes received since the last pass and transmits whatever it responds with.
+ * @param in The received bytes.
+ * @param len The number of bytes in `in`, which may be 0.
+ */
+static void RunAgent(const char *in, size_t len)
+{
+    //room for every message to be answered by two sent again, too much for the stack
+    static char outData[AGENT_RUN_BUFFER_OUT_LEN(AGENT_INPUT_CHUNK_LEN)];
+    int outDataLength;
+    PROFILE(PROFILE_AGENT_RUN, outDataLength = AgentRunBuffer(in, len, outData));
+    if (outDataLength > 0) {
+        Uart1WriteData(outData, outDataLength);
     }
 }
 
 /**
- * This is the interrupt for the Timer2 peripheral. It just keeps incrementing a counter used to
- * track the time until the first user input.
+ * This is the interrupt for the Timer2 peripheral. It drives the scheduler's clock and keeps
+ * incrementing a counter used to track the time until the first user input.
  */
 void __ISR(_TIMER_2_VECTOR, IPL4AUTO) TimerInterrupt100Hz(void)
 {
     // Clear the interrupt flag.
     IFS0CLR = 1 << 8;
 
+    // Advance the scheduler, waking up the main loop.
+    SchedulerTick();
+
     // Increment a counter to see the srand() function.
     counter++;
 
     // Also check for any button events
     buttonEvents = ButtonsCheckEvents();
+    if (buttonEvents) {
+        SchedulerSignal(SCHEDULER_EVENT_BUTTONS);
+    }
 }
\ No newline at end of file
@@ -2,17 +2,85 @@
 #include "BOARD.h"
 #include "Protocol.h"
 
+const uint8_t fieldBoatLengths[FIELD_NUM_BOATS] = {
+#ifdef FIELD_FLEET
+    FIELD_FLEET
+#else
+    3, 4, 5, 6
+#endif
+};
 
-static int i, j, temp;
+/**
+ * Returns the length of the shortest boat in `alive`.
+ * @param alive A BoatStatus bitfield.
+ * @return The length of the shortest boat whose bit is set, or 0 if there are none.
+ */
+uint8_t FieldShortestBoat(uint8_t alive) {
+    uint8_t shortest = 0;
+    int b;
+    for (b = 0; b < FIELD_NUM_BOATS; b++) {
+        if ((alive & (1 << b)) && (shortest == 0 || fieldBoatLengths[b] < shortest)) {
+            shortest = fieldBoatLengths[b];
+        }
+    }
+    return shortest;
+}
+
+/*
+ * How an attack resolves on each FieldPosition. The low 4 bits hold the value the cell takes, the
+ * bit at FIELD_ATTACK_STRUCK_SHIFT is set if the shot is reported as a hit, which it is on boats
+ * and on cells that were already hit, and the bit at FIELD_ATTACK_BOAT_SHIFT is set on the parts of
+ * boats, whose number is kept from FIELD_ATTACK_NUMBER_SHIFT on.
+ */
+#define FIELD_ATTACK_AFTER_MASK 0x0F
+#define FIELD_ATTACK_STRUCK_SHIFT 4
+#define FIELD_ATTACK_BOAT_SHIFT 5
+#define FIELD_ATTACK_NUMBER_SHIFT 6
+#define FIELD_ATTACK(p) (FIELD_POSITION_IS_BOAT(p) ? \
+        FIELD_POSITION_HIT | 1 << FIELD_ATTACK_STRUCK_SHIFT | 1 << FIELD_ATTACK_BOAT_SHIFT | \
+                ((p) - FIELD_POSITION_SMALL_BOAT) << FIELD_ATTACK_NUMBER_SHIFT : \
+        (p) == FIELD_POSITION_HIT ? FIELD_POSITION_HIT | 1 << FIELD_ATTACK_STRUCK_SHIFT : \
+        FIELD_POSITION_MISS)
+
+static const uint16_t fieldAttack[16] = {
+    FIELD_ATTACK(0), FIELD_ATTACK(1), FIELD_ATTACK(2), FIELD_ATTACK(3),
+    FIELD_ATTACK(4), FIELD_ATTACK(5), FIELD_ATTACK(6), FIELD_ATTACK(7),
+    FIELD_ATTACK(8), FIELD_ATTACK(9), FIELD_ATTACK(10), FIELD_ATTACK(11),
+    FIELD_ATTACK(12), FIELD_ATTACK(13), FIELD_ATTACK(14), FIELD_ATTACK(15)
+};
+
+/**
+ * Resolves an attack on a cell holding `old`, for FieldRegisterEnemyAttack(): the boat it strikes,
+ * if any, loses a life and `gData->hit` is set, all without branching on the cell.
+ * @param f The field being attacked.
+ * @param old The value of the attacked cell.
+ * @param gData The attack, which receives its HitStatus.
+ * @return The value the attacked cell takes.
+ */
+FieldPosition FieldResolveAttack(Field *f, FieldPosition old, GuessData *gData) {
+    uint16_t entry = fieldAttack[old & 0xF];
+    uint8_t boat = entry >> FIELD_ATTACK_NUMBER_SHIFT;
+    uint8_t isBoat = (entry >> FIELD_ATTACK_BOAT_SHIFT) & 1;
+    //every other cell takes a life from the first boat and gives it straight back
+    uint8_t lives = f->boatLives[boat] - isBoat;
+    f->boatLives[boat] = lives;
+    gData->hit = HIT_MISS + ((entry >> FIELD_ATTACK_STRUCK_SHIFT) & 1) * (HIT_HIT - HIT_MISS) +
+            (isBoat & (lives == 0)) * (FIELD_HIT_SUNK(boat) - HIT_HIT);
+    return entry & FIELD_ATTACK_AFTER_MASK;
+}
+
+// The bitboard and packed layouts are implemented in FieldBitboard.c and FieldPacked.c instead.
+#if !defined(FIELD_BITBOARD) && !defined(FIELD_PACKED)
 
 /**
  * FieldInit() will fill the passed field array with the data specified in positionData. Also the
- * lives for each boat are filled according to the `BoatLives` enum.
+ * lives for each boat are filled according to `fieldBoatLengths`.
  * @param f The field to initialize.
  * @param p The data to initialize the entire field to, should be a member of enum
  *                     FieldPosition.
  */
 void FieldInit(Field *f, FieldPosition p) {
+    int i, j;
     for (i = 0; i < FIELD_ROWS; i++) {
         //fills field with 6 rows
         for (j = 0; j < FIELD_COLS; j++) {
@@ -21,10 +89,9 @@ void FieldInit(Field *f, FieldPosition p) {
         }
     }
     //initializes all the lives
-    f->hugeBoatLives = FIELD_BOAT_LIVES_HUGE;
-    f->largeBoatLives = FIELD_BOAT_LIVES_LARGE;
-    f->mediumBoatLives = FIELD_BOAT_LIVES_MEDIUM;
-    f->smallBoatLives = FIELD_BOAT_LIVES_SMALL;
+    for (i = 0; i < FIELD_NUM_BOATS; i++) {
+        f->boatLives[i] = fieldBoatLengths[i];
+    }
 }
 
 /**
@@ -35,6 +102,7 @@ void FieldInit(Field *f, FieldPosition p) {
  * @return
  */
 FieldPosition FieldAt(const Field *f, uint8_t row, uint8_t col) {
+    FieldPosition temp;
     //returns requested field position
     temp = f->field[row][col];
     return temp;
@@ -52,6 +120,7 @@ FieldPosition FieldAt(const Field *f, uint8_t row, uint8_t col) {
  * @return The old value at that field location
  */
 FieldPosition FieldSetLocation(Field *f, uint8_t row, uint8_t col, FieldPosition p) {
+    FieldPosition temp;
     //sets the current field position
     temp = FieldAt(f, row, col);
     f->field[row][col] = p;
@@ -89,11 +158,16 @@ FieldPosition FieldSetLocation(Field *f, uint8_t row, uint8_t col, FieldPosition
  * @param col The column that the boat will start from, valid range is from 0 and to FIELD_COLS - 1.
  * @param dir The direction that the boat will face once places, from the BoatDirection enum.
  * @param boatType The type of boat to place. Relies on the FIELD_POSITION_*_BOAT values from the
- * FieldPosition enum.
+ * FieldPosition enum. Its length comes from `fieldBoatLengths`.
  * @return TRUE for success, FALSE for failure
  */
 uint8_t FieldAddBoat(Field *f, uint8_t row, uint8_t col, BoatDirection dir, BoatType type) {
-    int BOATSIZE = (type + 3);
+    int i;
+    int BOATSIZE;
+    if (type >= FIELD_NUM_BOATS) {
+        return FALSE;
+    }
+    BOATSIZE = fieldBoatLengths[type];
     //adds boat while checking bounds, accounts for every direction
     if (dir == FIELD_BOAT_DIRECTION_NORTH) {
         if (col >= FIELD_COLS || col < 0) { 
@@ -112,15 +186,7 @@ uint8_t FieldAddBoat(Field *f, uint8_t row, uint8_t col, BoatDirection dir, Boat
         }
         for (i = 0; i < BOATSIZE; i++) {
             //add boat for respective size
-            if (BOATSIZE == 3) {
-                f->field[row - i][col] = FIELD_POSITION_SMALL_BOAT;
-            } else if (BOATSIZE == 4) {
-                f->field[row - i][col] = FIELD_POSITION_MEDIUM_BOAT;
-            } else if (BOATSIZE == 5) {
-                f->field[row - i][col] = FIELD_POSITION_LARGE_BOAT;
-            } else if (BOATSIZE == 6) {
-                f->field[row - i][col] = FIELD_POSITION_HUGE_BOAT;
-            }
+            f->field[row - i][col] = FIELD_POSITION_BOAT(type);
         }
     } else if (dir == FIELD_BOAT_DIRECTION_EAST) {
         if (row >= FIELD_ROWS || row < 0) {
@@ -135,15 +201,7 @@ uint8_t FieldAddBoat(Field *f, uint8_t row, uint8_t col, BoatDirection dir, Boat
             }
         }
         for (i = 0; i < BOATSIZE; i++) {
-            if (BOATSIZE == 3) {
-                f->field[row][col + i] = FIELD_POSITION_SMALL_BOAT;
-            } else if (BOATSIZE == 4) {
-                f->field[row][col + i] = FIELD_POSITION_MEDIUM_BOAT;
-            } else if (BOATSIZE == 5) {
-                f->field[row][col + i] = FIELD_POSITION_LARGE_BOAT;
-            } else if (BOATSIZE == 6) {
-                f->field[row][col + i] = FIELD_POSITION_HUGE_BOAT;
-            }
+            f->field[row][col + i] = FIELD_POSITION_BOAT(type);
         }
     } else if (dir == FIELD_BOAT_DIRECTION_SOUTH) {
         if (col >= FIELD_COLS || col < 0) {
@@ -158,15 +216,7 @@ uint8_t FieldAddBoat(Field *f, uint8_t row, uint8_t col, BoatDirection dir, Boat
             }
         }
         for (i = 0; i < BOATSIZE; i++) {
-            if (BOATSIZE == 3) {
-                f->field[row + i][col] = FIELD_POSITION_SMALL_BOAT;
-            } else if (BOATSIZE == 4) {
-                f->field[row + i][col] = FIELD_POSITION_MEDIUM_BOAT;
-            } else if (BOATSIZE == 5) {
-                f->field[row + i][col] = FIELD_POSITION_LARGE_BOAT;
-            } else if (BOATSIZE == 6) {
-                f->field[row + i][col] = FIELD_POSITION_HUGE_BOAT;
-            }
+            f->field[row + i][col] = FIELD_POSITION_BOAT(type);
         }
     } else if (dir == FIELD_BOAT_DIRECTION_WEST) {
         if (row >= FIELD_ROWS || row < 0) {
@@ -181,15 +231,7 @@ uint8_t FieldAddBoat(Field *f, uint8_t row, uint8_t col, BoatDirection dir, Boat
             }
         }
         for (i = 0; i < BOATSIZE; i++) {
-            if (BOATSIZE == 3) {
-                f->field[row][col - i] = FIELD_POSITION_SMALL_BOAT;
-            } else if (BOATSIZE == 4) {
-                f->field[row][col - i] = FIELD_POSITION_MEDIUM_BOAT;
-            } else if (BOATSIZE == 5) {
-                f->field[row][col - i] = FIELD_POSITION_LARGE_BOAT;
-            } else if (BOATSIZE == 6) {
-                f->field[row][col - i] = FIELD_POSITION_HUGE_BOAT;
-            }
+            f->field[row][col - i] = FIELD_POSITION_BOAT(type);
         }
     }
     return TRUE;
@@ -200,49 +242,22 @@ uint8_t FieldAddBoat(Field *f, uint8_t row, uint8_t col, BoatDirection dir, Boat
  * 'f' is updated with a FIELD_POSITION_HIT or FIELD_POSITION_MISS depending on what was at the
  * coordinates indicated in 'gData'. 'gData' is also updated with the proper HitStatus value
  * depending on what happened AND the value of that field position BEFORE it was attacked. Finally
- * this function also reduces the lives for any boat that was hit from this attack.
+ * this function also reduces the lives for any boat that was hit from this attack. Attacking a cell
+ * that was already hit reports HIT_HIT again and attacking a miss reports HIT_MISS again, without
+ * changing the field; attacks outside of the field are misses that change nothing.
  * @param f The field to check against and update.
  * @param gData The coordinates that were guessed. The HIT result is stored in gData->hit as an
  *               output.
  * @return The data that was stored at the field position indicated by gData before this attack.
  */
 FieldPosition FieldRegisterEnemyAttack(Field *f, GuessData *gData) {
-    temp = FieldAt(f, gData->row, gData->col); //store previous position in temp
-    switch (temp) { //if any field position is a boat its a hit
-        case(FIELD_POSITION_SMALL_BOAT):
-            f->smallBoatLives--;
-            if (f->smallBoatLives == 0) { //when lives run to 0 sink ship
-                gData->hit = HIT_SUNK_SMALL_BOAT;
-            } else gData->hit = HIT_HIT; //else if still alive update with a hit
-            break;
-        case(FIELD_POSITION_MEDIUM_BOAT):
-            f->mediumBoatLives--;
-            if (f->mediumBoatLives == 0) {
-                gData->hit = HIT_SUNK_MEDIUM_BOAT;
-            } else gData->hit = HIT_HIT;
-            break;
-        case(FIELD_POSITION_LARGE_BOAT):
-            f->largeBoatLives--;
-            if (f->largeBoatLives == 0) {
-                gData->hit = HIT_SUNK_LARGE_BOAT;
-            } else gData->hit = HIT_HIT;
-            break;
-        case(FIELD_POSITION_HUGE_BOAT):
-            f->hugeBoatLives--;
-            if (f->hugeBoatLives == 0) {
-                gData->hit = HIT_SUNK_HUGE_BOAT;
-            } else gData->hit = HIT_HIT;
-            break;
-        default: //if hit none of the ships update hit with miss
-            gData->hit = HIT_MISS;
-            break;
-    }
-    //update coordinates with either hits or misses
-    if (gData->hit == HIT_HIT) {
-        FieldSetLocation(f, gData->row, gData->col, FIELD_POSITION_HIT);
-    } else if (gData->hit == HIT_MISS) {
-        FieldSetLocation(f, gData->row, gData->col, FIELD_POSITION_MISS);
+    FieldPosition temp;
+    if (gData->row >= FIELD_ROWS || gData->col >= FIELD_COLS) { //there's nothing to hit out there
+        gData->hit = HIT_MISS;
+        return FIELD_POSITION_EMPTY;
     }
+    temp = f->field[gData->row][gData->col]; //store previous position in temp
+    f->field[gData->row][gData->col] = FieldResolveAttack(f, temp, gData);
     return temp; //keep old position data before attack
 }
 
@@ -260,44 +275,58 @@ FieldPosition FieldRegisterEnemyAttack(Field *f, GuessData *gData) {
  * registered.
  */
 FieldPosition FieldUpdateKnowledge(Field *f, const GuessData *gData) {
+    FieldPosition temp;
+    if (gData->row >= FIELD_ROWS || gData->col >= FIELD_COLS) { //there's nothing to learn out there
+        return FIELD_POSITION_UNKNOWN;
+    }
     //sets hits and misses and updates sunken ships
     temp = FieldAt(f, gData->row, gData->col);
     if (gData->hit != HIT_MISS) {
         FieldSetLocation(f, gData->row, gData->col, FIELD_POSITION_HIT);
-        if (gData->hit == HIT_SUNK_HUGE_BOAT) {
-            f->hugeBoatLives = 0;
-        } else if (gData->hit == HIT_SUNK_LARGE_BOAT) {
-            f->largeBoatLives = 0;
-        } else if (gData->hit == HIT_SUNK_MEDIUM_BOAT) {
-            f->mediumBoatLives = 0;
-        } else if (gData->hit == HIT_SUNK_SMALL_BOAT) {
-            f->smallBoatLives = 0;
+        if (FIELD_HIT_IS_SUNK(gData->hit)) {
+            f->boatLives[FIELD_HIT_SUNK_BOAT(gData->hit)] = 0;
         }
     } else FieldSetLocation(f, gData->row, gData->col, FIELD_POSITION_EMPTY);
     return temp; //returns position data
 }
 
 /**
- * This function returns the alive states of all 4 boats as a 4-bit bitfield (stored as a uint8).
- * The boats are ordered from smallest to largest starting at the least-significant bit. So that:
+ * This function returns the alive states of all boats as a bitfield (stored as a uint8), one bit
+ * per boat number starting at the least-significant bit. So that with the default fleet:
  * 0b00001010 indicates that the small boat and large boat are sunk, while the medium and huge boat
  * are still alive. See the BoatStatus enum for the bit arrangement.
  * @param f The field to grab data from.
- * @return A 4-bit value with each bit corresponding to whether each ship is alive or not.
+ * @return A FIELD_NUM_BOATS-bit value with each bit corresponding to whether each ship is alive or
+ *         not.
  */
 uint8_t FieldGetBoatStates(const Field *f) {
-    uint8_t BinaryStatus = 0b00001111;
-    if (f->hugeBoatLives == 0) { //toggles huge bit in binarystatus to 0
-        BinaryStatus ^= 0b00001000;
-    }
-    if (f->largeBoatLives == 0) { //toggles large bit in binarystatus to 0
-        BinaryStatus ^= 0b0000100;
-    }
-    if (f->mediumBoatLives == 0) { //toggles medium bit in binarystatus to 0
-        BinaryStatus ^= 0b00000010;
-    }
-    if (f->smallBoatLives == 0) { //toggles small bit in binarystatus to 0
-        BinaryStatus ^= 0b00000001;
+    uint8_t BinaryStatus = 0;
+    int i;
+    for (i = 0; i < FIELD_NUM_BOATS; i++) {
+        if (f->boatLives[i] != 0) { //sets the bit of every boat with lives left
+            BinaryStatus |= 1 << i;
+        }
     }
     return BinaryStatus;
-}
\ No newline at end of file
+}
+
+/**
+ * Counts how many locations of the field currently hold the given value.
+ * @param f The field to grab data from.
+ * @param p The FieldPosition value to count.
+ * @return The number of locations equal to `p`.
+ */
+uint16_t FieldCountPositions(const Field *f, FieldPosition p) {
+    int i, j;
+    uint16_t count = 0;
+    for (i = 0; i < FIELD_ROWS; i++) {
+        for (j = 0; j < FIELD_COLS; j++) {
+            if (f->field[i][j] == p) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+#endif // !FIELD_BITBOARD && !FIELD_PACKED
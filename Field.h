@@ -18,6 +18,26 @@
 #define FIELD_ROWS 6
 #endif
 
+/**
+ * The fleet each player places. Boats are numbered from 0, and every part of the engine looks up
+ * a boat's length in fieldBoatLengths[] by that number, so other rules can be simulated by
+ * defining both FIELD_NUM_BOATS and FIELD_FLEET, the list of lengths, at compile time. For example
+ * the standard 10x10 game is
+ *   -DFIELD_ROWS=10 -DFIELD_COLS=10 -DFIELD_NUM_BOATS=5 -DFIELD_FLEET=2,3,3,4,5
+ * By convention the boats are listed shortest first. Without an override the fleet is the four
+ * boats of lengths 3 to 6 named by BoatType.
+ */
+#ifdef FIELD_FLEET
+#ifndef FIELD_NUM_BOATS
+#error "FIELD_NUM_BOATS must be defined along with FIELD_FLEET"
+#endif
+#else
+#define FIELD_NUM_BOATS 4
+#endif
+#if FIELD_NUM_BOATS < 1 || FIELD_NUM_BOATS > 8
+#error "The boats afloat are reported as an 8-bit BoatStatus bitfield"
+#endif
+
 /**
  * Set different constants used for conveying different information about the different locations
  * of the field. These values should be used for the actual storage of the field state, which is
@@ -31,7 +51,8 @@ typedef enum {
     FIELD_POSITION_MEDIUM_BOAT,  // This position contains part of the medium boat.
     FIELD_POSITION_LARGE_BOAT,   // This position contains part of the large boat.
     FIELD_POSITION_HUGE_BOAT,   // This position contains part of the huge boat.
-    FIELD_POSITION_MISS,    // This position was attacked by the enemy, but was empty.
+    /// Every boat of the fleet has a value of its own like these, see FIELD_POSITION_BOAT()
+    FIELD_POSITION_MISS = FIELD_POSITION_SMALL_BOAT + FIELD_NUM_BOATS, // Attacked, but was empty.
 
     /// These denote field positions useful for representing the enemy's board
     FIELD_POSITION_UNKNOWN, // It is unknown what is here. Useful for denoting a position on the
@@ -41,22 +62,75 @@ typedef enum {
                             // cursor when selecting a position to attack.
 } FieldPosition;
 
+// The FieldPosition of the parts of boat `b`, and whether a FieldPosition is part of a boat.
+#define FIELD_POSITION_BOAT(b) ((FieldPosition) (FIELD_POSITION_SMALL_BOAT + (b)))
+#define FIELD_POSITION_IS_BOAT(p) \
+        ((p) >= FIELD_POSITION_SMALL_BOAT && (p) < FIELD_POSITION_SMALL_BOAT + FIELD_NUM_BOATS)
+
+// The HitStatus reporting that boat `b` was sunk, whether a HitStatus reports a sinking, and the
+// boat it sank.
+#define FIELD_HIT_SUNK(b) (HIT_SUNK_SMALL_BOAT + (b))
+#define FIELD_HIT_IS_SUNK(hit) \
+        ((hit) >= HIT_SUNK_SMALL_BOAT && (hit) < HIT_SUNK_SMALL_BOAT + FIELD_NUM_BOATS)
+#define FIELD_HIT_SUNK_BOAT(hit) ((hit) - HIT_SUNK_SMALL_BOAT)
+
+#if defined(FIELD_BITBOARD) && defined(FIELD_PACKED)
+#error "Only one of FIELD_BITBOARD and FIELD_PACKED may be defined"
+#endif
+
+#ifdef FIELD_BITBOARD
+#if FIELD_ROWS * FIELD_COLS > 64
+#error "FIELD_BITBOARD requires the whole field to fit within 64 cells"
+#endif
+
 /**
- * A struct for tracking all of the necessary data for an agent's field.
+ * A set of field positions, one bit per cell. Cell (row, col) is bit `row * FIELD_COLS + col`.
+ */
+typedef uint64_t FieldMask;
+
+/**
+ * A struct for tracking all of the necessary data for an agent's field, stored as bitboards. There
+ * is one mask per FieldPosition value, indexed by that value, and every cell is set in exactly one
+ * of them. This layout is only used when FIELD_BITBOARD is defined, as the OLED renderer in the
+ * support library reads the array layout below directly.
  */
 typedef struct {
-    FieldPosition field[FIELD_ROWS][FIELD_COLS];
-    uint8_t smallBoatLives;
-    uint8_t mediumBoatLives;
-    uint8_t largeBoatLives;
-    uint8_t hugeBoatLives;
+    FieldMask masks[FIELD_POSITION_CURSOR + 1];
+    uint8_t boatLives[FIELD_NUM_BOATS]; // The parts of each boat not yet hit, by boat number.
 } Field;
+#elif defined(FIELD_PACKED)
+
+// Every FieldPosition value fits in 4 bits, so two cells share a byte.
+#define FIELD_PACKED_BITS 4
+#define FIELD_PACKED_BYTES ((FIELD_ROWS * FIELD_COLS + 1) / 2)
+
+// How many 32-bit words the occupancy bitset takes, one bit per cell.
+#define FIELD_OCCUPANCY_WORDS ((FIELD_ROWS * FIELD_COLS + 31) / 32)
 
 /**
- * Specify how many boats there exist on the field. There is 1 boat of each of the 4 types, so 4
- * total.
+ * A struct for tracking all of the necessary data for an agent's field, packed for large fields.
+ * Cells are numbered `row * FIELD_COLS + col` and stored 4 bits each, the even-numbered cell of
+ * each byte in its low half. Alongside, one bit per cell in the same order marks the cells that
+ * aren't FIELD_POSITION_EMPTY, so that checking where a boat fits and counting empty cells don't
+ * have to unpack anything. A 32x32 field takes 644 bytes this way instead of 4KB as an array of
+ * enums. This layout is only used when FIELD_PACKED is defined, for the same reason as
+ * FIELD_BITBOARD.
  */
-#define FIELD_NUM_BOATS 4
+typedef struct {
+    uint8_t cells[FIELD_PACKED_BYTES];
+    uint32_t occupied[FIELD_OCCUPANCY_WORDS];
+    uint8_t boatLives[FIELD_NUM_BOATS]; // The parts of each boat not yet hit, by boat number.
+} Field;
+#else
+
+/**
+ * A struct for tracking all of the necessary data for an agent's field.
+ */
+typedef struct {
+    FieldPosition field[FIELD_ROWS][FIELD_COLS];
+    uint8_t boatLives[FIELD_NUM_BOATS]; // The parts of each boat not yet hit, by boat number.
+} Field;
+#endif
 
 /**
  * Declares direction constants for use with FieldAddShip.
@@ -70,7 +144,8 @@ typedef enum {
 
 /**
  * Constants for specifying which boat the current operation refers to. This is independent of the
- * FieldPosition enum.
+ * FieldPosition enum. They name the boats of the default fleet; with FIELD_FLEET a boat is simply
+ * its number, from 0 to FIELD_NUM_BOATS - 1.
  */
 typedef enum {
     FIELD_BOAT_SMALL,
@@ -81,7 +156,8 @@ typedef enum {
 
 /**
  * Track the alive state of the boats. They are arranged as as mutually-exclusive bits so that they
- * can be ORed together. Used for checking the return value of  `FieldGetBoatStates()`.
+ * can be ORed together. Used for checking the return value of  `FieldGetBoatStates()`. Boat `b` of
+ * any fleet is bit `1 << b`.
  */
 typedef enum {
     FIELD_BOAT_STATUS_SMALL  = 0x01,
@@ -90,19 +166,25 @@ typedef enum {
     FIELD_BOAT_STATUS_HUGE   = 0x08,
 } BoatStatus;
 
+// Every boat of the fleet afloat.
+#define FIELD_BOAT_STATUS_ALL ((uint8_t) ((1u << FIELD_NUM_BOATS) - 1))
+
 /**
- * This enum lists the number of lives, and therefore the number of squares, each boat has/occupies.
+ * The length of each boat of the fleet, and therefore the number of lives it starts with, indexed
+ * by boat number. Built from FIELD_FLEET, or the lengths 3 to 6 by default.
  */
-typedef enum {
-    FIELD_BOAT_LIVES_SMALL  = 3,
-    FIELD_BOAT_LIVES_MEDIUM = 4,
-    FIELD_BOAT_LIVES_LARGE  = 5,
-    FIELD_BOAT_LIVES_HUGE   = 6
-} BoatLives;
+extern const uint8_t fieldBoatLengths[FIELD_NUM_BOATS];
+
+/**
+ * Returns the length of the shortest boat in `alive`.
+ * @param alive A BoatStatus bitfield.
+ * @return The length of the shortest boat whose bit is set, or 0 if there are none.
+ */
+uint8_t FieldShortestBoat(uint8_t alive);
 
 /**
  * FieldInit() will fill the passed field array with the data specified in positionData. Also the
- * lives for each boat are filled according to the `BoatLives` enum.
+ * lives for each boat are filled according to `fieldBoatLengths`.
  * @param f The field to initialize.
  * @param p The data to initialize the entire field to, should be a member of enum
  *                     FieldPosition.
@@ -162,7 +244,7 @@ FieldPosition FieldSetLocation(Field *f, uint8_t row, uint8_t col, FieldPosition
  * @param col The column that the boat will start from, valid range is from 0 and to FIELD_COLS - 1.
  * @param dir The direction that the boat will face once places, from the BoatDirection enum.
  * @param boatType The type of boat to place. Relies on the FIELD_POSITION_*_BOAT values from the
- * FieldPosition enum.
+ * FieldPosition enum. Its length comes from `fieldBoatLengths`.
  * @return TRUE for success, FALSE for failure
  */
 uint8_t FieldAddBoat(Field *f, uint8_t row, uint8_t col, BoatDirection dir, BoatType type);
@@ -172,7 +254,9 @@ uint8_t FieldAddBoat(Field *f, uint8_t row, uint8_t col, BoatDirection dir, Boat
  * 'f' is updated with a FIELD_POSITION_HIT or FIELD_POSITION_MISS depending on what was at the
  * coordinates indicated in 'gData'. 'gData' is also updated with the proper HitStatus value
  * depending on what happened AND the value of that field position BEFORE it was attacked. Finally
- * this function also reduces the lives for any boat that was hit from this attack.
+ * this function also reduces the lives for any boat that was hit from this attack. Attacking a cell
+ * that was already hit reports HIT_HIT again and attacking a miss reports HIT_MISS again, without
+ * changing the field; attacks outside of the field are misses that change nothing.
  * @param f The field to check against and update.
  * @param gData The coordinates that were guessed. The HIT result is stored in gData->hit as an
  *               output.
@@ -180,6 +264,16 @@ uint8_t FieldAddBoat(Field *f, uint8_t row, uint8_t col, BoatDirection dir, Boat
  */
 FieldPosition FieldRegisterEnemyAttack(Field *f, GuessData *gData);
 
+/**
+ * The part of FieldRegisterEnemyAttack() shared by every layout: the boat at the attacked cell, if
+ * any, loses a life and `gData->hit` is set, all through a lookup table instead of branches.
+ * @param f The field being attacked.
+ * @param old The value of the attacked cell.
+ * @param gData The attack, which receives its HitStatus.
+ * @return The value the attacked cell takes.
+ */
+FieldPosition FieldResolveAttack(Field *f, FieldPosition old, GuessData *gData);
+
 /**
  * This function updates the FieldState representing the opponent's game board with whether the
  * guess indicated within gData was a hit or not. If it was a hit, then the field is updated with a
@@ -189,20 +283,44 @@ FieldPosition FieldRegisterEnemyAttack(Field *f, GuessData *gData);
  * was sunk, this function also clears a boats lives if it detects that the hit was a
  * HIT_SUNK_*_BOAT.
  * @param f The field to grab data from.
- * @param gData The coordinates that were guessed along with their HitStatus.
+ * @param gData The coordinates that were guessed along with their HitStatus. Coordinates outside
+ *              of the field change nothing.
  * @return The previous value of that coordinate position in the field before the hit/miss was
- * registered.
+ * registered, FIELD_POSITION_UNKNOWN outside of the field.
  */
 FieldPosition FieldUpdateKnowledge(Field *f, const GuessData *gData);
 
 /**
- * This function returns the alive states of all 4 boats as a 4-bit bitfield (stored as a uint8).
- * The boats are ordered from smallest to largest starting at the least-significant bit. So that:
+ * This function returns the alive states of all boats as a bitfield (stored as a uint8), one bit
+ * per boat number starting at the least-significant bit. So that with the default fleet:
  * 0b00001010 indicates that the small boat and large boat are sunk, while the medium and huge boat
  * are still alive. See the BoatStatus enum for the bit arrangement.
  * @param f The field to grab data from.
- * @return A 4-bit value with each bit corresponding to whether each ship is alive or not.
+ * @return A FIELD_NUM_BOATS-bit value with each bit corresponding to whether each ship is alive or
+ *         not.
  */
 uint8_t FieldGetBoatStates(const Field *f);
 
+/**
+ * Counts how many locations of the field currently hold the given value. With FIELD_BITBOARD this
+ * is a single population count, as it is for FIELD_POSITION_EMPTY with FIELD_PACKED.
+ * @param f The field to grab data from.
+ * @param p The FieldPosition value to count.
+ * @return The number of locations equal to `p`.
+ */
+uint16_t FieldCountPositions(const Field *f, FieldPosition p);
+
+/**
+ * Returns how many bits are set in `bits`. Every field layout and Placement count bits with this
+ * rather than __builtin_popcount(): the PIC32 has no popcount instruction, so the builtin becomes a
+ * libgcc call that is slower than these few shifts and masks.
+ */
+static inline uint8_t FieldPopcount(uint32_t bits)
+{
+    bits -= (bits >> 1) & 0x55555555;
+    bits = (bits & 0x33333333) + ((bits >> 2) & 0x33333333);
+    bits = (bits + (bits >> 4)) & 0x0F0F0F0F;
+    return (bits * 0x01010101) >> 24;
+}
+
 #endif // FIELD_H
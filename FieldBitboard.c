@@ -0,0 +1,182 @@
+/*
+ * Bitboard implementation of the Field interface, selected by defining FIELD_BITBOARD. The whole
+ * field fits in a single 64-bit word per FieldPosition value, so placement checks, attacks and
+ * counting are mask operations instead of walks over the cell array. See Field.h for the
+ * documentation of each function.
+ */
+#include "Field.h"
+#include "BOARD.h"
+#include "Protocol.h"
+
+#ifdef FIELD_BITBOARD
+
+#define FIELD_CELLS (FIELD_ROWS * FIELD_COLS)
+
+// Every cell of the field set.
+#define FIELD_MASK_ALL (~(FieldMask) 0 >> (64 - FIELD_CELLS))
+
+// The single cell at (row, col).
+#define FIELD_MASK_CELL(row, col) ((FieldMask) 1 << ((row) * FIELD_COLS + (col)))
+
+// How many cells of a mask are set, counted a 32-bit half at a time.
+#define FIELD_POPCOUNT(m) \
+    ((uint8_t) (FieldPopcount((uint32_t) (m)) + FieldPopcount((uint32_t) ((m) >> 32))))
+
+static FieldPosition FieldAttacked(const Field *f, int shift);
+
+void FieldInit(Field *f, FieldPosition p)
+{
+    int k;
+    for (k = 0; k <= FIELD_POSITION_CURSOR; k++) {
+        f->masks[k] = 0;
+    }
+    f->masks[p] = FIELD_MASK_ALL;
+    for (k = 0; k < FIELD_NUM_BOATS; k++) {
+        f->boatLives[k] = fieldBoatLengths[k];
+    }
+}
+
+FieldPosition FieldAt(const Field *f, uint8_t row, uint8_t col)
+{
+    int shift = row * FIELD_COLS + col;
+    FieldPosition p = FIELD_POSITION_EMPTY;
+    while (((f->masks[p] >> shift) & 1) == 0) {
+        p++;
+    }
+    return p;
+}
+
+FieldPosition FieldSetLocation(Field *f, uint8_t row, uint8_t col, FieldPosition p)
+{
+    FieldMask cell = FIELD_MASK_CELL(row, col);
+    FieldPosition old = FieldAt(f, row, col);
+    f->masks[old] &= ~cell;
+    f->masks[p] |= cell;
+    return old;
+}
+
+uint8_t FieldAddBoat(Field *f, uint8_t row, uint8_t col, BoatDirection dir, BoatType type)
+{
+    int length;
+    int first, stride, k;
+    FieldMask boat = 0;
+    if (row >= FIELD_ROWS || col >= FIELD_COLS || type >= FIELD_NUM_BOATS) {
+        return FALSE;
+    }
+    length = fieldBoatLengths[type];
+    //find the top-left end of the boat and the step along it
+    switch (dir) {
+    case FIELD_BOAT_DIRECTION_NORTH:
+        if (row + 1 < length) {
+            return FALSE;
+        }
+        first = (row - length + 1) * FIELD_COLS + col;
+        stride = FIELD_COLS;
+        break;
+    case FIELD_BOAT_DIRECTION_SOUTH:
+        if (row + length > FIELD_ROWS) {
+            return FALSE;
+        }
+        first = row * FIELD_COLS + col;
+        stride = FIELD_COLS;
+        break;
+    case FIELD_BOAT_DIRECTION_WEST:
+        if (col + 1 < length) {
+            return FALSE;
+        }
+        first = row * FIELD_COLS + col - length + 1;
+        stride = 1;
+        break;
+    case FIELD_BOAT_DIRECTION_EAST:
+        if (col + length > FIELD_COLS) {
+            return FALSE;
+        }
+        first = row * FIELD_COLS + col;
+        stride = 1;
+        break;
+    default:
+        return FALSE;
+    }
+    if (stride == 1) {
+        boat = (((FieldMask) 1 << length) - 1) << first;
+    } else {
+        for (k = 0; k < length; k++) {
+            boat |= (FieldMask) 1 << (first + k * stride);
+        }
+    }
+    //every cell under the boat has to be empty
+    if ((f->masks[FIELD_POSITION_EMPTY] & boat) != boat) {
+        return FALSE;
+    }
+    f->masks[FIELD_POSITION_EMPTY] &= ~boat;
+    f->masks[FIELD_POSITION_BOAT(type)] |= boat;
+    return TRUE;
+}
+
+FieldPosition FieldRegisterEnemyAttack(Field *f, GuessData *gData)
+{
+    FieldMask cell;
+    FieldPosition old;
+    if (gData->row >= FIELD_ROWS || gData->col >= FIELD_COLS) {
+        gData->hit = HIT_MISS;
+        return FIELD_POSITION_EMPTY;
+    }
+    cell = FIELD_MASK_CELL(gData->row, gData->col);
+    old = FieldAttacked(f, gData->row * FIELD_COLS + gData->col);
+    f->masks[old] &= ~cell;
+    f->masks[FieldResolveAttack(f, old, gData)] |= cell;
+    return old;
+}
+
+FieldPosition FieldUpdateKnowledge(Field *f, const GuessData *gData)
+{
+    FieldPosition old;
+    if (gData->row >= FIELD_ROWS || gData->col >= FIELD_COLS) {
+        return FIELD_POSITION_UNKNOWN;
+    }
+    if (gData->hit == HIT_MISS) {
+        return FieldSetLocation(f, gData->row, gData->col, FIELD_POSITION_EMPTY);
+    }
+    old = FieldSetLocation(f, gData->row, gData->col, FIELD_POSITION_HIT);
+    if (FIELD_HIT_IS_SUNK(gData->hit)) {
+        f->boatLives[FIELD_HIT_SUNK_BOAT(gData->hit)] = 0;
+    }
+    return old;
+}
+
+uint8_t FieldGetBoatStates(const Field *f)
+{
+    uint8_t states = 0;
+    int b;
+    for (b = 0; b < FIELD_NUM_BOATS; b++) {
+        states |= (f->boatLives[b] != 0) << b;
+    }
+    return states;
+}
+
+uint16_t FieldCountPositions(const Field *f, FieldPosition p)
+{
+    return FIELD_POPCOUNT(f->masks[p]);
+}
+
+/**
+ * Finds the value of a cell of a field of our own, which can only hold boats, misses, hits or
+ * nothing. Most cells hold nothing until late in the game; the rest are found by summing the value
+ * of every mask that might hold the cell rather than looking for it as FieldAt() does, because
+ * attacks land on them in no particular order.
+ */
+static FieldPosition FieldAttacked(const Field *f, int shift)
+{
+    FieldPosition p;
+    int k;
+    if ((f->masks[FIELD_POSITION_EMPTY] >> shift) & 1) {
+        return FIELD_POSITION_EMPTY;
+    }
+    p = FIELD_POSITION_HIT * ((f->masks[FIELD_POSITION_HIT] >> shift) & 1);
+    for (k = FIELD_POSITION_SMALL_BOAT; k <= FIELD_POSITION_MISS; k++) {
+        p += k * ((f->masks[k] >> shift) & 1);
+    }
+    return p;
+}
+
+#endif // FIELD_BITBOARD
@@ -0,0 +1,139 @@
+#include "FieldOledDirty.h"
+#include "Oled.h"
+#include "OledDirty.h"
+
+// The layout used by FieldOledDrawScreen(). Each field is a 52 pixel wide box at the given x
+// position, and each cell is a 3x4 pixel symbol on a 5 pixel grid inside of it.
+#define FIELD_OLED_MINE_X 0
+#define FIELD_OLED_THEIRS_X 76
+#define FIELD_OLED_CELL_X 2
+#define FIELD_OLED_CELL_Y 2
+#define FIELD_OLED_CELL_PITCH 5
+#define FIELD_OLED_SYMBOL_WIDTH 3
+#define FIELD_OLED_SYMBOL_HEIGHT 4
+#define FIELD_OLED_BOX_WIDTH 52
+
+// Where FieldOledDrawScreen() puts the 'P' and 'O' labels, and the turn indicator under them: '<'
+// under the 'P' or '>' under the 'O'.
+#define FIELD_OLED_TURN_MINE_X 53
+#define FIELD_OLED_TURN_THEIRS_X 69
+#define FIELD_OLED_TURN_Y 9
+#define FIELD_OLED_LABEL_Y 1
+
+/**
+ * The symbols for each FieldPosition, one 4-bit column per byte with the top pixel in the lowest
+ * bit. These are the same symbols FieldOledDrawScreen() uses. Boats beyond the four of the default
+ * fleet have no symbol of their own and are left blank.
+ */
+static const uint8_t symbols[FIELD_POSITION_CURSOR + 1][FIELD_OLED_SYMBOL_WIDTH] = {
+    [FIELD_POSITION_EMPTY] = {0x0, 0x0, 0x0},
+    [FIELD_POSITION_SMALL_BOAT] = {0x9, 0xB, 0xF},
+    [FIELD_POSITION_MEDIUM_BOAT] = {0x7, 0x4, 0xF},
+    [FIELD_POSITION_LARGE_BOAT] = {0xB, 0xB, 0xD},
+    [FIELD_POSITION_HUGE_BOAT] = {0xF, 0xD, 0xD},
+    [FIELD_POSITION_MISS] = {0x0, 0x6, 0x0},
+    [FIELD_POSITION_UNKNOWN] = {0x0, 0x6, 0x0},
+    [FIELD_POSITION_HIT] = {0x9, 0x6, 0x9},
+    [FIELD_POSITION_CURSOR] = {0xF, 0xF, 0xF}
+};
+
+static void FieldOledDirtyPutCell(const Field *f, int fieldX, uint8_t row, uint8_t col);
+static void FieldOledDirtyPutField(const Field *f, int fieldX);
+
+void FieldOledDirtyDrawScreen(const Field *myField, const Field *theirField,
+        FieldOledTurn playerTurn)
+{
+    OledClear(OLED_COLOR_BLACK);
+    FieldOledDirtyPutField(myField, FIELD_OLED_MINE_X);
+    FieldOledDirtyPutField(theirField, FIELD_OLED_THEIRS_X);
+    OledDrawChar(FIELD_OLED_TURN_MINE_X, FIELD_OLED_LABEL_Y, 'P');
+    OledDrawChar(FIELD_OLED_TURN_THEIRS_X, FIELD_OLED_LABEL_Y, 'O');
+    FieldOledDirtyDrawTurn(playerTurn);
+    OledDirtyMarkAll();
+}
+
+void FieldOledDirtyDrawCell(const Field *f, FieldOledDirtySide side, uint8_t row, uint8_t col)
+{
+    int fieldX = side == FIELD_OLED_DIRTY_MINE ? FIELD_OLED_MINE_X : FIELD_OLED_THEIRS_X;
+    if (row >= FIELD_ROWS || col >= FIELD_COLS) {
+        return;
+    }
+    FieldOledDirtyPutCell(f, fieldX, row, col);
+    OledDirtyMark(fieldX + FIELD_OLED_CELL_X + col * FIELD_OLED_CELL_PITCH,
+            FIELD_OLED_CELL_Y + row * FIELD_OLED_CELL_PITCH,
+            FIELD_OLED_SYMBOL_WIDTH, FIELD_OLED_SYMBOL_HEIGHT);
+}
+
+void FieldOledDirtyDrawTurn(FieldOledTurn playerTurn)
+{
+    OledDrawChar(FIELD_OLED_TURN_MINE_X, FIELD_OLED_TURN_Y,
+            playerTurn == FIELD_OLED_TURN_MINE ? '<' : ' ');
+    OledDrawChar(FIELD_OLED_TURN_THEIRS_X, FIELD_OLED_TURN_Y,
+            playerTurn == FIELD_OLED_TURN_THEIRS ? '>' : ' ');
+    OledDirtyMark(FIELD_OLED_TURN_MINE_X, FIELD_OLED_TURN_Y, ASCII_FONT_WIDTH, ASCII_FONT_HEIGHT);
+    OledDirtyMark(FIELD_OLED_TURN_THEIRS_X, FIELD_OLED_TURN_Y, ASCII_FONT_WIDTH, ASCII_FONT_HEIGHT);
+}
+
+/**
+ * Draws the symbol for one cell of a field into rgbOledBmp, without marking it.
+ * @param f The field the cell belongs to.
+ * @param fieldX The left edge of the field's box.
+ * @param row The row of the cell, which must be inside of the field.
+ * @param col The column of the cell, which must be inside of the field.
+ */
+static void FieldOledDirtyPutCell(const Field *f, int fieldX, uint8_t row, uint8_t col)
+{
+    FieldPosition p = FieldAt(f, row, col);
+    int x, y, page, shift, c;
+    uint8_t *top, *bottom;
+    if (p > FIELD_POSITION_CURSOR) {
+        return;
+    }
+    x = fieldX + FIELD_OLED_CELL_X + col * FIELD_OLED_CELL_PITCH;
+    y = FIELD_OLED_CELL_Y + row * FIELD_OLED_CELL_PITCH;
+    if (x + FIELD_OLED_SYMBOL_WIDTH > OLED_DRIVER_PIXEL_COLUMNS ||
+            y + FIELD_OLED_SYMBOL_HEIGHT > OLED_DRIVER_PIXEL_ROWS) {
+        //like FieldOledDrawScreen(), leave out cells of larger fields that don't fit on the screen
+        return;
+    }
+
+    // A symbol may straddle two pages, so each column is split over two bytes of rgbOledBmp.
+    page = y / OLED_DRIVER_BUFFER_LINE_HEIGHT;
+    shift = y % OLED_DRIVER_BUFFER_LINE_HEIGHT;
+    top = &rgbOledBmp[page * OLED_DRIVER_PIXEL_COLUMNS + x];
+    bottom = top + OLED_DRIVER_PIXEL_COLUMNS;
+    for (c = 0; c < FIELD_OLED_SYMBOL_WIDTH; c++) {
+        uint16_t mask = 0xF << shift;
+        uint16_t bits = symbols[p][c] << shift;
+        top[c] = (top[c] & ~mask) | bits;
+        if (shift + FIELD_OLED_SYMBOL_HEIGHT > OLED_DRIVER_BUFFER_LINE_HEIGHT) {
+            bottom[c] = (bottom[c] & ~(mask >> 8)) | (bits >> 8);
+        }
+    }
+}
+
+/**
+ * Draws the box around a field and all of its cells into a cleared rgbOledBmp, without marking
+ * them. The box runs along the top and bottom rows of the display.
+ * @param f The field to draw.
+ * @param fieldX The left edge of the field's box.
+ */
+static void FieldOledDirtyPutField(const Field *f, int fieldX)
+{
+    uint8_t *bottomPage = &rgbOledBmp[(OLED_DIRTY_PAGES - 1) * OLED_DRIVER_PIXEL_COLUMNS];
+    uint8_t row, col;
+    int i;
+    for (i = 0; i < FIELD_OLED_BOX_WIDTH; i++) {
+        rgbOledBmp[fieldX + i] |= 0x01;
+        bottomPage[fieldX + i] |= 0x80;
+    }
+    for (i = 0; i < OLED_DIRTY_PAGES; i++) {
+        rgbOledBmp[i * OLED_DRIVER_PIXEL_COLUMNS + fieldX] = 0xFF;
+        rgbOledBmp[i * OLED_DRIVER_PIXEL_COLUMNS + fieldX + FIELD_OLED_BOX_WIDTH - 1] = 0xFF;
+    }
+    for (row = 0; row < FIELD_ROWS; row++) {
+        for (col = 0; col < FIELD_COLS; col++) {
+            FieldOledDirtyPutCell(f, fieldX, row, col);
+        }
+    }
+}
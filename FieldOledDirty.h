@@ -0,0 +1,53 @@
+#ifndef FIELD_OLED_DIRTY_H
+#define FIELD_OLED_DIRTY_H
+
+#include <stdint.h>
+
+#include "Field.h"
+#include "FieldOled.h"
+
+/**
+ * FieldOledDirty updates a screen drawn by FieldOledDrawScreen() piece by piece. Between two turns
+ * only the attacked cell and the turn indicator change, so instead of redrawing and resending the
+ * whole frame these functions redraw just those into rgbOledBmp, in exactly the same layout as
+ * FieldOledDrawScreen(), and mark them with OledDirtyMark(). OledDirtyUpdate() then sends them.
+ *
+ * FieldOledDirtyDrawScreen() draws the whole screen in the same layout and marks all of it, so that
+ * a full redraw can be sent with OledDirtyUpdate() too instead of the blocking OledUpdate(). Either
+ * it or FieldOledDrawScreen() must have drawn the screen before any of the other functions are used.
+ */
+
+/**
+ * Which of the two fields on the screen to draw into.
+ */
+typedef enum {
+    FIELD_OLED_DIRTY_MINE,  // The agent's own field, on the left.
+    FIELD_OLED_DIRTY_THEIRS // What the agent knows of the enemy's field, on the right.
+} FieldOledDirtySide;
+
+/**
+ * Draws both fields and the turn indicator over the whole screen, exactly like FieldOledDrawScreen()
+ * but without sending anything to the display, and marks the whole display as changed.
+ * @param myField The agent's own field.
+ * @param theirField What the agent knows of the enemy's field.
+ * @param playerTurn Which agent currently has the turn.
+ */
+void FieldOledDirtyDrawScreen(const Field *myField, const Field *theirField,
+        FieldOledTurn playerTurn);
+
+/**
+ * Redraws a single cell of one of the fields. Coordinates outside of the field are ignored.
+ * @param f The field the cell belongs to.
+ * @param side Which of the two fields on the screen `f` is.
+ * @param row The row of the cell.
+ * @param col The column of the cell.
+ */
+void FieldOledDirtyDrawCell(const Field *f, FieldOledDirtySide side, uint8_t row, uint8_t col);
+
+/**
+ * Redraws the turn indicator between the two fields.
+ * @param playerTurn Which agent currently has the turn.
+ */
+void FieldOledDirtyDrawTurn(FieldOledTurn playerTurn);
+
+#endif // FIELD_OLED_DIRTY_H
@@ -0,0 +1,188 @@
+/*
+ * Packed implementation of the Field interface, selected by defining FIELD_PACKED. Each cell takes
+ * 4 bits instead of a whole enum, and a bitset of the cells that aren't empty answers the questions
+ * placement and counting ask most without unpacking anything, so that large fields fit in the
+ * PIC32's RAM and many small ones fit in a cache line on the host. See Field.h for the
+ * documentation of each function.
+ */
+#include "Field.h"
+#include "BOARD.h"
+#include "Protocol.h"
+
+#include <string.h>
+
+#ifdef FIELD_PACKED
+
+#define FIELD_CELLS (FIELD_ROWS * FIELD_COLS)
+
+// The number of cell (row, col).
+#define FIELD_CELL(row, col) ((uint16_t) (row) * FIELD_COLS + (col))
+
+// The value of each half of a byte.
+#define FIELD_PACKED_MASK 0x0F
+
+static FieldPosition FieldGet(const Field *f, uint16_t cell);
+static void FieldPut(Field *f, uint16_t cell, FieldPosition p);
+
+void FieldInit(Field *f, FieldPosition p)
+{
+    int w, k;
+    memset(f->cells, p | (p << FIELD_PACKED_BITS), sizeof(f->cells));
+    memset(f->occupied, p == FIELD_POSITION_EMPTY ? 0x00 : 0xFF, sizeof(f->occupied));
+    //keep the bits past the last cell clear, so that population counts only count cells
+    if (p != FIELD_POSITION_EMPTY && FIELD_CELLS % 32) {
+        w = FIELD_OCCUPANCY_WORDS - 1;
+        f->occupied[w] = ((uint32_t) 1 << (FIELD_CELLS % 32)) - 1;
+    }
+    for (k = 0; k < FIELD_NUM_BOATS; k++) {
+        f->boatLives[k] = fieldBoatLengths[k];
+    }
+}
+
+FieldPosition FieldAt(const Field *f, uint8_t row, uint8_t col)
+{
+    return FieldGet(f, FIELD_CELL(row, col));
+}
+
+FieldPosition FieldSetLocation(Field *f, uint8_t row, uint8_t col, FieldPosition p)
+{
+    uint16_t cell = FIELD_CELL(row, col);
+    FieldPosition old = FieldGet(f, cell);
+    FieldPut(f, cell, p);
+    return old;
+}
+
+uint8_t FieldAddBoat(Field *f, uint8_t row, uint8_t col, BoatDirection dir, BoatType type)
+{
+    int length;
+    int stride, k;
+    uint16_t first, cell;
+    if (row >= FIELD_ROWS || col >= FIELD_COLS || type >= FIELD_NUM_BOATS) {
+        return FALSE;
+    }
+    length = fieldBoatLengths[type];
+    //find the top-left end of the boat and the step along it
+    switch (dir) {
+    case FIELD_BOAT_DIRECTION_NORTH:
+        if (row + 1 < length) {
+            return FALSE;
+        }
+        first = FIELD_CELL(row - length + 1, col);
+        stride = FIELD_COLS;
+        break;
+    case FIELD_BOAT_DIRECTION_SOUTH:
+        if (row + length > FIELD_ROWS) {
+            return FALSE;
+        }
+        first = FIELD_CELL(row, col);
+        stride = FIELD_COLS;
+        break;
+    case FIELD_BOAT_DIRECTION_WEST:
+        if (col + 1 < length) {
+            return FALSE;
+        }
+        first = FIELD_CELL(row, col - length + 1);
+        stride = 1;
+        break;
+    case FIELD_BOAT_DIRECTION_EAST:
+        if (col + length > FIELD_COLS) {
+            return FALSE;
+        }
+        first = FIELD_CELL(row, col);
+        stride = 1;
+        break;
+    default:
+        return FALSE;
+    }
+    //every cell under the boat has to be empty
+    for (k = 0, cell = first; k < length; k++, cell += stride) {
+        if (f->occupied[cell >> 5] & ((uint32_t) 1 << (cell & 31))) {
+            return FALSE;
+        }
+    }
+    for (k = 0, cell = first; k < length; k++, cell += stride) {
+        FieldPut(f, cell, FIELD_POSITION_BOAT(type));
+    }
+    return TRUE;
+}
+
+FieldPosition FieldRegisterEnemyAttack(Field *f, GuessData *gData)
+{
+    uint16_t cell;
+    FieldPosition old;
+    if (gData->row >= FIELD_ROWS || gData->col >= FIELD_COLS) {
+        gData->hit = HIT_MISS;
+        return FIELD_POSITION_EMPTY;
+    }
+    cell = FIELD_CELL(gData->row, gData->col);
+    old = FieldGet(f, cell);
+    FieldPut(f, cell, FieldResolveAttack(f, old, gData));
+    return old;
+}
+
+FieldPosition FieldUpdateKnowledge(Field *f, const GuessData *gData)
+{
+    FieldPosition old;
+    if (gData->row >= FIELD_ROWS || gData->col >= FIELD_COLS) {
+        return FIELD_POSITION_UNKNOWN;
+    }
+    if (gData->hit == HIT_MISS) {
+        return FieldSetLocation(f, gData->row, gData->col, FIELD_POSITION_EMPTY);
+    }
+    old = FieldSetLocation(f, gData->row, gData->col, FIELD_POSITION_HIT);
+    if (FIELD_HIT_IS_SUNK(gData->hit)) {
+        f->boatLives[FIELD_HIT_SUNK_BOAT(gData->hit)] = 0;
+    }
+    return old;
+}
+
+uint8_t FieldGetBoatStates(const Field *f)
+{
+    uint8_t states = 0;
+    int b;
+    for (b = 0; b < FIELD_NUM_BOATS; b++) {
+        states |= (f->boatLives[b] != 0) << b;
+    }
+    return states;
+}
+
+uint16_t FieldCountPositions(const Field *f, FieldPosition p)
+{
+    uint16_t count = 0, cell;
+    int w;
+    if (p == FIELD_POSITION_EMPTY) {
+        for (w = 0; w < FIELD_OCCUPANCY_WORDS; w++) {
+            count += FieldPopcount(f->occupied[w]);
+        }
+        return FIELD_CELLS - count;
+    }
+    for (cell = 0; cell < FIELD_CELLS; cell++) {
+        count += FieldGet(f, cell) == p;
+    }
+    return count;
+}
+
+/**
+ * Unpacks the value of a cell.
+ */
+static FieldPosition FieldGet(const Field *f, uint16_t cell)
+{
+    return (f->cells[cell >> 1] >> ((cell & 1) * FIELD_PACKED_BITS)) & FIELD_PACKED_MASK;
+}
+
+/**
+ * Packs a new value into a cell and keeps its occupancy bit up to date.
+ */
+static void FieldPut(Field *f, uint16_t cell, FieldPosition p)
+{
+    int shift = (cell & 1) * FIELD_PACKED_BITS;
+    uint32_t bit = (uint32_t) 1 << (cell & 31);
+    f->cells[cell >> 1] = (f->cells[cell >> 1] & ~(FIELD_PACKED_MASK << shift)) | (p << shift);
+    if (p == FIELD_POSITION_EMPTY) {
+        f->occupied[cell >> 5] &= ~bit;
+    } else {
+        f->occupied[cell >> 5] |= bit;
+    }
+}
+
+#endif // FIELD_PACKED
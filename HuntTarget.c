@@ -0,0 +1,319 @@
+#include "HuntTarget.h"
+#include "BOARD.h"
+
+#include <string.h>
+
+// The bits of a row mask that are on the field.
+#define HUNT_TARGET_ROW_MASK ((uint32_t) -1 >> (32 - FIELD_COLS))
+
+#define HUNT_TARGET_BIT(col) ((uint32_t) 1 << (col))
+
+static uint8_t HuntTargetExplained(const HuntTargetState *h, const uint32_t open[FIELD_ROWS]);
+static void HuntTargetResolve(HuntTargetState *h, int row, int col, int length);
+static void HuntTargetAddNeighbours(const HuntTargetState *h, uint32_t cells[FIELD_ROWS],
+        int row, int col);
+static uint8_t HuntTargetPick(const TargetingState *t, const uint32_t cells[FIELD_ROWS],
+        uint32_t random, GuessData *guess);
+
+/**
+ * Resets the state for a fresh enemy field.
+ * @param h The state to initialize.
+ */
+void HuntTargetInit(HuntTargetState *h)
+{
+    memset(h, 0, sizeof(*h));
+    h->alive = FIELD_BOAT_STATUS_ALL;
+}
+
+/**
+ * Records the result of one of our shots.
+ * @param h The state to update.
+ * @param result The coordinates of the shot along with its HitStatus.
+ */
+void HuntTargetUpdate(HuntTargetState *h, const GuessData *result)
+{
+    int b;
+    if (result->row >= FIELD_ROWS || result->col >= FIELD_COLS) {
+        return;
+    }
+    h->shot[result->row] |= HUNT_TARGET_BIT(result->col);
+    if (result->hit == HIT_MISS) {
+        return;
+    }
+    h->open[result->row] |= HUNT_TARGET_BIT(result->col);
+    if (FIELD_HIT_IS_SUNK(result->hit)) {
+        b = FIELD_HIT_SUNK_BOAT(result->hit);
+        if (h->alive & (1 << b)) {
+            h->alive &= ~(1 << b);
+            HuntTargetResolve(h, result->row, result->col, fieldBoatLengths[b]);
+        }
+    }
+}
+
+/**
+ * Chooses the next cell to fire at.
+ * @param h The current state.
+ * @param t The targeting state for the same field, used to rank otherwise equal cells.
+ * @param random A random number used to pick among equally good cells.
+ * @param guess Receives the row and column to fire at.
+ */
+void HuntTargetChoose(const HuntTargetState *h, const TargetingState *t, uint32_t random,
+        GuessData *guess)
+{
+    uint32_t lattice[FIELD_ROWS];
+    uint32_t bestTotal = 0;
+    int row, col, length, offset, bestOffset = 0;
+
+    if (HuntTargetChooseTarget(h, t, random, guess)) {
+        return;
+    }
+
+    //hunt: every boat left crosses a lattice spaced by the smallest one's length, so pick the
+    //lattice with the most placements on its cells
+    length = FieldShortestBoat(h->alive);
+    if (length == 0) {
+        length = 1;
+    }
+    for (offset = 0; offset < length; offset++) {
+        uint32_t total = 0;
+        for (row = 0; row < FIELD_ROWS; row++) {
+            for (col = 0; col < FIELD_COLS; col++) {
+                if ((row + col) % length == offset && (h->shot[row] & HUNT_TARGET_BIT(col)) == 0) {
+                    total += t->density[row][col];
+                }
+            }
+        }
+        if (total > bestTotal) {
+            bestTotal = total;
+            bestOffset = offset;
+        }
+    }
+    for (row = 0; row < FIELD_ROWS; row++) {
+        lattice[row] = 0;
+        for (col = 0; col < FIELD_COLS; col++) {
+            if ((row + col) % length == bestOffset) {
+                lattice[row] |= HUNT_TARGET_BIT(col);
+            }
+        }
+        lattice[row] &= ~h->shot[row];
+    }
+    if (HuntTargetPick(t, lattice, random, guess)) {
+        return;
+    }
+    for (row = 0; row < FIELD_ROWS; row++) {
+        lattice[row] = ~h->shot[row] & HUNT_TARGET_ROW_MASK;
+    }
+    if (!HuntTargetPick(t, lattice, random, guess)) {
+        guess->row = 0;
+        guess->col = 0;
+    }
+}
+
+/**
+ * Chooses the next cell to fire at next to the open hits, if there are any.
+ * @param h The current state.
+ * @param t The targeting state for the same field, used to rank otherwise equal cells.
+ * @param random A random number used to pick among equally good cells.
+ * @param guess Receives the row and column to fire at.
+ * @return TRUE if a cell was chosen, FALSE if there's nothing to target and `guess` is untouched.
+ */
+uint8_t HuntTargetChooseTarget(const HuntTargetState *h, const TargetingState *t,
+        uint32_t random, GuessData *guess)
+{
+    uint32_t ends[FIELD_ROWS] = {0}, around[FIELD_ROWS] = {0};
+    int row, col, a, z;
+
+    //target: extend every run of open hits along its axis, or probe around a lone hit
+    for (row = 0; row < FIELD_ROWS; row++) {
+        for (col = 0; col < FIELD_COLS; col++) {
+            uint8_t across, down;
+            if ((h->open[row] & HUNT_TARGET_BIT(col)) == 0) {
+                continue;
+            }
+            across = (col > 0 && (h->open[row] & HUNT_TARGET_BIT(col - 1))) ||
+                    (col + 1 < FIELD_COLS && (h->open[row] & HUNT_TARGET_BIT(col + 1)));
+            down = (row > 0 && (h->open[row - 1] & HUNT_TARGET_BIT(col))) ||
+                    (row + 1 < FIELD_ROWS && (h->open[row + 1] & HUNT_TARGET_BIT(col)));
+            if (across) {
+                for (a = col; a > 0 && (h->open[row] & HUNT_TARGET_BIT(a - 1)); a--);
+                for (z = col; z + 1 < FIELD_COLS && (h->open[row] & HUNT_TARGET_BIT(z + 1)); z++);
+                if (a > 0) {
+                    ends[row] |= HUNT_TARGET_BIT(a - 1);
+                }
+                if (z + 1 < FIELD_COLS) {
+                    ends[row] |= HUNT_TARGET_BIT(z + 1);
+                }
+            }
+            if (down) {
+                for (a = row; a > 0 && (h->open[a - 1] & HUNT_TARGET_BIT(col)); a--);
+                for (z = row; z + 1 < FIELD_ROWS && (h->open[z + 1] & HUNT_TARGET_BIT(col)); z++);
+                if (a > 0) {
+                    ends[a - 1] |= HUNT_TARGET_BIT(col);
+                }
+                if (z + 1 < FIELD_ROWS) {
+                    ends[z + 1] |= HUNT_TARGET_BIT(col);
+                }
+            }
+            if (!across && !down) {
+                HuntTargetAddNeighbours(h, ends, row, col);
+            }
+            HuntTargetAddNeighbours(h, around, row, col);
+        }
+    }
+    for (row = 0; row < FIELD_ROWS; row++) {
+        ends[row] &= ~h->shot[row];
+    }
+    //when both ends of every run are blocked the hits must belong to boats lying side by side
+    return HuntTargetPick(t, ends, random, guess) || HuntTargetPick(t, around, random, guess);
+}
+
+/**
+ * Returns whether each hit in `open` lies on some placement of a boat that is still afloat which
+ * only crosses open hits and cells that haven't been fired at.
+ */
+static uint8_t HuntTargetExplained(const HuntTargetState *h, const uint32_t open[FIELD_ROWS])
+{
+    uint32_t allowed[FIELD_ROWS];
+    int row, col, b, s, k;
+    for (row = 0; row < FIELD_ROWS; row++) {
+        allowed[row] = (open[row] | ~h->shot[row]) & HUNT_TARGET_ROW_MASK;
+    }
+    for (row = 0; row < FIELD_ROWS; row++) {
+        for (col = 0; col < FIELD_COLS; col++) {
+            uint8_t explained = FALSE;
+            if ((open[row] & HUNT_TARGET_BIT(col)) == 0) {
+                continue;
+            }
+            for (b = 0; b < FIELD_NUM_BOATS && !explained; b++) {
+                int length = fieldBoatLengths[b];
+                uint32_t mask = (HUNT_TARGET_BIT(length) - 1);
+                if ((h->alive & (1 << b)) == 0) {
+                    continue;
+                }
+                for (s = col - length + 1; s <= col && !explained; s++) {
+                    explained = s >= 0 && s + length <= FIELD_COLS &&
+                            (allowed[row] & (mask << s)) == (mask << s);
+                }
+                for (s = row - length + 1; s <= row && !explained; s++) {
+                    if (s < 0 || s + length > FIELD_ROWS) {
+                        continue;
+                    }
+                    for (k = s; k < s + length && (allowed[k] & HUNT_TARGET_BIT(col)); k++);
+                    explained = k == s + length;
+                }
+            }
+            if (!explained) {
+                return FALSE;
+            }
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * Works out which open hits made up a boat of `length` that was just sunk by a shot at (row, col),
+ * and moves them from the open frontier to the sunk cells. The boat is a straight run of open hits
+ * through that shot; out of the possible runs, the first one that leaves every other open hit
+ * explainable by a boat still afloat is taken.
+ */
+static void HuntTargetResolve(HuntTargetState *h, int row, int col, int length)
+{
+    uint32_t chosen[FIELD_ROWS] = {0}, remaining[FIELD_ROWS];
+    uint8_t found = FALSE;
+    int s, k, vertical;
+    for (vertical = 0; vertical < 2 && !found; vertical++) {
+        int shot = vertical ? row : col, limit = vertical ? FIELD_ROWS : FIELD_COLS;
+        for (s = shot - length + 1; s <= shot && !found; s++) {
+            uint8_t explained;
+            if (s < 0 || s + length > limit) {
+                continue;
+            }
+            memcpy(remaining, h->open, sizeof(remaining));
+            for (k = s; k < s + length; k++) {
+                int r = vertical ? k : row, c = vertical ? col : k;
+                if ((remaining[r] & HUNT_TARGET_BIT(c)) == 0) {
+                    break;
+                }
+                remaining[r] &= ~HUNT_TARGET_BIT(c);
+            }
+            if (k < s + length) {
+                continue;
+            }
+            //keep the first run that fits, in case none of them explains the other hits
+            explained = HuntTargetExplained(h, remaining);
+            if (explained || chosen[row] == 0) {
+                for (k = 0; k < FIELD_ROWS; k++) {
+                    chosen[k] = h->open[k] & ~remaining[k];
+                }
+                found = explained;
+            }
+        }
+    }
+    if (chosen[row] == 0) {
+        //no run of hits fits the boat, so at least take the shot that sank it off the frontier
+        chosen[row] = HUNT_TARGET_BIT(col);
+    }
+    for (k = 0; k < FIELD_ROWS; k++) {
+        h->open[k] &= ~chosen[k];
+        h->sunk[k] |= chosen[k];
+    }
+}
+
+/**
+ * Adds the four cells next to (row, col) that haven't been fired at to `cells`.
+ */
+static void HuntTargetAddNeighbours(const HuntTargetState *h, uint32_t cells[FIELD_ROWS],
+        int row, int col)
+{
+    if (row > 0) {
+        cells[row - 1] |= HUNT_TARGET_BIT(col) & ~h->shot[row - 1];
+    }
+    if (row + 1 < FIELD_ROWS) {
+        cells[row + 1] |= HUNT_TARGET_BIT(col) & ~h->shot[row + 1];
+    }
+    if (col > 0) {
+        cells[row] |= HUNT_TARGET_BIT(col - 1) & ~h->shot[row];
+    }
+    if (col + 1 < FIELD_COLS) {
+        cells[row] |= HUNT_TARGET_BIT(col + 1) & ~h->shot[row];
+    }
+}
+
+/**
+ * Picks the cell in `cells` with the highest placement density, breaking ties with `random`.
+ * @return TRUE if `cells` had any cell in it, FALSE if it was empty and `guess` is untouched.
+ */
+static uint8_t HuntTargetPick(const TargetingState *t, const uint32_t cells[FIELD_ROWS],
+        uint32_t random, GuessData *guess)
+{
+    uint32_t best = 0;
+    int ties = 0, row, col;
+    for (row = 0; row < FIELD_ROWS; row++) {
+        for (col = 0; col < FIELD_COLS; col++) {
+            if ((cells[row] & HUNT_TARGET_BIT(col)) == 0) {
+                continue;
+            }
+            if (ties == 0 || t->density[row][col] > best) {
+                best = t->density[row][col];
+                ties = 1;
+            } else if (t->density[row][col] == best) {
+                ties++;
+            }
+        }
+    }
+    if (ties == 0) {
+        return FALSE;
+    }
+    ties = random % ties;
+    for (row = 0; row < FIELD_ROWS; row++) {
+        for (col = 0; col < FIELD_COLS; col++) {
+            if ((cells[row] & HUNT_TARGET_BIT(col)) && t->density[row][col] == best &&
+                    ties-- == 0) {
+                guess->row = row;
+                guess->col = col;
+                return TRUE;
+            }
+        }
+    }
+    return FALSE;
+}
@@ -0,0 +1,80 @@
+#ifndef HUNT_TARGET_H
+#define HUNT_TARGET_H
+
+#include <stdint.h>
+
+#include "Field.h"
+#include "Protocol.h"
+#include "Targeting.h"
+
+/**
+ * HuntTarget aims the way a person would. While it has no lead it hunts, firing only at a lattice
+ * of cells spaced by the length of the smallest boat still afloat, as every placement of every boat
+ * left has to cross one of them. Once something is hit it switches to targeting: hits that don't
+ * yet belong to a sunk boat form the open frontier, and where two of them line up the boat's axis
+ * is taken to be known and the run of hits is extended at either end. A lone hit is probed on all
+ * four sides.
+ *
+ * The knowledge field only records that a boat was sunk, not which hits were part of it. When a
+ * HIT_SUNK_* result comes in, the sunk boat's length is used to work out which run of open hits
+ * through the final shot it consisted of, preferring a run that leaves every other open hit still
+ * explainable by a boat that is afloat. Those hits then leave the frontier, so targeting carries on
+ * only with hits that belong to boats still afloat.
+ *
+ * Among equally suitable cells, the one covered by the most legal placements in the TargetingState
+ * is chosen, then one at random.
+ */
+
+#if FIELD_COLS > 32
+#error "HuntTarget keeps each row of the field in a 32-bit mask"
+#endif
+
+/**
+ * What the hunt/target mode knows about the enemy's field, as one mask per row with bit `col` for
+ * each cell.
+ */
+typedef struct {
+    uint32_t shot[FIELD_ROWS]; // Cells that have been fired at.
+    uint32_t open[FIELD_ROWS]; // Hits that haven't been attributed to a sunk boat yet.
+    uint32_t sunk[FIELD_ROWS]; // Hits attributed to a sunk boat.
+    uint8_t alive;             // The boats still afloat, as a BoatStatus bitfield.
+} HuntTargetState;
+
+/**
+ * Resets the state for a fresh enemy field.
+ * @param h The state to initialize.
+ */
+void HuntTargetInit(HuntTargetState *h);
+
+/**
+ * Records the result of one of our shots. A HIT_SUNK_* result moves the hits making up the sunk
+ * boat out of the open frontier.
+ * @param h The state to update.
+ * @param result The coordinates of the shot along with its HitStatus.
+ */
+void HuntTargetUpdate(HuntTargetState *h, const GuessData *result);
+
+/**
+ * Chooses the next cell to fire at: next to the open hits when there are any, otherwise on the
+ * hunting lattice.
+ * @param h The current state.
+ * @param t The targeting state for the same field, used to rank otherwise equal cells.
+ * @param random A random number used to pick among equally good cells.
+ * @param guess Receives the row and column to fire at.
+ */
+void HuntTargetChoose(const HuntTargetState *h, const TargetingState *t, uint32_t random,
+        GuessData *guess);
+
+/**
+ * Chooses the next cell to fire at next to the open hits, if there are any. This is the targeting
+ * half of HuntTargetChoose(), for callers that hunt some other way.
+ * @param h The current state.
+ * @param t The targeting state for the same field, used to rank otherwise equal cells.
+ * @param random A random number used to pick among equally good cells.
+ * @param guess Receives the row and column to fire at.
+ * @return TRUE if a cell was chosen, FALSE if there's nothing to target and `guess` is untouched.
+ */
+uint8_t HuntTargetChooseTarget(const HuntTargetState *h, const TargetingState *t,
+        uint32_t random, GuessData *guess);
+
+#endif // HUNT_TARGET_H
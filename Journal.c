@@ -0,0 +1,113 @@
+#include "Journal.h"
+
+#include <stdio.h>
+
+#include "BOARD.h"
+#include "Field.h"
+#include "Scheduler.h"
+
+// The number of bytes printed on each line of a dump.
+#define JOURNAL_DUMP_LINE 32
+
+// Stores one byte, over the oldest one once the buffer is full.
+#define JOURNAL_PUT(j, b) ((j)->data[(j)->length++ & (JOURNAL_SIZE - 1)] = (uint8_t) (b))
+
+static void JournalStart(Journal *j, JournalEvent event);
+static void JournalPutValue(Journal *j, uint32_t value);
+
+void JournalInit(Journal *j)
+{
+    j->length = 0;
+    j->tick = SchedulerNow();
+    //the first stamp holds the tick itself
+    JOURNAL_PUT(j, JOURNAL_EVENT_TICK);
+    JournalPutValue(j, j->tick);
+}
+
+void JournalValue(Journal *j, JournalEvent event, uint32_t value)
+{
+    JournalStart(j, event);
+    JournalPutValue(j, value);
+}
+
+void JournalBytes(Journal *j, JournalEvent event, const char *data, size_t length)
+{
+    size_t i;
+    JournalStart(j, event);
+    JournalPutValue(j, length);
+    for (i = 0; i < length; i++) {
+        JOURNAL_PUT(j, data[i]);
+    }
+}
+
+void JournalDecoded(Journal *j, ProtocolParserStatus status, const NegotiationData *nData,
+        const GuessData *gData)
+{
+    JournalValue(j, JOURNAL_EVENT_DECODED, (uint8_t) status);
+    switch (status) {
+    case PROTOCOL_PARSED_COO_MESSAGE:
+        JournalPutValue(j, gData->row);
+        JournalPutValue(j, gData->col);
+        break;
+    case PROTOCOL_PARSED_HIT_MESSAGE:
+        JournalPutValue(j, gData->row);
+        JournalPutValue(j, gData->col);
+        JournalPutValue(j, gData->hit);
+        break;
+    case PROTOCOL_PARSED_CHA_MESSAGE:
+        JournalPutValue(j, nData->encryptedGuess);
+        JournalPutValue(j, nData->hash);
+        break;
+    case PROTOCOL_PARSED_DET_MESSAGE:
+        JournalPutValue(j, nData->guess);
+        JournalPutValue(j, nData->encryptionKey);
+        break;
+    default:
+        break;
+    }
+}
+
+void JournalDump(const Journal *j)
+{
+    uint32_t first = j->length > JOURNAL_SIZE ? j->length - JOURNAL_SIZE : 0;
+    uint32_t i;
+    int b;
+    printf("journal %dx%d fleet ", FIELD_ROWS, FIELD_COLS);
+    for (b = 0; b < FIELD_NUM_BOATS; b++) {
+        printf(b ? ",%d" : "%d", fieldBoatLengths[b]);
+    }
+    printf(" bytes %lu lost %lu\n", (unsigned long) (j->length - first), (unsigned long) first);
+    for (i = first; i < j->length; i++) {
+        printf("%02x", j->data[i & (JOURNAL_SIZE - 1)]);
+        if ((i - first) % JOURNAL_DUMP_LINE == JOURNAL_DUMP_LINE - 1 || i + 1 == j->length) {
+            printf("\n");
+        }
+    }
+    printf("end\n");
+}
+
+/**
+ * Stores the tag of an event, stamping it first if the tick has moved on since the last event.
+ */
+static void JournalStart(Journal *j, JournalEvent event)
+{
+    uint32_t now = SchedulerNow();
+    if (now != j->tick) {
+        JOURNAL_PUT(j, JOURNAL_EVENT_TICK);
+        JournalPutValue(j, now - j->tick);
+        j->tick = now;
+    }
+    JOURNAL_PUT(j, event);
+}
+
+/**
+ * Stores a value 7 bits at a time, lowest first, with the top bit set on all but the last byte.
+ */
+static void JournalPutValue(Journal *j, uint32_t value)
+{
+    while (value >= 0x80) {
+        JOURNAL_PUT(j, value | 0x80);
+        value >>= 7;
+    }
+    JOURNAL_PUT(j, value);
+}
@@ -0,0 +1,135 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Protocol.h"
+
+/**
+ * The journal is a compact binary record of one agent's game: the seed it was started from, how it
+ * was set up, every byte it was given, every message it decoded and sent and every change of its
+ * state, along with the scheduler tick each of these happened on. It's enough to play the game
+ * again exactly, which host/Replay does from a dump of it.
+ *
+ * Each event is a JournalEvent byte followed by its values, each stored 7 bits at a time with the
+ * top bit set on every byte but the last (so values below 128 take a single byte), or by a length
+ * and that many bytes. Events are only stamped with the time when the tick has moved on since the
+ * last one, by a JOURNAL_EVENT_TICK holding the ticks that passed; the first one holds the tick the
+ * journal was started on.
+ *
+ * The events go into a ring buffer of JOURNAL_SIZE bytes, so recording one is only a handful of
+ * stores and the journal can be left on in the firmware. Once the buffer is full the oldest events
+ * are overwritten, and a game can then no longer be replayed from the start.
+ *
+ * Dumping it is another matter, as on the board it goes over the link to the opponent, and takes
+ * most of a second at UART_BAUD_RATE. The firmware only dumps it when built with
+ * JOURNAL_DUMP_ENABLED, and then only once the game is over for both sides.
+ */
+
+// The size of the ring buffer, which must be a power of two. On the board the default holds any
+// game on the default field played with binary frames, and most played in text. The host tools can
+// afford room for a game fed to the agent one byte at a time, which takes about twice as much.
+#ifndef JOURNAL_SIZE
+#ifdef HOST_BUILD
+#define JOURNAL_SIZE 16384
+#else
+#define JOURNAL_SIZE 4096
+#endif
+#endif
+
+#if JOURNAL_SIZE & (JOURNAL_SIZE - 1)
+#error "JOURNAL_SIZE must be a power of two"
+#endif
+
+/**
+ * The kinds of events in a journal and the values that follow each of them:
+ *   * JOURNAL_EVENT_TICK: The number of ticks since the last event.
+ *   * JOURNAL_EVENT_SEED: The seed the agent was started from, see AgentContextInit().
+ *   * JOURNAL_EVENT_POLICY, JOURNAL_EVENT_FLEET, JOURNAL_EVENT_WIRE, JOURNAL_EVENT_NAK: The value
+ *     given to the AgentContextSet*() function of the same name.
+ *   * JOURNAL_EVENT_RUN: The byte passed to AgentContextRun().
+ *   * JOURNAL_EVENT_RUN_BUFFER: The length and bytes passed to AgentContextRunBuffer().
+ *   * JOURNAL_EVENT_IDLE: The agent was run without any input, by AgentContextRun() if the value
+ *     is JOURNAL_EVENT_RUN and by AgentContextRunBuffer() if it's JOURNAL_EVENT_RUN_BUFFER. What
+ *     follows, up to the next JOURNAL_EVENT_RUN* or JOURNAL_EVENT_IDLE, happened in that run. Runs
+ *     without input that do nothing aren't recorded.
+ *   * JOURNAL_EVENT_DECODED: The ProtocolParserStatus of a message that was decoded or failed to
+ *     be, followed by its data: the row and column of a COO, the row, column and hit of a HIT,
+ *     the encryptedGuess and hash of a CHA, the guess and encryptionKey of a DET, and nothing for
+ *     a NAK or a failure.
+ *   * JOURNAL_EVENT_SENT: The length and bytes of everything the agent sent from one run.
+ *   * JOURNAL_EVENT_STATE: The AgentState the agent moved to.
+ */
+typedef enum {
+    JOURNAL_EVENT_TICK,
+    JOURNAL_EVENT_SEED,
+    JOURNAL_EVENT_POLICY,
+    JOURNAL_EVENT_FLEET,
+    JOURNAL_EVENT_WIRE,
+    JOURNAL_EVENT_NAK,
+    JOURNAL_EVENT_RUN,
+    JOURNAL_EVENT_RUN_BUFFER,
+    JOURNAL_EVENT_IDLE,
+    JOURNAL_EVENT_DECODED,
+    JOURNAL_EVENT_SENT,
+    JOURNAL_EVENT_STATE,
+    JOURNAL_NUM_EVENTS
+} JournalEvent;
+
+/**
+ * A journal being recorded. Treat the members as private to Journal.c.
+ */
+typedef struct {
+    uint32_t length; // How many bytes have ever been recorded, including those overwritten since.
+    uint32_t tick;   // The tick of the last event.
+    uint8_t data[JOURNAL_SIZE];
+} Journal;
+
+/**
+ * Empties a journal and stamps it with the current tick.
+ * @param j The journal to start.
+ */
+void JournalInit(Journal *j);
+
+/**
+ * Records an event that carries a single value.
+ * @param j The journal to record in.
+ * @param event What happened.
+ * @param value The value that goes with it.
+ */
+void JournalValue(Journal *j, JournalEvent event, uint32_t value);
+
+/**
+ * Records an event that carries a run of bytes, JOURNAL_EVENT_RUN_BUFFER or JOURNAL_EVENT_SENT.
+ * @param j The journal to record in.
+ * @param event What happened.
+ * @param data The bytes that go with it.
+ * @param length The number of bytes in `data`.
+ */
+void JournalBytes(Journal *j, JournalEvent event, const char *data, size_t length);
+
+/**
+ * Records a JOURNAL_EVENT_DECODED for the result of ProtocolParserDecode().
+ * @param j The journal to record in.
+ * @param status What was decoded, PROTOCOL_PARSING_FAILURE or one of the PROTOCOL_PARSED_* values.
+ * @param nData The data of a CHA or DET message.
+ * @param gData The data of a COO, HIT or NAK message.
+ */
+void JournalDecoded(Journal *j, ProtocolParserStatus status, const NegotiationData *nData,
+        const GuessData *gData);
+
+/**
+ * Prints the journal to stdout, which is UART1 on the Uno32, as a line naming the field and fleet
+ * it was recorded with and the number of bytes that follow and were lost to the ring buffer, then
+ * the bytes themselves in hex, oldest first, and a line reading "end":
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * journal 6x10 fleet 3,4,5,6 bytes 1234 lost 0
+ * 0000010c9b9a9b...
+ * end
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * @param j The journal to print.
+ */
+void JournalDump(const Journal *j);
+
+#endif // JOURNAL_H
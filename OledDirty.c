@@ -0,0 +1,75 @@
+#include "OledDirty.h"
+#include "BOARD.h"
+#include "OledDma.h"
+
+// The dirty columns of each page are [dirtyStart, dirtyEnd); a page is clean when they're equal.
+static uint8_t dirtyStart[OLED_DIRTY_PAGES];
+static uint8_t dirtyEnd[OLED_DIRTY_PAGES];
+
+void OledDirtyMark(int x, int y, int width, int height)
+{
+    int right = x + width, bottom = y + height;
+    int page;
+    if (x < 0) {
+        x = 0;
+    }
+    if (y < 0) {
+        y = 0;
+    }
+    if (right > OLED_DRIVER_PIXEL_COLUMNS) {
+        right = OLED_DRIVER_PIXEL_COLUMNS;
+    }
+    if (bottom > OLED_DRIVER_PIXEL_ROWS) {
+        bottom = OLED_DRIVER_PIXEL_ROWS;
+    }
+    if (x >= right || y >= bottom) {
+        return;
+    }
+    for (page = y / OLED_DRIVER_BUFFER_LINE_HEIGHT;
+            page <= (bottom - 1) / OLED_DRIVER_BUFFER_LINE_HEIGHT; page++) {
+        if (dirtyStart[page] == dirtyEnd[page]) {
+            dirtyStart[page] = x;
+            dirtyEnd[page] = right;
+        } else {
+            if (x < dirtyStart[page]) {
+                dirtyStart[page] = x;
+            }
+            if (right > dirtyEnd[page]) {
+                dirtyEnd[page] = right;
+            }
+        }
+    }
+}
+
+void OledDirtyMarkAll(void)
+{
+    OledDirtyMark(0, 0, OLED_DRIVER_PIXEL_COLUMNS, OLED_DRIVER_PIXEL_ROWS);
+}
+
+int OledDirtyUpdate(void)
+{
+    int sent = OledDmaSend(dirtyStart, dirtyEnd);
+    uint8_t page;
+    if (sent == STANDARD_ERROR) {
+        // Keep the marks until the display is free again.
+        return 0;
+    }
+    for (page = 0; page < OLED_DIRTY_PAGES; page++) {
+        dirtyStart[page] = dirtyEnd[page] = 0;
+    }
+    return sent;
+}
+
+uint8_t OledDirtyPending(void)
+{
+    uint8_t page;
+    if (OledDmaBusy()) {
+        return TRUE;
+    }
+    for (page = 0; page < OLED_DIRTY_PAGES; page++) {
+        if (dirtyStart[page] != dirtyEnd[page]) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
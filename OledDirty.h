@@ -0,0 +1,54 @@
+#ifndef OLED_DIRTY_H
+#define OLED_DIRTY_H
+
+#include <stdint.h>
+
+#include "OledDriver.h"
+
+/**
+ * OledDirty tracks which parts of rgbOledBmp have changed since they were last sent to the display,
+ * so that only those parts have to go over SPI. OledUpdate() always pushes the whole 512-byte frame;
+ * code that knows exactly what it drew marks that area with OledDirtyMark() instead and then calls
+ * OledDirtyUpdate(), which sends just the dirty run of columns on each dirty page.
+ *
+ * The runs are sent in the background by OledDma, so OledDirtyUpdate() returns straight away and
+ * drawing can continue into rgbOledBmp. If the previous update is still being sent, the marks are
+ * kept and go out with the next call once it has finished, so anything that draws should keep
+ * calling OledDirtyUpdate() until OledDirtyPending() says everything has been sent. OledUpdate()
+ * must not be used at the same time, see OledDma.h.
+ *
+ * Like the transfer, the marks belong to the one display and are only for the code that owns it.
+ */
+
+// The number of 8-pixel-high pages in the display.
+#define OLED_DIRTY_PAGES (OLED_DRIVER_PIXEL_ROWS / OLED_DRIVER_BUFFER_LINE_HEIGHT)
+
+/**
+ * Marks a rectangle of pixels as changed. Parts of it outside of the display are ignored.
+ * @param x The leftmost column of the rectangle.
+ * @param y The topmost row of the rectangle.
+ * @param width The width of the rectangle in pixels.
+ * @param height The height of the rectangle in pixels.
+ */
+void OledDirtyMark(int x, int y, int width, int height);
+
+/**
+ * Marks the whole display as changed.
+ */
+void OledDirtyMarkAll(void);
+
+/**
+ * Starts sending every dirty column run to the display and marks the display clean, unless the
+ * previous update is still being sent, in which case nothing happens.
+ * @return The number of bytes that will be sent over SPI, commands included, or 0 if nothing was
+ *         sent.
+ */
+int OledDirtyUpdate(void);
+
+/**
+ * Returns whether anything is still waiting to be sent to the display, either because it has been
+ * marked since the last update or because that update is still being sent.
+ */
+uint8_t OledDirtyPending(void);
+
+#endif // OLED_DIRTY_H
@@ -0,0 +1,151 @@
+#include "OledDma.h"
+#include "BOARD.h"
+
+#include <string.h>
+
+#ifdef HOST_BUILD
+#include <time.h>
+#else
+#include <xc.h>
+#include <sys/attribs.h>
+#include <plib.h>
+
+// This lives in OledDriver.o of the support library.
+uint8_t _Spi2Put(uint8_t data);
+#endif
+
+// The SSD1306 page addressing mode commands used to position each page's data.
+#define OLED_DMA_CMD_PAGE_START 0xB0
+#define OLED_DMA_CMD_COLUMN_LOW 0x00
+#define OLED_DMA_CMD_COLUMN_HIGH 0x10
+
+/**
+ * The transfer state of the display. There is one display and it belongs to whoever owns the main
+ * loop, so this is the only copy, and nothing else may start or poll a transfer, see OledDma.h.
+ */
+static struct {
+    // The copy of rgbOledBmp that is being sent, and which columns of each page to send.
+    uint8_t frame[OLED_DRIVER_BUFFER_SIZE];
+    uint8_t runStart[OLED_DMA_PAGES];
+    uint8_t runEnd[OLED_DMA_PAGES];
+#ifdef HOST_BUILD
+    // When the simulated transfer finishes.
+    struct timespec doneAt;
+    uint8_t busy;
+#else
+    // The page being sent. Both are updated from the DMA interrupt.
+    volatile int8_t page;
+    volatile uint8_t busy;
+#endif
+} dma;
+
+#ifndef HOST_BUILD
+static void OledDmaNextPage(void);
+#endif
+
+void OledDmaInit(void)
+{
+#ifndef HOST_BUILD
+    DmaChnOpen(OLED_DMA_CHANNEL, DMA_CHN_PRI2, DMA_OPEN_DEFAULT);
+    DmaChnSetEventControl(OLED_DMA_CHANNEL, DMA_EV_START_IRQ_EN | DMA_EV_START_IRQ(_SPI2_TX_IRQ));
+    DmaChnSetEvEnableFlags(OLED_DMA_CHANNEL, DMA_EV_BLOCK_DONE);
+    DmaChnSetIntPriority(OLED_DMA_CHANNEL, INT_PRIORITY_LEVEL_3, INT_SUB_PRIORITY_LEVEL_0);
+    DmaChnIntEnable(OLED_DMA_CHANNEL);
+#endif
+}
+
+uint8_t OledDmaBusy(void)
+{
+#ifdef HOST_BUILD
+    // Stand in for the completion interrupt.
+    if (dma.busy) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (now.tv_sec > dma.doneAt.tv_sec ||
+                (now.tv_sec == dma.doneAt.tv_sec && now.tv_nsec >= dma.doneAt.tv_nsec)) {
+            dma.busy = FALSE;
+        }
+    }
+#endif
+    return dma.busy;
+}
+
+int OledDmaSend(const uint8_t start[OLED_DMA_PAGES], const uint8_t end[OLED_DMA_PAGES])
+{
+    int bytes = 0;
+    uint8_t p;
+    if (OledDmaBusy()) {
+        return STANDARD_ERROR;
+    }
+    for (p = 0; p < OLED_DMA_PAGES; p++) {
+        dma.runStart[p] = start[p];
+        dma.runEnd[p] = end[p];
+        if (start[p] < end[p]) {
+            memcpy(&dma.frame[p * OLED_DRIVER_PIXEL_COLUMNS + start[p]],
+                    &rgbOledBmp[p * OLED_DRIVER_PIXEL_COLUMNS + start[p]], end[p] - start[p]);
+            bytes += OLED_DMA_COMMAND_LEN + end[p] - start[p];
+        }
+    }
+    if (bytes == 0) {
+        return 0;
+    }
+    dma.busy = TRUE;
+#ifdef HOST_BUILD
+    {
+        // SPI2 runs at half the peripheral bus clock, 8 bits per byte.
+        uint64_t ns = (uint64_t) bytes * 8 * 1000000000 / (BOARD_GetPBClock() / 2);
+        clock_gettime(CLOCK_MONOTONIC, &dma.doneAt);
+        dma.doneAt.tv_nsec += ns;
+        dma.doneAt.tv_sec += dma.doneAt.tv_nsec / 1000000000;
+        dma.doneAt.tv_nsec %= 1000000000;
+    }
+#else
+    dma.page = -1;
+    OledDmaNextPage();
+#endif
+    return bytes;
+}
+
+#ifndef HOST_BUILD
+/**
+ * Sends the addressing commands for the next page that has data to send and starts the DMA channel
+ * on its data, or marks the transfer as done if there are no pages left.
+ */
+static void OledDmaNextPage(void)
+{
+    do {
+        dma.page++;
+    } while (dma.page < OLED_DMA_PAGES && dma.runStart[dma.page] >= dma.runEnd[dma.page]);
+    if (dma.page == OLED_DMA_PAGES) {
+        dma.busy = FALSE;
+        return;
+    }
+
+    // The last byte of the previous page may still be shifting out, and nothing ever read back what
+    // the DMA wrote, so let the bus go idle and clear the receive side before sending commands.
+    while (SPI2STATbits.SPIBUSY);
+    (void) SPI2BUF;
+    SPI2STATCLR = _SPI2STAT_SPIROV_MASK;
+
+    PORTClearBits(OLED_DRIVER_MODE_PORT, OLED_DRIVER_MODE_BIT);
+    _Spi2Put(OLED_DMA_CMD_PAGE_START | dma.page);
+    _Spi2Put(OLED_DMA_CMD_COLUMN_LOW | (dma.runStart[dma.page] & 0x0F));
+    _Spi2Put(OLED_DMA_CMD_COLUMN_HIGH | (dma.runStart[dma.page] >> 4));
+    PORTSetBits(OLED_DRIVER_MODE_PORT, OLED_DRIVER_MODE_BIT);
+
+    DmaChnSetTxfer(OLED_DMA_CHANNEL,
+            &dma.frame[dma.page * OLED_DRIVER_PIXEL_COLUMNS + dma.runStart[dma.page]],
+            (void *) &SPI2BUF, dma.runEnd[dma.page] - dma.runStart[dma.page], 1, 1);
+    DmaChnStartTxfer(OLED_DMA_CHANNEL, DMA_WAIT_NOT, 0);
+}
+
+/**
+ * The DMA channel has finished sending a page, so move on to the next one.
+ */
+void __ISR(_DMA_0_VECTOR, IPL3AUTO) OledDmaInterrupt(void)
+{
+    DmaChnClrEvFlags(OLED_DMA_CHANNEL, DMA_EV_BLOCK_DONE);
+    INTClearFlag(INT_DMA0);
+    OledDmaNextPage();
+}
+#endif
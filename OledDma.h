@@ -0,0 +1,58 @@
+#ifndef OLED_DMA_H
+#define OLED_DMA_H
+
+#include <stdint.h>
+
+#include "OledDriver.h"
+
+/**
+ * OledDma sends display data to the SSD1306 in the background. A transfer first copies the columns
+ * to be sent out of rgbOledBmp into a second frame buffer owned by this module, so rendering into
+ * rgbOledBmp can carry on while the transfer runs. Each page is then streamed from that buffer to
+ * SPI2 by a DMA channel triggered by the SPI transmit interrupt. When the channel finishes a page,
+ * its interrupt sends the addressing commands for the next page and restarts the channel, until
+ * every page has been sent.
+ *
+ * The synchronous OledUpdate() and OledDriverUpdateDisplay() of the support library must not be
+ * used while a transfer is running, as they drive the same SPI port.
+ *
+ * There is a single display, so there is a single transfer, and it belongs to the code that owns
+ * the display: the main loop, and the built-in agent through agentOledDisplay. Nothing else may
+ * call these functions, in particular not the agents run by the host tools, which have no display.
+ *
+ * The host build has no DMA controller, so there a transfer just stays busy for as long as it would
+ * take to clock its bytes out over SPI, which lets code that waits on the display be exercised
+ * without hardware. Keeping time costs a clock_gettime() call per send and per poll of a running
+ * transfer, which is another reason to keep this away from the agents a benchmark runs.
+ */
+
+// The number of 8-pixel-high pages in the display.
+#define OLED_DMA_PAGES (OLED_DRIVER_PIXEL_ROWS / OLED_DRIVER_BUFFER_LINE_HEIGHT)
+
+// The DMA channel used for the display.
+#define OLED_DMA_CHANNEL DMA_CHANNEL0
+
+// The number of command bytes sent before the data of each page.
+#define OLED_DMA_COMMAND_LEN 3
+
+/**
+ * Sets up the DMA channel and its interrupt. Must be called after OledInit().
+ */
+void OledDmaInit(void);
+
+/**
+ * Returns whether a transfer is still running.
+ */
+uint8_t OledDmaBusy(void);
+
+/**
+ * Starts sending columns [start[p], end[p]) of every page p of rgbOledBmp to the display, without
+ * waiting for them to be sent. Pages where start equals end are skipped.
+ * @param start The first column to send of each page.
+ * @param end One past the last column to send of each page.
+ * @return The number of bytes that will be sent over SPI, commands included, or STANDARD_ERROR if
+ *         a transfer is still running.
+ */
+int OledDmaSend(const uint8_t start[OLED_DMA_PAGES], const uint8_t end[OLED_DMA_PAGES]);
+
+#endif // OLED_DMA_H
@@ -0,0 +1,101 @@
+#include "Parity.h"
+#include "BOARD.h"
+
+// Marks a cell that isn't, or is no longer, in a list.
+#define PARITY_ABSENT ((ParityCell) -1)
+
+static void ParityPick(const ParityState *p, int list, uint32_t random, GuessData *guess);
+
+/**
+ * Fills the lists for a field where nothing has been fired at yet.
+ * @param p The state to initialize.
+ * @param random A random number, used to choose the offset of each lattice.
+ */
+void ParityInit(ParityState *p, uint32_t random)
+{
+    int list, cell;
+    for (list = 0; list < PARITY_LISTS; list++) {
+        int length = list < PARITY_LATTICES ? fieldBoatLengths[list] : 1;
+        int offset = list < PARITY_LATTICES ? (random >> (8 * (list % 4))) % length : 0;
+        p->count[list] = 0;
+        for (cell = 0; cell < PARITY_CELLS; cell++) {
+            int row = cell / FIELD_COLS, col = cell % FIELD_COLS;
+            if (list == PARITY_ALL_CELLS || (row + col) % length == offset) {
+                p->position[list][cell] = p->count[list];
+                p->cells[list][p->count[list]++] = cell;
+            } else {
+                p->position[list][cell] = PARITY_ABSENT;
+            }
+        }
+    }
+}
+
+/**
+ * Strikes a cell that has been fired at off every list.
+ * @param p The state to update.
+ * @param shot The coordinates of the cell.
+ */
+void ParityRemove(ParityState *p, const GuessData *shot)
+{
+    int list, cell;
+    if (shot->row >= FIELD_ROWS || shot->col >= FIELD_COLS) {
+        return;
+    }
+    cell = shot->row * FIELD_COLS + shot->col;
+    for (list = 0; list < PARITY_LISTS; list++) {
+        ParityCell position = p->position[list][cell];
+        if (position != PARITY_ABSENT) {
+            //move the last cell of the list into the gap
+            ParityCell last = p->cells[list][--p->count[list]];
+            p->cells[list][position] = last;
+            p->position[list][last] = position;
+            p->position[list][cell] = PARITY_ABSENT;
+        }
+    }
+}
+
+/**
+ * Picks a random cell that hasn't been fired at from the lattice for the smallest boat afloat.
+ * @param p The current state.
+ * @param alive The enemy boats still afloat, as a BoatStatus bitfield.
+ * @param random A random number used to pick the cell.
+ * @param guess Receives the row and column to fire at.
+ */
+void ParityChoose(const ParityState *p, uint8_t alive, uint32_t random, GuessData *guess)
+{
+    int list = PARITY_ALL_CELLS, b;
+    for (b = 0; b < PARITY_LATTICES; b++) {
+        if ((alive & (1 << b)) &&
+                (list == PARITY_ALL_CELLS || fieldBoatLengths[b] < fieldBoatLengths[list])) {
+            list = b;
+        }
+    }
+    if (list != PARITY_ALL_CELLS && p->count[list] == 0) {
+        list = PARITY_ALL_CELLS;
+    }
+    ParityPick(p, list, random, guess);
+}
+
+/**
+ * Picks a random cell that hasn't been fired at, from the whole field.
+ * @param p The current state.
+ * @param random A random number used to pick the cell.
+ * @param guess Receives the row and column to fire at.
+ */
+void ParityChooseAny(const ParityState *p, uint32_t random, GuessData *guess)
+{
+    ParityPick(p, PARITY_ALL_CELLS, random, guess);
+}
+
+/**
+ * Picks a random cell from one of the lists, or (0, 0) if it's empty.
+ */
+static void ParityPick(const ParityState *p, int list, uint32_t random, GuessData *guess)
+{
+    ParityCell cell = 0;
+    if (p->count[list] > 0) {
+        cell = p->cells[list][random % p->count[list]];
+    }
+    guess->row = cell / FIELD_COLS;
+    guess->col = cell % FIELD_COLS;
+}
@@ -0,0 +1,78 @@
+#ifndef PARITY_H
+#define PARITY_H
+
+#include <stdint.h>
+
+#include "Field.h"
+#include "Protocol.h"
+
+/**
+ * Parity keeps the cells still worth hunting on as ready-made lists, so that picking the next shot
+ * takes constant time. Any L cells in a line cover every value of (row + col) % L once, so every
+ * placement of a boat of length L or more crosses the lattice (row + col) % L == offset, and while
+ * the smallest boat afloat has length L, firing only at that lattice is enough to find every boat.
+ * There is one list per boat, for when it's the smallest afloat, each with its own randomly chosen
+ * offset, plus one of every cell, and every shot's cell is struck off all of them at once.
+ *
+ * Each list stores its cells packed at the front, along with where in the list each cell is, so
+ * that both removing a cell and picking a random one are O(1).
+ */
+
+// The lattices, one for each boat spaced by its length, and then the list of every cell.
+#define PARITY_LATTICES FIELD_NUM_BOATS
+#define PARITY_ALL_CELLS PARITY_LATTICES
+#define PARITY_LISTS (PARITY_LATTICES + 1)
+
+#define PARITY_CELLS (FIELD_ROWS * FIELD_COLS)
+
+/**
+ * A cell number, `row * FIELD_COLS + col`, kept as small as the field allows.
+ */
+#if PARITY_CELLS < 255
+typedef uint8_t ParityCell;
+#else
+typedef uint16_t ParityCell;
+#endif
+
+/**
+ * The cells not yet fired at on each lattice.
+ */
+typedef struct {
+    ParityCell cells[PARITY_LISTS][PARITY_CELLS];    // The cells of each list, first `count` used.
+    ParityCell position[PARITY_LISTS][PARITY_CELLS]; // Where each cell is in each list.
+    ParityCell count[PARITY_LISTS];                  // How many cells each list has left.
+} ParityState;
+
+/**
+ * Fills the lists for a field where nothing has been fired at yet.
+ * @param p The state to initialize.
+ * @param random A random number, used to choose the offset of each lattice.
+ */
+void ParityInit(ParityState *p, uint32_t random);
+
+/**
+ * Strikes a cell that has been fired at off every list. Cells outside of the field are ignored.
+ * @param p The state to update.
+ * @param shot The coordinates of the cell.
+ */
+void ParityRemove(ParityState *p, const GuessData *shot);
+
+/**
+ * Picks a random cell that hasn't been fired at from the lattice for the smallest boat in `alive`,
+ * or from all such cells if that lattice has none left.
+ * @param p The current state.
+ * @param alive The enemy boats still afloat, as a BoatStatus bitfield.
+ * @param random A random number used to pick the cell.
+ * @param guess Receives the row and column to fire at, which are 0 if every cell was fired at.
+ */
+void ParityChoose(const ParityState *p, uint8_t alive, uint32_t random, GuessData *guess);
+
+/**
+ * Picks a random cell that hasn't been fired at, from the whole field.
+ * @param p The current state.
+ * @param random A random number used to pick the cell.
+ * @param guess Receives the row and column to fire at, which are 0 if every cell was fired at.
+ */
+void ParityChooseAny(const ParityState *p, uint32_t random, GuessData *guess);
+
+#endif // PARITY_H
@@ -0,0 +1,207 @@
+#include "Placement.h"
+#include "BOARD.h"
+
+static uint32_t PlacementRuns(uint32_t cells, int length);
+static uint32_t PlacementRandom(uint32_t *state);
+
+/**
+ * Chooses a uniformly random spot for a boat among those where all of its cells are free.
+ * @param free The free cells, one mask per row with bit `col` for each cell.
+ * @param length The length of the boat.
+ * @param random A random number used to choose the spot.
+ * @param row Receives the row of the top or left end of the boat.
+ * @param col Receives the column of the top or left end of the boat.
+ * @param vertical Receives TRUE if the boat runs down from there, FALSE if it runs right.
+ * @return TRUE if a spot was chosen, FALSE if the boat fits nowhere.
+ */
+uint8_t PlacementChoose(const uint32_t free[FIELD_ROWS], int length, uint32_t random,
+        uint8_t *row, uint8_t *col, uint8_t *vertical)
+{
+    uint32_t across[FIELD_ROWS], down[FIELD_ROWS];
+    int n = 0, r, k;
+    for (r = 0; r < FIELD_ROWS; r++) {
+        across[r] = PlacementRuns(free[r], length);
+        n += FieldPopcount(across[r]);
+    }
+    for (r = 0; r < FIELD_ROWS; r++) {
+        down[r] = 0;
+        if (r + length <= FIELD_ROWS) {
+            down[r] = free[r];
+            for (k = 1; k < length; k++) {
+                down[r] &= free[r + k];
+            }
+        }
+        n += FieldPopcount(down[r]);
+    }
+    if (n == 0) {
+        return FALSE;
+    }
+
+    //find the n-th start, counting all the ones across before the ones down
+    n = random % n;
+    for (r = 0; r < 2 * FIELD_ROWS; r++) {
+        uint32_t starts = r < FIELD_ROWS ? across[r] : down[r - FIELD_ROWS];
+        int count = FieldPopcount(starts);
+        if (n >= count) {
+            n -= count;
+            continue;
+        }
+        while (n-- > 0) {
+            starts &= starts - 1;
+        }
+        *row = r % FIELD_ROWS;
+        *col = __builtin_ctz(starts);
+        *vertical = r >= FIELD_ROWS;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * Adds a boat to a field at a uniformly random spot among all the empty ones it fits in.
+ * @param f The field to add the boat to.
+ * @param type The boat to add.
+ * @param random A random number used to choose the spot.
+ * @return TRUE if the boat was added, FALSE if it fits nowhere.
+ */
+uint8_t PlacementAddBoat(Field *f, BoatType type, uint32_t random)
+{
+    uint32_t free[FIELD_ROWS];
+    uint8_t row, col, vertical;
+    for (row = 0; row < FIELD_ROWS; row++) {
+        free[row] = 0;
+        for (col = 0; col < FIELD_COLS; col++) {
+            if (FieldAt(f, row, col) == FIELD_POSITION_EMPTY) {
+                free[row] |= (uint32_t) 1 << col;
+            }
+        }
+    }
+    if (!PlacementChoose(free, fieldBoatLengths[type], random, &row, &col, &vertical)) {
+        return FALSE;
+    }
+    return FieldAddBoat(f, row, col,
+            vertical ? FIELD_BOAT_DIRECTION_SOUTH : FIELD_BOAT_DIRECTION_EAST, type);
+}
+
+/**
+ * Clears a field and places the whole fleet on it, biggest boat first.
+ * @param f The field to fill.
+ * @param seed Seeds the random choices.
+ * @return TRUE if the fleet was placed, FALSE if some boat didn't fit.
+ */
+uint8_t PlacementFleet(Field *f, uint32_t seed)
+{
+    uint32_t free[FIELD_ROWS];
+    uint32_t random = seed ^ 0x9E3779B9;
+    uint8_t row, col, vertical, k;
+    int type;
+    if (random == 0) {
+        random = 1;
+    }
+    FieldInit(f, FIELD_POSITION_EMPTY);
+    for (row = 0; row < FIELD_ROWS; row++) {
+        free[row] = (uint32_t) -1 >> (32 - FIELD_COLS);
+    }
+    //the biggest boat, listed last, has the fewest spots, so it goes first while the field is
+    //still empty
+    for (type = FIELD_NUM_BOATS - 1; type >= 0; type--) {
+        int length = fieldBoatLengths[type];
+        if (!PlacementChoose(free, length, PlacementRandom(&random), &row, &col, &vertical)) {
+            return FALSE;
+        }
+        FieldAddBoat(f, row, col,
+                vertical ? FIELD_BOAT_DIRECTION_SOUTH : FIELD_BOAT_DIRECTION_EAST, type);
+        for (k = 0; k < length; k++) {
+            if (vertical) {
+                free[row + k] &= ~((uint32_t) 1 << col);
+            } else {
+                free[row] &= ~((uint32_t) 1 << (col + k));
+            }
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * Places `count` independent fleets.
+ * @param fleets Where to place the fleets, `count` fields long.
+ * @param count How many fleets to place.
+ * @param seed Seeds the random choices.
+ * @return How many of the fleets were placed in full.
+ */
+int PlacementFleets(Field *fleets, int count, uint32_t seed)
+{
+    uint32_t random = seed ^ 0x6A09E667;
+    int placed = 0, i;
+    if (random == 0) {
+        random = 1;
+    }
+    for (i = 0; i < count; i++) {
+        placed += PlacementFleet(&fleets[i], PlacementRandom(&random));
+    }
+    return placed;
+}
+
+/**
+ * Clears a field and places the fleet as a random, randomly mirrored, entry of the layout table.
+ * @param f The field to fill.
+ * @param random A random number used to choose the layout.
+ * @return TRUE if the fleet was placed, FALSE if the table is empty.
+ */
+uint8_t PlacementFromTable(Field *f, uint32_t random)
+{
+    const uint8_t *entry;
+    uint8_t mirrorRows = (random >> 31) & 1, mirrorCols = (random >> 30) & 1;
+    int type;
+    if (placementTableLength == 0) {
+        return FALSE;
+    }
+    //the top bits choose the mirroring, so only use the rest to choose the entry
+    entry = placementTable[(random & 0x3FFFFFFF) % placementTableLength];
+    FieldInit(f, FIELD_POSITION_EMPTY);
+    for (type = 0; type < FIELD_NUM_BOATS; type++) {
+        int length = fieldBoatLengths[type];
+        uint8_t cell = entry[type] & PLACEMENT_TABLE_CELL;
+        uint8_t vertical = (entry[type] & PLACEMENT_TABLE_VERTICAL) != 0;
+        uint8_t row = cell / FIELD_COLS, col = cell % FIELD_COLS;
+        //a mirrored boat starts from what was its far end
+        if (mirrorRows) {
+            row = vertical ? FIELD_ROWS - row - length : FIELD_ROWS - 1 - row;
+        }
+        if (mirrorCols) {
+            col = vertical ? FIELD_COLS - 1 - col : FIELD_COLS - col - length;
+        }
+        FieldAddBoat(f, row, col,
+                vertical ? FIELD_BOAT_DIRECTION_SOUTH : FIELD_BOAT_DIRECTION_EAST, type);
+    }
+    return TRUE;
+}
+
+/**
+ * Returns the columns at which a run of `length` cells set in `cells` starts.
+ */
+static uint32_t PlacementRuns(uint32_t cells, int length)
+{
+    uint32_t runs = cells;
+    int k;
+    if (length > FIELD_COLS) {
+        return 0;
+    }
+    for (k = 1; k < length; k++) {
+        runs &= cells >> k;
+    }
+    return runs & ((uint32_t) -1 >> (32 - (FIELD_COLS - length + 1)));
+}
+
+/**
+ * Returns the next number from a xorshift generator.
+ */
+static uint32_t PlacementRandom(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
@@ -0,0 +1,87 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stdint.h>
+
+#include "Field.h"
+
+/**
+ * Placement puts boats on a field in a single step each. Instead of trying random spots until one
+ * fits, it lays out every spot where the boat fits as bitmasks, one per row of the field, counts
+ * them and picks one of them uniformly with a single random number. The time this takes is the
+ * same whatever the field looks like, and it always finds a spot if there is one.
+ */
+
+#if FIELD_COLS > 32
+#error "Placement keeps each row of the field in a 32-bit mask"
+#endif
+
+/**
+ * Chooses a uniformly random spot for a boat of `length` among those where all of its cells are
+ * free.
+ * @param free The free cells, one mask per row with bit `col` for each cell.
+ * @param length The length of the boat.
+ * @param random A random number used to choose the spot.
+ * @param row Receives the row of the top or left end of the boat.
+ * @param col Receives the column of the top or left end of the boat.
+ * @param vertical Receives TRUE if the boat runs down from there, FALSE if it runs right.
+ * @return TRUE if a spot was chosen, FALSE if the boat fits nowhere.
+ */
+uint8_t PlacementChoose(const uint32_t free[FIELD_ROWS], int length, uint32_t random,
+        uint8_t *row, uint8_t *col, uint8_t *vertical);
+
+/**
+ * Adds a boat to a field at a uniformly random spot among all the empty ones it fits in.
+ * @param f The field to add the boat to.
+ * @param type The boat to add.
+ * @param random A random number used to choose the spot.
+ * @return TRUE if the boat was added, FALSE if it fits nowhere and `f` is unchanged.
+ */
+uint8_t PlacementAddBoat(Field *f, BoatType type, uint32_t random);
+
+/**
+ * Clears a field and places the whole fleet on it, biggest boat first, each one at a uniformly
+ * random spot among those left.
+ * @param f The field to fill.
+ * @param seed Seeds the random choices, so the same seed always gives the same fleet.
+ * @return TRUE if the fleet was placed, FALSE if some boat didn't fit, which can only happen on
+ *         fields overridden to be very small.
+ */
+uint8_t PlacementFleet(Field *f, uint32_t seed);
+
+/**
+ * Places `count` independent fleets, for simulations that need a lot of them.
+ * @param fleets Where to place the fleets, `count` fields long.
+ * @param count How many fleets to place.
+ * @param seed Seeds the random choices. Each fleet gets its own seed derived from this one.
+ * @return How many of the fleets were placed in full, see PlacementFleet().
+ */
+int PlacementFleets(Field *fleets, int count, uint32_t seed);
+
+/**
+ * Uniformly random fleets are easy prey for a shooter that knows how boats fit, so the agent
+ * normally picks its fleet from a table of layouts that held out longest against the targeting
+ * policies instead. The table is generated by host/FleetOptimizer into PlacementTable.c and only
+ * holds layouts for the field dimensions and the fleet it was generated for; on any other field or
+ * fleet it's empty.
+ *
+ * Each entry lists the boats in order of boat number as the number of the cell their top or left
+ * end is on, `row * FIELD_COLS + col`, with PLACEMENT_TABLE_VERTICAL set if the boat runs down from
+ * there.
+ */
+#define PLACEMENT_TABLE_VERTICAL 0x80
+#define PLACEMENT_TABLE_CELL 0x7F
+
+extern const uint8_t placementTable[][FIELD_NUM_BOATS];
+extern const uint16_t placementTableLength;
+
+/**
+ * Clears a field and places the fleet as a random entry of the layout table, mirrored at random
+ * across either axis.
+ * @param f The field to fill.
+ * @param random A random number used to choose the layout.
+ * @return TRUE if the fleet was placed, FALSE if the table is empty and `f` is unchanged.
+ */
+uint8_t PlacementFromTable(Field *f, uint32_t random);
+
+#endif // PLACEMENT_H
@@ -0,0 +1,31 @@
+/*
+ * Fleet layouts for PlacementFromTable(). Generated by host/FleetOptimizer, do not edit.
+ *
+ *   host/build/FleetOptimizer -g 48
+ */
+#include "Placement.h"
+
+#if FIELD_ROWS == 6 && FIELD_COLS == 10 && !defined(FIELD_FLEET)
+const uint8_t placementTable[][FIELD_NUM_BOATS] = {
+    {0x07, 0x8B, 0x8C, 0x85}, // 37.34 shots
+    {0x39, 0x1A, 0x8C, 0x84}, // 37.28 shots
+    {0x9E, 0x2E, 0x0B, 0x15}, // 37.22 shots
+    {0x89, 0x0B, 0x2C, 0x21}, // 37.19 shots
+    {0x9E, 0x2E, 0x15, 0x0B}, // 37.12 shots
+    {0x39, 0x85, 0x8B, 0x82}, // 37.11 shots
+    {0x89, 0x0A, 0x22, 0x2B}, // 37.08 shots
+    {0x07, 0x8A, 0x84, 0x82}, // 37.07 shots
+    {0xA7, 0x33, 0x18, 0x0D}, // 37.06 shots
+    {0x00, 0x10, 0x29, 0x1E}, // 37.06 shots
+    {0x32, 0x2E, 0x0B, 0x14}, // 37.02 shots
+    {0x32, 0x14, 0x36, 0x21}, // 37.02 shots
+    {0x89, 0x37, 0x14, 0x1E}, // 36.99 shots
+    {0xA7, 0x8B, 0x18, 0x0E}, // 36.98 shots
+    {0x9E, 0x0B, 0x23, 0x15}, // 36.98 shots
+    {0x80, 0x02, 0x22, 0x2B}, // 36.97 shots
+};
+const uint16_t placementTableLength = sizeof(placementTable) / sizeof(placementTable[0]);
+#else
+const uint8_t placementTable[1][FIELD_NUM_BOATS];
+const uint16_t placementTableLength = 0;
+#endif
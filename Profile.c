@@ -0,0 +1,113 @@
+#include "Profile.h"
+
+#ifdef PROFILE_ENABLED
+
+#include <stdio.h>
+
+#include "BOARD.h"
+
+#ifdef HOST_BUILD
+#include <time.h>
+#else
+#include <xc.h>
+#endif
+
+/**
+ * The statistics kept for each probe.
+ */
+typedef struct {
+    uint32_t calls;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t histogram[PROFILE_HISTOGRAM_BUCKETS];
+} ProfileStats;
+
+static ProfileStats stats[PROFILE_NUM_PROBES];
+
+static const char *const probeNames[PROFILE_NUM_PROBES] = {
+    "AgentRun",
+    "ProtocolDecode",
+    "FieldOledDrawScreen",
+    "OledUpdate"
+};
+
+uint32_t ProfileNow(void)
+{
+#ifdef HOST_BUILD
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t) now.tv_sec * 1000000000u + (uint32_t) now.tv_nsec;
+#else
+    // The core timer counts at half the system clock.
+    return _CP0_GET_COUNT();
+#endif
+}
+
+uint32_t ProfileTicksPerSecond(void)
+{
+#ifdef HOST_BUILD
+    return 1000000000u;
+#else
+    return BOARD_GetSysClock() / 2;
+#endif
+}
+
+void ProfileRecord(ProfileProbe probe, uint32_t ticks)
+{
+    ProfileStats *s = &stats[probe];
+    uint8_t bucket = 0;
+    if (s->calls == 0 || ticks < s->min) {
+        s->min = ticks;
+    }
+    if (ticks > s->max) {
+        s->max = ticks;
+    }
+    s->calls++;
+    s->total += ticks;
+    if (ticks) {
+        bucket = 31 - __builtin_clz(ticks);
+    }
+    if (bucket >= PROFILE_HISTOGRAM_BUCKETS) {
+        bucket = PROFILE_HISTOGRAM_BUCKETS - 1;
+    }
+    s->histogram[bucket]++;
+}
+
+void ProfileReset(void)
+{
+    uint8_t p, b;
+    for (p = 0; p < PROFILE_NUM_PROBES; p++) {
+        stats[p].calls = 0;
+        stats[p].min = 0;
+        stats[p].max = 0;
+        stats[p].total = 0;
+        for (b = 0; b < PROFILE_HISTOGRAM_BUCKETS; b++) {
+            stats[p].histogram[b] = 0;
+        }
+    }
+}
+
+void ProfileReport(void)
+{
+    uint8_t p, b;
+    printf("profile: %lu ticks/s\n", (unsigned long) ProfileTicksPerSecond());
+    for (p = 0; p < PROFILE_NUM_PROBES; p++) {
+        const ProfileStats *s = &stats[p];
+        if (s->calls == 0) {
+            continue;
+        }
+        printf("%-20s calls %lu min %lu max %lu mean %lu\n", probeNames[p],
+                (unsigned long) s->calls, (unsigned long) s->min, (unsigned long) s->max,
+                (unsigned long) (s->total / s->calls));
+        for (b = 0; b < PROFILE_HISTOGRAM_BUCKETS; b++) {
+            if (s->histogram[b]) {
+                printf("  %s%-10lu %lu\n", b == PROFILE_HISTOGRAM_BUCKETS - 1 ? ">=" : "< ",
+                        (unsigned long) (b == PROFILE_HISTOGRAM_BUCKETS - 1 ? 1ul << b : 2ul << b),
+                        (unsigned long) s->histogram[b]);
+            }
+        }
+    }
+}
+
+#endif // PROFILE_ENABLED
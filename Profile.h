@@ -0,0 +1,88 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+/**
+ * The profiler times calls to the hot functions of the game loop. Each call is timestamped on entry
+ * and exit with the PIC32 core timer (or CLOCK_MONOTONIC in nanoseconds on the host build), and the
+ * elapsed ticks are folded into per-probe statistics: call count, min, max, mean and a histogram
+ * with power-of-two buckets. Everything lives in fixed-size static buffers.
+ *
+ * Profiling is only compiled in when PROFILE_ENABLED is defined. Otherwise PROFILE() just runs the
+ * wrapped statement and the other macros expand to nothing, so release firmware doesn't pay for it.
+ *
+ * Wrap each call to be timed like this:
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * PROFILE(PROFILE_OLED_UPDATE, OledUpdate());
+ * PROFILE(PROFILE_AGENT_RUN, length = AgentRun(in, out));
+ * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ */
+
+/**
+ * The functions that can be profiled.
+ */
+typedef enum {
+    PROFILE_AGENT_RUN,
+    PROFILE_PROTOCOL_DECODE,
+    PROFILE_FIELD_OLED_DRAW_SCREEN,
+    PROFILE_OLED_UPDATE,
+    PROFILE_NUM_PROBES
+} ProfileProbe;
+
+// Histogram bucket i counts calls that took [2^i, 2^(i+1)) ticks; the last bucket also counts
+// everything longer.
+#define PROFILE_HISTOGRAM_BUCKETS 24
+
+#ifdef PROFILE_ENABLED
+
+/**
+ * Runs a statement and records how long it took against `probe`.
+ */
+#define PROFILE(probe, ...) do { \
+    uint32_t profileStart = ProfileNow(); \
+    __VA_ARGS__; \
+    ProfileRecord(probe, ProfileNow() - profileStart); \
+} while (0)
+
+#define PROFILE_REPORT() ProfileReport()
+#define PROFILE_RESET() ProfileReset()
+
+/**
+ * Returns the current time in ticks. Only differences between two readings are meaningful.
+ */
+uint32_t ProfileNow(void);
+
+/**
+ * Returns how many ticks ProfileNow() advances per second.
+ */
+uint32_t ProfileTicksPerSecond(void);
+
+/**
+ * Adds one call that took `ticks` to the statistics of `probe`.
+ */
+void ProfileRecord(ProfileProbe probe, uint32_t ticks);
+
+/**
+ * Clears the statistics of every probe.
+ */
+void ProfileReset(void);
+
+/**
+ * Prints the statistics of every probe that has been called to stdout, which is UART1 on the
+ * Uno32. Durations are given in ticks; the tick rate is printed first.
+ */
+void ProfileReport(void);
+
+#else
+
+#define PROFILE(probe, ...) do { \
+    __VA_ARGS__; \
+} while (0)
+
+#define PROFILE_REPORT()
+#define PROFILE_RESET()
+
+#endif // PROFILE_ENABLED
+
+#endif // PROFILE_H
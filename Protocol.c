@@ -3,37 +3,153 @@
 #include "Field.h"
 #include "BOARD.h"
 #include <stdint.h>
-#include <stdio.h>
 #include <stdlib.h>
-#include <stdint.h>
-#include <string.h>
-static char Encode[PROTOCOL_MAX_PAYLOAD_LEN];
-static int wordCount;
-static unsigned int intTemp1, intTemp2, intTemp3;
-static unsigned char Check;
 
 typedef enum {
     WAITING,
-    RECORDING,
-    FIRST_CHECKSUM_HALF,
-    SECOND_CHECKSUM_HALF,
-    NEWLINE
+    MESSAGE_ID,
+    DATA,
+    CHECKSUM,
+    FRAME
 } ProtocolStates;
 
+// Packs the 3 characters of a message ID the same way the decoder accumulates them.
+#define PROTOCOL_ID(a, b, c) (((uint32_t) (a) << 16) | ((uint32_t) (b) << 8) | (uint32_t) (c))
+
+// The ID of the message a PAYLOAD_TEMPLATE_* describes: its first 3 characters.
+#define PROTOCOL_TEMPLATE_ID(t) PROTOCOL_ID((t)[0], (t)[1], (t)[2])
+
+// How many data fields a PAYLOAD_TEMPLATE_* has: after the 3 character ID, each field is ",%u".
+#define PROTOCOL_TEMPLATE_FIELDS(t) ((sizeof(t) - 1 - 3) / 3)
+
+// The longest message ID the decoder accepts.
+#define PROTOCOL_MAX_ID_LEN 5
+
+// The most digits a data field may have, so that its value can't overflow 32 bits.
+#define PROTOCOL_MAX_DIGITS 9
+
+// Declares a messages[] entry from its PAYLOAD_TEMPLATE_*.
+#define PROTOCOL_MESSAGE(t, status) \
+    {PROTOCOL_TEMPLATE_ID(t), status, PROTOCOL_TEMPLATE_FIELDS(t), {(t)[0], (t)[1], (t)[2]}}
+
+/**
+ * Describes each message of the protocol: its ID, what ProtocolDecode() returns for it and how
+ * many data fields follow the ID. All of it is derived from the PAYLOAD_TEMPLATE_* definitions,
+ * and it's ordered like the PROTOCOL_PARSED_* values so that the encoders can index it.
+ */
 typedef struct {
-    int index;
-    uint8_t hash;
-    char Sentence[PROTOCOL_MAX_PAYLOAD_LEN];
-} protocolStruct;
-protocolStruct pData;
-ProtocolStates states = WAITING;
+    uint32_t id;
+    ProtocolParserStatus status;
+    uint8_t fields;
+    char name[3];
+} ProtocolMessage;
+
+static const ProtocolMessage messages[] = {
+    PROTOCOL_MESSAGE(PAYLOAD_TEMPLATE_COO, PROTOCOL_PARSED_COO_MESSAGE),
+    PROTOCOL_MESSAGE(PAYLOAD_TEMPLATE_HIT, PROTOCOL_PARSED_HIT_MESSAGE),
+    PROTOCOL_MESSAGE(PAYLOAD_TEMPLATE_CHA, PROTOCOL_PARSED_CHA_MESSAGE),
+    PROTOCOL_MESSAGE(PAYLOAD_TEMPLATE_DET, PROTOCOL_PARSED_DET_MESSAGE),
+    PROTOCOL_MESSAGE(PAYLOAD_TEMPLATE_NAK, PROTOCOL_PARSED_NAK_MESSAGE),
+};
+#define PROTOCOL_NUM_MESSAGES (sizeof(messages) / sizeof(messages[0]))
+
+// The messages[] entry for a PROTOCOL_PARSED_* value.
+#define PROTOCOL_MESSAGE_OF(status) (&messages[(status) - PROTOCOL_PARSED_COO_MESSAGE])
+
+// How many bytes of a binary frame follow the sync byte, and how many bits each of them carries.
+#define PROTOCOL_FRAME_DATA_LEN (PROTOCOL_FRAME_LEN - 1)
+#define PROTOCOL_FRAME_BITS 7
+#define PROTOCOL_FRAME_MARK 0x80
+#define PROTOCOL_FRAME_MASK 0x7F
+
+// The statuses binary frames decode to, indexed by their type.
+static const ProtocolParserStatus frameStatus[] = {
+    [PROTOCOL_FRAME_COO] = PROTOCOL_PARSED_COO_MESSAGE,
+    [PROTOCOL_FRAME_HIT] = PROTOCOL_PARSED_HIT_MESSAGE,
+    [PROTOCOL_FRAME_NAK] = PROTOCOL_PARSED_NAK_MESSAGE,
+};
+
+// How many hexadecimal digits the XOR checksum and the CRC-16 of a text message are written with.
+#define PROTOCOL_XOR_DIGITS 2
+#define PROTOCOL_CRC16_DIGITS 4
+
+// What the CRC-16 of a text message starts from.
+#define PROTOCOL_CRC16_INIT 0xFFFF
+
+/**
+ * The CRC-8 (polynomial 0x07) of every byte, so that a CRC-8 takes one lookup per byte.
+ */
+static const uint8_t crc8Table[256] = {
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3
+};
+
+/**
+ * The CRC-16 (polynomial 0x1021) of every byte in the top half of the CRC register, so that a
+ * CRC-16 takes one lookup per byte.
+ */
+static const uint16_t crc16Table[256] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7, 0x8108, 0x9129, 0xA14A, 0xB16B,
+    0xC18C, 0xD1AD, 0xE1CE, 0xF1EF, 0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+    0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE, 0x2462, 0x3443, 0x0420, 0x1401,
+    0x64E6, 0x74C7, 0x44A4, 0x5485, 0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+    0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4, 0xB75B, 0xA77A, 0x9719, 0x8738,
+    0xF7DF, 0xE7FE, 0xD79D, 0xC7BC, 0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+    0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B, 0x5AF5, 0x4AD4, 0x7AB7, 0x6A96,
+    0x1A71, 0x0A50, 0x3A33, 0x2A12, 0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+    0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41, 0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD,
+    0xAD2A, 0xBD0B, 0x8D68, 0x9D49, 0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+    0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78, 0x9188, 0x81A9, 0xB1CA, 0xA1EB,
+    0xD10C, 0xC12D, 0xF14E, 0xE16F, 0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+    0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E, 0x02B1, 0x1290, 0x22F3, 0x32D2,
+    0x4235, 0x5214, 0x6277, 0x7256, 0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+    0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405, 0xA7DB, 0xB7FA, 0x8799, 0x97B8,
+    0xE75F, 0xF77E, 0xC71D, 0xD73C, 0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+    0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB, 0x5844, 0x4865, 0x7806, 0x6827,
+    0x18C0, 0x08E1, 0x3882, 0x28A3, 0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+    0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92, 0xFD2E, 0xED0F, 0xDD6C, 0xCD4D,
+    0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9, 0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+    0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8, 0x6E17, 0x7E36, 0x4E55, 0x5E74,
+    0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+
+// Lowercase hexadecimal digits, as printed by the %02x in MESSAGE_TEMPLATE.
+static const char hexDigits[16] = "0123456789abcdef";
+
+/**
+ * The value of every hexadecimal digit plus one, so that every other character maps to 0.
+ */
+static const uint8_t hexValues[256] = {
+    ['0'] = 1, ['1'] = 2, ['2'] = 3, ['3'] = 4, ['4'] = 5,
+    ['5'] = 6, ['6'] = 7, ['7'] = 8, ['8'] = 9, ['9'] = 10,
+    ['A'] = 11, ['B'] = 12, ['C'] = 13, ['D'] = 14, ['E'] = 15, ['F'] = 16,
+    ['a'] = 11, ['b'] = 12, ['c'] = 13, ['d'] = 14, ['e'] = 15, ['f'] = 16
+};
 
-ProtocolParserStatus MSGID(char *input);
-static uint8_t Checksum(char *inStr, int wordCount);
-static uint8_t AsciiToHex(char input);
-static int clear;
+// The parser used by ProtocolDecode().
+static ProtocolParser pData = {WAITING};
 
-int CheckHex(char input);
+static int ProtocolEncode(char *message, const ProtocolMessage *type, const uint32_t *fields,
+        ProtocolWireFormat format);
+static int ProtocolEncodeFrame(char *message, uint8_t type, uint8_t hit, const GuessData *data);
+static ProtocolParserStatus ProtocolDecodeFrame(ProtocolParser *parser, GuessData *gData);
+static uint8_t ProtocolCrc8(uint8_t first, uint8_t second);
+static ProtocolParserStatus ProtocolParserStart(ProtocolParser *parser, uint8_t c);
+static ProtocolParserStatus ProtocolParserFail(ProtocolParser *parser, uint8_t c);
 
 /**
  * Encodes the coordinate data for a guess into the string `message`. This string must be big
@@ -47,44 +163,84 @@ int CheckHex(char input);
  * @return The length of the string stored into `message`.
  */
 int ProtocolEncodeCooMessage(char *message, const GuessData *data) {
-    sprintf(Encode, PAYLOAD_TEMPLATE_COO, data->row, data->col);
-    //create coo template with data
-    wordCount = strlen(Encode);
-    Check = Checksum(Encode, wordCount); //create checksum
-    sprintf(message, MESSAGE_TEMPLATE, Encode, Check); //adds checksum to string
-    wordCount = strlen(message);
-    return wordCount; //returns back the string length
+    return ProtocolEncodeCoo(message, data, PROTOCOL_WIRE_TEXT);
 }
 
 int ProtocolEncodeHitMessage(char *message, const GuessData *data) {
-    sprintf(Encode, PAYLOAD_TEMPLATE_HIT, data->row, data->col, data->hit);
-    //create hit template with data
-    wordCount = strlen(Encode);
-    Check = Checksum(Encode, wordCount); //create checksum
-    sprintf(message, MESSAGE_TEMPLATE, Encode, Check); //adds checksum to string
-    wordCount = strlen(message);
-    return wordCount; //returns back the string length
+    return ProtocolEncodeHit(message, data, PROTOCOL_WIRE_TEXT);
 }
 
 int ProtocolEncodeChaMessage(char *message, const NegotiationData *data) {
-    sprintf(Encode, PAYLOAD_TEMPLATE_CHA, data->encryptedGuess, data->hash);
-    //create cha template with data
-    wordCount = strlen(Encode);
-    Check = Checksum(Encode, wordCount); //create checksum
-    sprintf(message, MESSAGE_TEMPLATE, Encode, Check); //adds checksum to string
-    wordCount = strlen(message);
-    return wordCount; //returns back the string length
+    const uint32_t fields[] = {data->encryptedGuess, data->hash};
+    return ProtocolEncode(message, PROTOCOL_MESSAGE_OF(PROTOCOL_PARSED_CHA_MESSAGE), fields,
+            PROTOCOL_WIRE_TEXT);
 }
 
 int ProtocolEncodeDetMessage(char *message, const NegotiationData *data) {
-    sprintf(Encode, PAYLOAD_TEMPLATE_DET, data->guess, data->encryptionKey);
-    //creates det template with data
-    wordCount = strlen(Encode);
-    Check = Checksum(Encode, wordCount); //create checksum
-    sprintf(message, MESSAGE_TEMPLATE, Encode, Check); //adds checksum to string
-    wordCount = strlen(message);
-    return wordCount; //returns back the string length
+    const uint32_t fields[] = {data->guess, data->encryptionKey};
+    return ProtocolEncode(message, PROTOCOL_MESSAGE_OF(PROTOCOL_PARSED_DET_MESSAGE), fields,
+            PROTOCOL_WIRE_TEXT);
 }
+
+/**
+ * Encodes the coordinate data for a guess into `message` in the given format.
+ * @param message The character array used for storing the output. Must be at least
+ *                PROTOCOL_MAX_MESSAGE_LEN long.
+ * @param data The data struct that holds the data to be encoded into `message`.
+ * @param format The format to encode the message in.
+ * @return The length of the message stored into `message`.
+ */
+int ProtocolEncodeCoo(char *message, const GuessData *data, ProtocolWireFormat format) {
+    const uint32_t fields[] = {data->row, data->col};
+    if (format == PROTOCOL_WIRE_BINARY) {
+        return ProtocolEncodeCooFrame(message, data);
+    }
+    return ProtocolEncode(message, PROTOCOL_MESSAGE_OF(PROTOCOL_PARSED_COO_MESSAGE), fields,
+            format);
+}
+
+int ProtocolEncodeHit(char *message, const GuessData *data, ProtocolWireFormat format) {
+    const uint32_t fields[] = {data->row, data->col, data->hit};
+    if (format == PROTOCOL_WIRE_BINARY) {
+        return ProtocolEncodeHitFrame(message, data);
+    }
+    return ProtocolEncode(message, PROTOCOL_MESSAGE_OF(PROTOCOL_PARSED_HIT_MESSAGE), fields,
+            format);
+}
+
+/**
+ * Encodes a NAK message into `message` in the given format.
+ * @param message The character array used for storing the output. Must be at least
+ *                PROTOCOL_MAX_MESSAGE_LEN long.
+ * @param waitingFor The PROTOCOL_PARSED_* message the sender is waiting for.
+ * @param format The format to encode the message in.
+ * @return The length of the message stored into `message`.
+ */
+int ProtocolEncodeNak(char *message, ProtocolParserStatus waitingFor, ProtocolWireFormat format) {
+    const uint32_t fields[] = {waitingFor};
+    if (format == PROTOCOL_WIRE_BINARY) {
+        const GuessData none = {0, 0, 0};
+        return ProtocolEncodeFrame(message, PROTOCOL_FRAME_NAK, waitingFor, &none);
+    }
+    return ProtocolEncode(message, PROTOCOL_MESSAGE_OF(PROTOCOL_PARSED_NAK_MESSAGE), fields,
+            format);
+}
+
+/**
+ * Encodes the coordinate data for a guess into `message` as a binary frame.
+ * @param message The character array used for storing the output. Must be at least
+ *                PROTOCOL_FRAME_LEN + 1 long.
+ * @param data The data struct that holds the data to be encoded into `message`.
+ * @return The length of the frame stored into `message`.
+ */
+int ProtocolEncodeCooFrame(char *message, const GuessData *data) {
+    return ProtocolEncodeFrame(message, PROTOCOL_FRAME_COO, 0, data);
+}
+
+int ProtocolEncodeHitFrame(char *message, const GuessData *data) {
+    return ProtocolEncodeFrame(message, PROTOCOL_FRAME_HIT, data->hit, data);
+}
+
 /**
  * This function decodes a message into either the NegotiationData or GuessData structs depending
  * on what the type of message is. This function receives the message one byte at a time, where the
@@ -118,96 +274,133 @@ int ProtocolEncodeDetMessage(char *message, const NegotiationData *data) {
 //} ProtocolParserStatus;
 
 ProtocolParserStatus ProtocolDecode(char in, NegotiationData *nData, GuessData *gData) {
+    return ProtocolParserDecode(&pData, in, nData, gData);
+}
 
-    switch (states) {
+/**
+ * Resets a ProtocolParser so that it waits for the start of a new message.
+ * @param parser The parser to initialize.
+ */
+void ProtocolParserInit(ProtocolParser *parser) {
+    parser->state = WAITING;
+}
+
+/**
+ * Works exactly like ProtocolDecode(), but keeps all of its state in `parser`. The whole message is
+ * handled in a single pass: the checksum is folded in as each payload byte arrives, the message ID
+ * is classified once when its terminating ',' arrives, and the data fields are accumulated digit by
+ * digit, so nothing is buffered and no string functions are needed.
+ * @param parser The parser for the message stream that `in` belongs to.
+ * @param in The next character in the NMEA0183 message to be decoded.
+ * @param nData A struct used for storing data if a message is decoded that stores NegotiationData.
+ * @param gData A struct used for storing data if a message is decoded that stores GuessData.
+ * @return A value from the ProtocolParserStatus enum.
+ */
+ProtocolParserStatus ProtocolParserDecode(ProtocolParser *parser, char in, NegotiationData *nData,
+        GuessData *gData) {
+    uint8_t c = (uint8_t) in;
+    uint8_t m;
+
+    switch (parser->state) {
         case (WAITING):
-            if (in != '$') { //dont do anything without start char '$'
-                states = WAITING;
-                return PROTOCOL_WAITING;
-            } else if (in == '$') {
-                for (clear = 0; clear < pData.index; clear++) {
-                    pData.Sentence[clear] = '\0';
+            return ProtocolParserStart(parser, c);
+        case (MESSAGE_ID):
+        case (DATA):
+            if (c == '$' || (c & PROTOCOL_FRAME_MARK)) { //the start of another message
+                return ProtocolParserFail(parser, c);
+            }
+            if (c == '*') { //payload is done, move onto checksum
+                m = parser->message;
+                if (parser->state != DATA || parser->digits == 0 ||
+                        parser->field + 1 != messages[m].fields) {
+                    return ProtocolParserFail(parser, c);
                 }
-                pData.index = 0; //start index at 0
-                states = RECORDING; //move to recording
+                parser->hash = 0;
+                parser->digits = 0;
+                parser->state = CHECKSUM;
                 return PROTOCOL_PARSING_GOOD;
             }
-            break;
-        case (RECORDING):
-            if (in != '*') { //keep in recording until hit char '*'
-                pData.Sentence[pData.index] = in;
-                //add each char to decode sentence
-                pData.index += 1; //increments index
-                states = RECORDING;
-                return PROTOCOL_PARSING_GOOD;
-            } else if (in == '*') {
-                states = FIRST_CHECKSUM_HALF; //move onto checksum
-                return PROTOCOL_PARSING_GOOD;
+            if (++parser->length > PROTOCOL_MAX_PAYLOAD_LEN) {
+                return ProtocolParserFail(parser, c);
             }
-            break;
-        case (FIRST_CHECKSUM_HALF):
-            if (CheckHex(in) == SUCCESS) { //check for valid hex character
-                pData.hash = AsciiToHex(in) << 4; //shift to the top 4 bits
-                states = SECOND_CHECKSUM_HALF; //move to second half of checksum
-                return PROTOCOL_PARSING_GOOD;
-            } else return PROTOCOL_PARSING_FAILURE;
-            break;
-        case (SECOND_CHECKSUM_HALF):
-            if (states == SECOND_CHECKSUM_HALF) {
-                pData.hash = pData.hash^AsciiToHex(in);
-                //adds second half of checksum
-                wordCount = strlen(pData.Sentence);
-                if ((CheckHex(in) == SUCCESS) && (pData.hash ==
-                        (Checksum(pData.Sentence, wordCount)))) {
-                    //checks that checksum is valid hex and is correct
-                    //                    pData.Sentence[pData.index+1] = '\0';
-                    pData.hash = pData.hash & 0x00; //clears hash for reuse
-                    states = NEWLINE;
+            parser->checksum ^= c;
+            parser->crc = (parser->crc << 8) ^ crc16Table[(parser->crc >> 8) ^ c];
+            if (parser->state == MESSAGE_ID) {
+                if (c != ',') {
+                    if (parser->length > PROTOCOL_MAX_ID_LEN) {
+                        return ProtocolParserFail(parser, c);
+                    }
+                    parser->id = (parser->id << 8) | c;
                     return PROTOCOL_PARSING_GOOD;
-                } else return PROTOCOL_PARSING_FAILURE;
+                }
+                //classify the ID once, as soon as it's complete
+                for (m = 0; m < PROTOCOL_NUM_MESSAGES && messages[m].id != parser->id; m++);
+                if (m == PROTOCOL_NUM_MESSAGES) {
+                    return ProtocolParserFail(parser, c);
+                }
+                parser->message = m;
+                parser->state = DATA;
+            } else if (c >= '0' && c <= '9' && parser->digits < PROTOCOL_MAX_DIGITS) {
+                parser->fields[parser->field] = parser->fields[parser->field] * 10 + (c - '0');
+                parser->digits++;
+            } else if (c == ',' && parser->digits > 0 &&
+                    parser->field + 1 < messages[parser->message].fields) {
+                parser->field++;
+                parser->fields[parser->field] = 0;
+                parser->digits = 0;
+            } else {
+                return ProtocolParserFail(parser, c);
             }
-            break;
-        case(NEWLINE):
-            if (in == '\n') { //end of the string with newline
-                states=WAITING;
-                if (MSGID(pData.Sentence) == PROTOCOL_PARSING_FAILURE) {
-                    //if parse fails if string from record isn't valid
-                    states = WAITING;
-                    return PROTOCOL_PARSING_FAILURE;
-                } else if (MSGID(pData.Sentence) == PROTOCOL_PARSED_DET_MESSAGE) {
-                    //if valid string (det,cha,coo,hit) create the decoded sentence
-                    printf("DET\n");
-                    sscanf(pData.Sentence, PAYLOAD_TEMPLATE_DET, &intTemp1, &intTemp2);
-                    nData->guess = intTemp1;
-                    nData->encryptionKey = intTemp2;
-                    return PROTOCOL_PARSED_DET_MESSAGE;
-                } else if (MSGID(pData.Sentence) == PROTOCOL_PARSED_CHA_MESSAGE) {
-                    printf("CHA\n");
-                    sscanf(pData.Sentence, PAYLOAD_TEMPLATE_CHA, &intTemp1, &intTemp2);
-                    nData->encryptedGuess = intTemp1;
-                    nData->hash = intTemp2;
-                    return PROTOCOL_PARSED_CHA_MESSAGE;
-                } else if (MSGID(pData.Sentence) == PROTOCOL_PARSED_COO_MESSAGE) {
-                    printf("COO\n");
-                    sscanf(pData.Sentence, PAYLOAD_TEMPLATE_COO, &intTemp1, &intTemp2);
-                    gData->row = intTemp1;
-                    gData->col = intTemp2;
-                    return PROTOCOL_PARSED_COO_MESSAGE;
-                } else if (MSGID(pData.Sentence) == PROTOCOL_PARSED_HIT_MESSAGE) {
-                    printf("HIT\n");
-                    sscanf(pData.Sentence, PAYLOAD_TEMPLATE_HIT, &intTemp1, &intTemp2, &intTemp3);
-                    gData->row = intTemp1;
-                    gData->col = intTemp2;
-                    gData->hit = intTemp3;
-                    return PROTOCOL_PARSED_HIT_MESSAGE;
+            return PROTOCOL_PARSING_GOOD;
+        case (CHECKSUM):
+            if (c != '\n') {
+                if (hexValues[c] == 0 || parser->digits == PROTOCOL_CRC16_DIGITS) {
+                    return ProtocolParserFail(parser, c);
                 }
-            } else { //fails if no newline char
-                states = WAITING;
-                return PROTOCOL_PARSING_FAILURE;
+                parser->hash = (parser->hash << 4) | (hexValues[c] - 1);
+                parser->digits++;
+                return PROTOCOL_PARSING_GOOD;
+            }
+            //the number of digits tells which of the two checksums was sent
+            if (!(parser->digits == PROTOCOL_XOR_DIGITS && parser->hash == parser->checksum) &&
+                    !(parser->digits == PROTOCOL_CRC16_DIGITS && parser->hash == parser->crc)) {
+                return ProtocolParserFail(parser, c);
+            }
+            parser->state = WAITING;
+            switch (messages[parser->message].status) {
+                case PROTOCOL_PARSED_COO_MESSAGE:
+                    gData->row = parser->fields[0];
+                    gData->col = parser->fields[1];
+                    break;
+                case PROTOCOL_PARSED_HIT_MESSAGE:
+                    gData->row = parser->fields[0];
+                    gData->col = parser->fields[1];
+                    gData->hit = parser->fields[2];
+                    break;
+                case PROTOCOL_PARSED_CHA_MESSAGE:
+                    nData->encryptedGuess = parser->fields[0];
+                    nData->hash = parser->fields[1];
+                    break;
+                case PROTOCOL_PARSED_DET_MESSAGE:
+                    nData->guess = parser->fields[0];
+                    nData->encryptionKey = parser->fields[1];
+                    break;
+                default: //a NAK carries nothing the receiver needs
+                    break;
             }
-            break;
+            return messages[parser->message].status;
+        case (FRAME):
+            if (!(c & PROTOCOL_FRAME_MARK)) { //every data byte has its top bit set
+                return ProtocolParserFail(parser, c);
+            }
+            parser->fields[0] = (parser->fields[0] << PROTOCOL_FRAME_BITS) |
+                    (c & PROTOCOL_FRAME_MASK);
+            if (++parser->length < PROTOCOL_FRAME_DATA_LEN) {
+                return PROTOCOL_PARSING_GOOD;
+            }
+            return ProtocolDecodeFrame(parser, gData);
     }
-    return PROTOCOL_PARSING_FAILURE;
+    return ProtocolParserFail(parser, '\0');
 }
 
 /**
@@ -225,6 +418,15 @@ void ProtocolGenerateNegotiationData(NegotiationData *data) {
     //creates encryption for data
     data->encryptionKey = rand() &0xFFFF;
     data->guess = rand() &0xFFFF;
+    ProtocolEncryptNegotiationData(data);
+}
+
+/**
+ * Fills in the 'encryptedGuess' and 'hash' of `data` from its 'guess' and 'encryptionKey', using
+ * the same algorithm as ProtocolGenerateNegotiationData().
+ * @param data The struct holding the guess and key as input, and receiving the rest as output.
+ */
+void ProtocolEncryptNegotiationData(NegotiationData *data) {
     data->encryptedGuess = data->encryptionKey^data->guess;
     data-> hash = ((data->encryptionKey & 0xFF) ^ (data->guess & 0xFF)
             ^ (data->encryptionKey >> 8) ^ (data->guess >> 8));
@@ -265,7 +467,10 @@ uint8_t ProtocolValidateNegotiationData(const NegotiationData *data) {
 TurnOrder ProtocolGetTurnOrder(const NegotiationData *myData, const NegotiationData *oppData) {
     //chooses turn order based off the encryption keys
     uint8_t turn = (myData->encryptionKey ^ oppData->encryptionKey) & 0x0001;
-    if (turn == 0) {
+    if (myData->encryptionKey == oppData->encryptionKey) {
+        //neither side can win with identical keys
+        return TURN_ORDER_TIE;
+    } else if (turn == 0) {
         if (myData->encryptionKey < oppData->encryptionKey) {
             return TURN_ORDER_START;
         } else {
@@ -280,75 +485,213 @@ TurnOrder ProtocolGetTurnOrder(const NegotiationData *myData, const NegotiationD
     } else return TURN_ORDER_TIE;
 }
 
-ProtocolParserStatus MSGID(char *input) {
-    //this function checks what the recorded string is
-    int count1 = 0;
-    int count2 = 0;
-    int count3 = 0;
-    int count4 = 0;
-    char check1 = 'E';
-    char check2 = 'H';
-    char check3 = 'O';
-    char check4 = 'I';
-    if (check1 == input[1]) {
-        //checks the second char of the recorded sentence
-        count1++;
-    } else if (check2 == input[1]) {
-        count2++;
-    } else if (check3 == input[1]) {
-        count3++;
-    } else if (check4 == input[1]) {
-        count4++;
+/**
+ * Works out the format both agents can use for COO and HIT messages.
+ * @param myData The negotiation data representing the current agent.
+ * @param oppData The negotiation data representing the opposing agent.
+ * @return The best format both agents offered, PROTOCOL_WIRE_TEXT if there is none.
+ */
+ProtocolWireFormat ProtocolGetWireFormat(const NegotiationData *myData,
+        const NegotiationData *oppData) {
+    uint32_t offered = myData->guess & myData->encryptionKey &
+            oppData->guess & oppData->encryptionKey;
+    if (offered & PROTOCOL_NEGOTIATION_BINARY) {
+        return PROTOCOL_WIRE_BINARY;
+    } else if (offered & PROTOCOL_NEGOTIATION_CRC16) {
+        return PROTOCOL_WIRE_TEXT_CRC16;
+    }
+    return PROTOCOL_WIRE_TEXT;
+}
+
+/**
+ * Offers a format for COO and HIT messages in `data`, along with every other format that can stand
+ * in for it.
+ * @param data The negotiation data to offer the format in, before it's encrypted.
+ * @param format The best format to offer.
+ */
+void ProtocolOfferWireFormat(NegotiationData *data, ProtocolWireFormat format) {
+    uint32_t offer = 0;
+    if (format == PROTOCOL_WIRE_BINARY) {
+        offer = PROTOCOL_NEGOTIATION_BINARY | PROTOCOL_NEGOTIATION_CRC16;
+    } else if (format == PROTOCOL_WIRE_TEXT_CRC16) {
+        offer = PROTOCOL_NEGOTIATION_CRC16;
     }
-    if (count1 == 1) {
-        //if matches pass respective parsed message
-        return PROTOCOL_PARSED_DET_MESSAGE;
-    } else if (count2 == 1) {
-        return PROTOCOL_PARSED_CHA_MESSAGE;
-    } else if (count3 == 1) {
-        return PROTOCOL_PARSED_COO_MESSAGE;
-    } else if (count4 == 1) {
-        return PROTOCOL_PARSED_HIT_MESSAGE;
-    } else return PROTOCOL_PARSING_FAILURE;
+    data->guess |= offer;
+    data->encryptionKey |= offer;
+}
+
+/**
+ * Offers to take part in NAK exchanges in `data`.
+ * @param data The negotiation data to make the offer in, before it's encrypted.
+ */
+void ProtocolOfferNak(NegotiationData *data) {
+    data->guess |= PROTOCOL_NEGOTIATION_NAK;
+    data->encryptionKey |= PROTOCOL_NEGOTIATION_NAK;
+}
+
+/**
+ * Works out whether both agents offered to take part in NAK exchanges.
+ * @param myData The negotiation data representing the current agent.
+ * @param oppData The negotiation data representing the opposing agent.
+ * @return TRUE if both did, FALSE otherwise.
+ */
+uint8_t ProtocolGetNak(const NegotiationData *myData, const NegotiationData *oppData) {
+    return (myData->guess & myData->encryptionKey & oppData->guess & oppData->encryptionKey &
+            PROTOCOL_NEGOTIATION_NAK) ? TRUE : FALSE;
 }
 
-static uint8_t AsciiToHex(char input) {
-    //converts char to hex value
-    if (CheckHex(input) == SUCCESS) {
-        if (input == '0' || input == '1' || input == '2' || input == '3' ||
-                input == '4' || input == '5' || input == '6' || input == '7' ||
-                input == '8' || input == '9') {
-            return input - 48;
-        } else if (input == 'A' || input == 'B' || input == 'C' || input == 'D'
-                || input == 'E' || input == 'F') {
-            return input - 87;
-        } else if (input == 'a' || input == 'b' || input == 'c' || input == 'd'
-                || input == 'e' || input == 'f') {
-            return input - 87;
+/**
+ * Writes a whole message into `message`, as MESSAGE_TEMPLATE would with the payload printed from
+ * the message's PAYLOAD_TEMPLATE_*, followed by the checksum of the given format.
+ * @param message Where to store the message. Must be at least PROTOCOL_MAX_MESSAGE_LEN long.
+ * @param type The kind of message to write.
+ * @param fields The values of the message's data fields.
+ * @param format PROTOCOL_WIRE_TEXT_CRC16 for a CRC-16, anything else for the XOR checksum.
+ * @return The length of the message, not counting the terminating '\0'.
+ */
+static int ProtocolEncode(char *message, const ProtocolMessage *type, const uint32_t *fields,
+        ProtocolWireFormat format) {
+    char digits[10];
+    char *out = message + 1;
+    const char *in;
+    uint32_t value;
+    int f, d;
+
+    message[0] = '$';
+    for (d = 0; d < sizeof(type->name); d++) {
+        *out++ = type->name[d];
+    }
+    for (f = 0; f < type->fields; f++) {
+        *out++ = ',';
+        //digits come out least significant first, so collect them before copying them out
+        value = fields[f];
+        d = 0;
+        do {
+            digits[d++] = '0' + value % 10;
+            value /= 10;
+        } while (value);
+        while (d) {
+            *out++ = digits[--d];
+        }
+    }
+    //checksum the payload in one tight loop, only in the format that's sent
+    if (format == PROTOCOL_WIRE_TEXT_CRC16) {
+        uint16_t crc = PROTOCOL_CRC16_INIT;
+        for (in = message + 1; in < out; in++) {
+            crc = (crc << 8) ^ crc16Table[(crc >> 8) ^ (uint8_t) *in];
+        }
+        *out++ = '*';
+        for (d = PROTOCOL_CRC16_DIGITS - 1; d >= 0; d--) {
+            *out++ = hexDigits[(crc >> (4 * d)) & 0xF];
         }
+    } else {
+        uint8_t check = 0;
+        for (in = message + 1; in < out; in++) {
+            check ^= *in;
+        }
+        *out++ = '*';
+        *out++ = hexDigits[check >> 4];
+        *out++ = hexDigits[check & 0xF];
     }
-    return STANDARD_ERROR;
+    *out++ = '\n';
+    *out = '\0';
+    return out - message;
 }
 
-static uint8_t Checksum(char *inStr, int wordCount) {
-    //xor's every recorded char to create checksum
-    uint8_t Check = 0;
-    int Index = 0;
-    while (Index < wordCount) {
-        Check ^= inStr[Index];
-        Index++;
+/**
+ * Writes a binary frame into `message`, see PROTOCOL_FRAME_SYNC.
+ * @param message Where to store the frame. Must be at least PROTOCOL_FRAME_LEN + 1 long.
+ * @param type The PROTOCOL_FRAME_* type of the frame.
+ * @param hit The HitStatus to send, 0 for a COO frame.
+ * @param data The coordinates to send.
+ * @return The length of the frame, not counting the terminating '\0'.
+ */
+static int ProtocolEncodeFrame(char *message, uint8_t type, uint8_t hit, const GuessData *data) {
+    uint8_t head = (type << 3) | (hit & 0x7);
+    uint8_t cell = ((data->row & 0xF) << 4) | (data->col & 0xF);
+    uint32_t bits = ((uint32_t) head << 16) | ((uint32_t) cell << 8) | ProtocolCrc8(head, cell);
+    int i;
+
+    message[0] = (char) PROTOCOL_FRAME_SYNC;
+    for (i = PROTOCOL_FRAME_DATA_LEN; i > 0; i--) {
+        message[i] = (char) (PROTOCOL_FRAME_MARK | (bits & PROTOCOL_FRAME_MASK));
+        bits >>= PROTOCOL_FRAME_BITS;
     }
-    return Check;
+    message[PROTOCOL_FRAME_LEN] = '\0';
+    return PROTOCOL_FRAME_LEN;
 }
 
-int CheckHex(char input) {
-    //checks that input is a valid hex character
-    if (input == '0' || input == '1' || input == '2' || input == '3' ||
-            input == '4' || input == '5' || input == '6' || input == '7' ||
-            input == '8' || input == '9' || input == 'A' || input == 'B' ||
-            input == 'C' || input == 'D' || input == 'E' || input == 'F' ||
-            input == 'a' || input == 'b' || input == 'c' || input == 'd' ||
-            input == 'e' || input == 'f') {
-        return SUCCESS;
-    } else return STANDARD_ERROR;
+/**
+ * Checks the bits of a binary frame collected in `parser` and hands over its contents.
+ * @param parser The parser that has received the whole frame.
+ * @param gData Receives the coordinates of a COO or HIT frame, and for a HIT frame the HitStatus.
+ * @return The PROTOCOL_PARSED_* status of the frame, or PROTOCOL_PARSING_FAILURE if it's corrupt.
+ */
+static ProtocolParserStatus ProtocolDecodeFrame(ProtocolParser *parser, GuessData *gData) {
+    uint32_t bits = parser->fields[0];
+    uint8_t head = bits >> 16, cell = bits >> 8;
+    uint8_t type = head >> 3;
+
+    if (type >= sizeof(frameStatus) / sizeof(frameStatus[0]) ||
+            (uint8_t) bits != ProtocolCrc8(head, cell)) {
+        return ProtocolParserFail(parser, '\0');
+    }
+    parser->state = WAITING;
+    if (type == PROTOCOL_FRAME_NAK) { //carries nothing the receiver needs
+        return PROTOCOL_PARSED_NAK_MESSAGE;
+    }
+    gData->row = cell >> 4;
+    gData->col = cell & 0xF;
+    if (type == PROTOCOL_FRAME_HIT) {
+        gData->hit = head & 0x7;
+    }
+    return frameStatus[type];
+}
+
+/**
+ * Returns the CRC-8 (polynomial 0x07, no reflection, starting from 0) of two bytes.
+ */
+static uint8_t ProtocolCrc8(uint8_t first, uint8_t second) {
+    return crc8Table[crc8Table[first] ^ second];
+}
+
+/**
+ * Starts decoding a new message if `c` is the first byte of one.
+ * @param parser The parser, which must be waiting for a new message.
+ * @param c The next byte in the stream.
+ * @return PROTOCOL_PARSING_GOOD if a message was started, PROTOCOL_WAITING otherwise.
+ */
+static ProtocolParserStatus ProtocolParserStart(ProtocolParser *parser, uint8_t c) {
+    if (c == PROTOCOL_FRAME_SYNC) { //a binary frame, its data follows
+        parser->length = 0;
+        parser->fields[0] = 0;
+        parser->state = FRAME;
+        return PROTOCOL_PARSING_GOOD;
+    }
+    if (c != '$') { //dont do anything without start char '$'
+        return PROTOCOL_WAITING;
+    }
+    parser->length = 0;
+    parser->checksum = 0;
+    parser->crc = PROTOCOL_CRC16_INIT;
+    parser->id = 0;
+    parser->field = 0;
+    parser->digits = 0;
+    parser->fields[0] = 0;
+    parser->state = MESSAGE_ID;
+    return PROTOCOL_PARSING_GOOD;
+}
+
+/**
+ * Abandons the message being decoded after an error. Decoding starts over at the next '$' or sync
+ * byte, which may be the very byte that broke this message: a message whose end was lost shouldn't
+ * take the next one down with it.
+ * @param parser The parser that hit the error.
+ * @param c The byte that caused the error, or '\0' if it can't start a message.
+ * @return PROTOCOL_PARSING_FAILURE.
+ */
+static ProtocolParserStatus ProtocolParserFail(ProtocolParser *parser, uint8_t c) {
+    parser->state = WAITING;
+    ProtocolParserStart(parser, c);
+    return PROTOCOL_PARSING_FAILURE;
 }
@@ -7,10 +7,21 @@
 // The length of the largest possible payload (data between the '$' and '*') supported by Protocol.
 #define PROTOCOL_MAX_PAYLOAD_LEN 32
 
-// The length of the largest possible message. It's '$' + payload + '*' + 2 checksum bytes + newline
-// + null character. This is useful for declaring static buffers for storing messages, as a protocol
-// message is guaranteed not to overflow a buffer if it is at least this big.
-#define PROTOCOL_MAX_MESSAGE_LEN (1 + PROTOCOL_MAX_PAYLOAD_LEN + 1 + 2 + 1 + 1)
+// The length of the largest possible message. It's '$' + payload + '*' + up to 4 checksum bytes +
+// newline + null character. This is useful for declaring static buffers for storing messages, as a
+// protocol message is guaranteed not to overflow a buffer if it is at least this big.
+#define PROTOCOL_MAX_MESSAGE_LEN (1 + PROTOCOL_MAX_PAYLOAD_LEN + 1 + 4 + 1 + 1)
+
+// The length of a binary frame: the sync byte and three bytes of data, see PROTOCOL_FRAME_SYNC.
+#define PROTOCOL_FRAME_LEN 4
+
+// The length of the shortest valid text message: a 3 character ID with two single-digit fields,
+// e.g. "$COO,0,0*4d\n".
+#define PROTOCOL_MIN_TEXT_LEN (1 + 3 + 2 * 2 + 1 + 2 + 1)
+
+// The length of the shortest valid message of any kind, which is a binary frame. No stream of N
+// bytes can hold more than N / PROTOCOL_MIN_MESSAGE_LEN messages.
+#define PROTOCOL_MIN_MESSAGE_LEN PROTOCOL_FRAME_LEN
 
 /**
  * These are the values returned by UnpackageData() depending on the type of message is processed.
@@ -25,10 +36,33 @@ typedef enum {
     PROTOCOL_PARSED_HIT_MESSAGE,   // Hit message. Indicates a response to a Coordinate message.
     PROTOCOL_PARSED_CHA_MESSAGE,   // Challenge message. Used in the first step of negotiating the
                                    // turn order.
-    PROTOCOL_PARSED_DET_MESSAGE    // Determine message. Used in the second and final step of
+    PROTOCOL_PARSED_DET_MESSAGE,   // Determine message. Used in the second and final step of
                                    // negotiating the turn order.
+    PROTOCOL_PARSED_NAK_MESSAGE    // Negative acknowledgement. Asks for the last messages to be
+                                   // sent again, see PROTOCOL_NEGOTIATION_NAK.
 } ProtocolParserStatus;
 
+// The most comma-separated data fields any message carries.
+#define PROTOCOL_MAX_FIELDS 3
+
+/**
+ * ProtocolParser holds the state of one incoming message stream, so that several streams can be
+ * decoded independently with ProtocolParserDecode(). Initialize it with ProtocolParserInit() and
+ * treat the members as private to Protocol.c.
+ */
+typedef struct {
+    uint8_t state;      // The decoder state, private to Protocol.c.
+    uint8_t length;     // How many payload characters have been received.
+    uint8_t checksum;   // The XOR of the payload characters received so far.
+    uint16_t crc;       // The CRC-16 of the payload characters received so far.
+    uint16_t hash;      // The checksum received with the message.
+    uint8_t message;    // Which message the ID was classified as, private to Protocol.c.
+    uint8_t field;      // The data field currently being received.
+    uint8_t digits;     // How many digits the current data field has.
+    uint32_t id;        // The characters of the message ID, packed one per byte.
+    uint32_t fields[PROTOCOL_MAX_FIELDS]; // The values of the data fields.
+} ProtocolParser;
+
 /**
  * Used by the HIT message to respond with what happened after that play. Also used in the GuessData
  * struct's hit member.
@@ -76,6 +110,8 @@ typedef struct {
 #define PAYLOAD_TEMPLATE_COO "COO,%u,%u"    // Coordinate message: row, col
 #define PAYLOAD_TEMPLATE_CHA "CHA,%u,%u"    // Challenge message: encryptedGuess, hash
 #define PAYLOAD_TEMPLATE_DET "DET,%u,%u"    // Determine message: guess, encryptionKey
+#define PAYLOAD_TEMPLATE_NAK "NAK,%u"       // Negative acknowledgement: the PROTOCOL_PARSED_*
+                                            // message the sender waits for, or PROTOCOL_WAITING
 
 /* This constant defines the wrapper used for messages encoded using this protocol.
  * Note that it uses printf-style tokens so that it can be used with sprintf() with two arguments:
@@ -87,8 +123,51 @@ typedef struct {
  *   * <- data sequence terminator
  *   CHECKSUM <- a two-digit ASCII checksum that's the XOR of all of the bytes between the $ and *
  *   \n <- The message is ended with a standard newline character
+ * The XOR checksum misses any error that flips the same bit in two bytes, and any reordering of the
+ * payload. Once both agents have agreed on it during the CHA/DET handshake, COO and HIT messages
+ * instead carry a four-digit CRC-16 (polynomial 0x1021, starting from 0xFFFF) of the same bytes,
+ * see MESSAGE_TEMPLATE_CRC16. The decoder tells the two apart by the number of digits.
  */
 #define MESSAGE_TEMPLATE "$%s*%02x\n"
+#define MESSAGE_TEMPLATE_CRC16 "$%s*%04x\n"
+
+/* Once both agents have found out during the CHA/DET handshake that the other understands them, COO
+ * and HIT messages are sent as binary frames instead, a fraction of the size. A frame is the
+ * PROTOCOL_FRAME_SYNC byte followed by three bytes that carry 7 bits each, with the top bit set:
+ *   TYPE <- 2 bits, the PROTOCOL_FRAME_* type of the frame                       \
+ *   HIT <- 3 bits, the HitStatus of a HIT, what a NAK waits for, 0 for a COO    | - most
+ *   ROW <- 4 bits                                                               |   significant
+ *   COL <- 4 bits                                                               |   first
+ *   CRC <- 8 bits, the CRC-8 (polynomial 0x07) of the bytes TYPE:HIT and ROW:COL /
+ * No byte of a frame is '\0' or 7-bit ASCII, so frames pass through everything that handles
+ * messages as strings and are never mistaken for part of a text message. The decoder accepts both
+ * kinds of message at any time.
+ */
+#define PROTOCOL_FRAME_SYNC 0xA5
+#define PROTOCOL_FRAME_COO 0
+#define PROTOCOL_FRAME_HIT 1
+#define PROTOCOL_FRAME_NAK 2
+
+/**
+ * The formats COO and HIT messages can be sent in.
+ */
+typedef enum {
+    PROTOCOL_WIRE_TEXT,       // NMEA0183 sentences, see MESSAGE_TEMPLATE.
+    PROTOCOL_WIRE_TEXT_CRC16, // NMEA0183 sentences with a CRC-16, see MESSAGE_TEMPLATE_CRC16.
+    PROTOCOL_WIRE_BINARY      // Binary frames, see PROTOCOL_FRAME_SYNC.
+} ProtocolWireFormat;
+
+// An agent that can receive binary frames, or text messages with a CRC-16, sets these bits in both
+// the guess and the encryptionKey of its NegotiationData. They cancel out of the encryptedGuess and
+// the hash, so the CHA message gives nothing away and agents that don't know about them still
+// validate the DET message.
+#define PROTOCOL_NEGOTIATION_BINARY 0x10000
+#define PROTOCOL_NEGOTIATION_CRC16 0x20000
+
+// An agent that answers a NAK message by sending its last messages again, and that sends one itself
+// when a message doesn't get through, sets this bit the same way. Agents only send NAK messages to
+// opponents that offered this too, as to any other a NAK is just a message that fails to parse.
+#define PROTOCOL_NEGOTIATION_NAK 0x40000
 
 /**
  * Encodes the coordinate data for a guess into the string `message`. This string must be big
@@ -118,6 +197,49 @@ int ProtocolEncodeChaMessage(char *message, const NegotiationData *data);
  */
 int ProtocolEncodeDetMessage(char *message, const NegotiationData *data);
 
+/**
+ * Encodes the coordinate data for a guess into `message` in the given format: as a text message
+ * with either checksum, or as a binary frame.
+ * @param message The character array used for storing the output. Must be at least
+ *                PROTOCOL_MAX_MESSAGE_LEN long.
+ * @param data The data struct that holds the data to be encoded into `message`.
+ * @param format The format to encode the message in, see ProtocolGetWireFormat().
+ * @return The length of the message stored into `message`.
+ */
+int ProtocolEncodeCoo(char *message, const GuessData *data, ProtocolWireFormat format);
+
+/**
+ * Follows from ProtocolEncodeCoo above.
+ */
+int ProtocolEncodeHit(char *message, const GuessData *data, ProtocolWireFormat format);
+
+/**
+ * Encodes a NAK message into `message` in the given format, see PAYLOAD_TEMPLATE_NAK.
+ * @param message The character array used for storing the output. Must be at least
+ *                PROTOCOL_MAX_MESSAGE_LEN long.
+ * @param waitingFor The PROTOCOL_PARSED_* message the sender is waiting for, PROTOCOL_WAITING if
+ *                   it isn't waiting for one in particular.
+ * @param format The format to encode the message in, see ProtocolGetWireFormat().
+ * @return The length of the message stored into `message`.
+ */
+int ProtocolEncodeNak(char *message, ProtocolParserStatus waitingFor, ProtocolWireFormat format);
+
+/**
+ * Encodes the coordinate data for a guess into `message` as a binary frame, see
+ * PROTOCOL_FRAME_SYNC. The frame is followed by a '\0' like the text messages are.
+ * @param message The character array used for storing the output. Must be at least
+ *                PROTOCOL_FRAME_LEN + 1 long.
+ * @param data The data struct that holds the data to be encoded into `message`. The row and column
+ *             must be below 16.
+ * @return The length of the frame stored into `message`, always PROTOCOL_FRAME_LEN.
+ */
+int ProtocolEncodeCooFrame(char *message, const GuessData *data);
+
+/**
+ * Follows from ProtocolEncodeCooFrame above.
+ */
+int ProtocolEncodeHitFrame(char *message, const GuessData *data);
+
 /**
  * This function decodes a message into either the NegotiationData or GuessData structs depending
  * on what the type of message is. This function receives the message one byte at a time, where the
@@ -125,10 +247,13 @@ int ProtocolEncodeDetMessage(char *message, const NegotiationData *data);
  * the PAYLOAD_TEMPLATE_* macros. It returns the type of message that was decoded and also places
  * the decoded data into either the `nData` or `gData` structs depending on what the message held.
  * The onus is on the calling function to make sure the appropriate structs are available (blame the
- * lack of function overloading in C for this ugliness).
+ * lack of function overloading in C for this ugliness). COO and HIT messages sent as binary frames
+ * (see PROTOCOL_FRAME_SYNC) are decoded just the same.
  *
  * PROTOCOL_PARSING_FAILURE is returned if there was an error of any kind (though this excludes
- * checking for NULL pointers), while
+ * checking for NULL pointers), after which the rest of the broken message is skipped. A '$' or
+ * PROTOCOL_FRAME_SYNC that turns up where it doesn't belong ends the broken message right away and
+ * starts a new one, so a message that follows a corrupt one isn't lost with it.
  * 
  * @param in The next character in the NMEA0183 message to be decoded.
  * @param nData A struct used for storing data if a message is decoded that stores NegotiationData.
@@ -137,6 +262,25 @@ int ProtocolEncodeDetMessage(char *message, const NegotiationData *data);
  */
 ProtocolParserStatus ProtocolDecode(char in, NegotiationData *nData, GuessData *gData);
 
+/**
+ * Resets a ProtocolParser so that it waits for the start of a new message.
+ * @param parser The parser to initialize.
+ */
+void ProtocolParserInit(ProtocolParser *parser);
+
+/**
+ * Works exactly like ProtocolDecode(), but keeps all of its state in `parser` instead of within
+ * Protocol.c, so that any number of message streams can be decoded at once. ProtocolDecode() is
+ * this function applied to a single parser owned by Protocol.c.
+ * @param parser The parser for the message stream that `in` belongs to.
+ * @param in The next character in the NMEA0183 message to be decoded.
+ * @param nData A struct used for storing data if a message is decoded that stores NegotiationData.
+ * @param gData A struct used for storing data if a message is decoded that stores GuessData.
+ * @return A value from the ProtocolParserStatus enum.
+ */
+ProtocolParserStatus ProtocolParserDecode(ProtocolParser *parser, char in, NegotiationData *nData,
+        GuessData *gData);
+
 /**
  * This function generates all of the data necessary for the negotiation process used to determine
  * the player that goes first. It relies on the pseudo-random functionality built into the standard
@@ -150,6 +294,14 @@ ProtocolParserStatus ProtocolDecode(char in, NegotiationData *nData, GuessData *
  */ 
 void ProtocolGenerateNegotiationData(NegotiationData *data);
 
+/**
+ * Fills in the 'encryptedGuess' and 'hash' of `data` from its 'guess' and 'encryptionKey', using
+ * the same algorithm as ProtocolGenerateNegotiationData(). This lets callers that keep their own
+ * random number generator produce valid negotiation data without touching rand().
+ * @param data The struct holding the guess and key as input, and receiving the rest as output.
+ */
+void ProtocolEncryptNegotiationData(NegotiationData *data);
+
 /**
  * Validates that the negotiation data within 'data' is correct according to the algorithm given in
  * GenerateNegotitateData(). Used for verifying another agent's supplied negotiation data. There is
@@ -175,4 +327,38 @@ uint8_t ProtocolValidateNegotiationData(const NegotiationData *data);
  */
 TurnOrder ProtocolGetTurnOrder(const NegotiationData *myData, const NegotiationData *oppData);
 
+/**
+ * Works out the format both agents can use for COO and HIT messages from what they offered in
+ * their negotiation data, see PROTOCOL_NEGOTIATION_BINARY.
+ * @param myData The negotiation data representing the current agent.
+ * @param oppData The negotiation data representing the opposing agent.
+ * @return The best format both agents offered, PROTOCOL_WIRE_TEXT if there is none.
+ */
+ProtocolWireFormat ProtocolGetWireFormat(const NegotiationData *myData,
+        const NegotiationData *oppData);
+
+/**
+ * Offers a format for COO and HIT messages in `data`, see PROTOCOL_NEGOTIATION_BINARY. Offering
+ * binary frames also offers text with a CRC-16, which is used if the opponent can't do binary.
+ * @param data The negotiation data to offer the format in. Must be called before
+ *             ProtocolEncryptNegotiationData().
+ * @param format The best format to offer. PROTOCOL_WIRE_TEXT offers nothing.
+ */
+void ProtocolOfferWireFormat(NegotiationData *data, ProtocolWireFormat format);
+
+/**
+ * Offers to take part in NAK exchanges in `data`, see PROTOCOL_NEGOTIATION_NAK.
+ * @param data The negotiation data to make the offer in. Must be called before
+ *             ProtocolEncryptNegotiationData().
+ */
+void ProtocolOfferNak(NegotiationData *data);
+
+/**
+ * Works out whether both agents offered to take part in NAK exchanges.
+ * @param myData The negotiation data representing the current agent.
+ * @param oppData The negotiation data representing the opposing agent.
+ * @return TRUE if both did, FALSE otherwise.
+ */
+uint8_t ProtocolGetNak(const NegotiationData *myData, const NegotiationData *oppData);
+
 #endif // PROTOCOL_H
@@ -0,0 +1,370 @@
+#include "Sampler.h"
+#include "BOARD.h"
+#include "Placement.h"
+
+#ifdef HOST_BUILD
+#include <pthread.h>
+#endif
+
+/*
+ * Placements are encoded in 16 bits as the boat type, whether the boat runs down from its first
+ * cell instead of right, and that first cell as `row * FIELD_COLS + col`.
+ */
+#define SAMPLER_BOAT_SHIFT 13
+#define SAMPLER_VERTICAL 0x1000
+#define SAMPLER_CELL_MASK 0x0FFF
+
+#define SAMPLER_LENGTH(boat) (fieldBoatLengths[boat])
+
+#ifndef HOST_BUILD
+// One arena for the single agent on the board, so the samples don't need any stack.
+static SamplerScratch arena;
+#endif
+
+static uint32_t SamplerRandom(uint32_t *state);
+static uint8_t SamplerFits(const SamplerBoard *board, const uint32_t occupied[FIELD_ROWS],
+        int length, int row, int col, uint8_t vertical, uint8_t sunk);
+static void SamplerPlace(uint32_t occupied[FIELD_ROWS], uint16_t placement);
+static int SamplerPlaceAnywhere(const SamplerBoard *board, uint32_t occupied[FIELD_ROWS],
+        BoatType boat, uint32_t *random, uint16_t *placement);
+
+/**
+ * Collects what's known about the enemy's field into a SamplerBoard.
+ * @param board The board to fill in.
+ * @param knowledge The field holding what's known about the enemy's board.
+ * @param alive The enemy boats still afloat, as a BoatStatus bitfield.
+ */
+void SamplerBoardInit(SamplerBoard *board, const Field *knowledge, uint8_t alive)
+{
+    int row, col;
+    for (row = 0; row < FIELD_ROWS; row++) {
+        board->hits[row] = 0;
+        board->unknown[row] = 0;
+        for (col = 0; col < FIELD_COLS; col++) {
+            FieldPosition p = FieldAt(knowledge, row, col);
+            if (p == FIELD_POSITION_HIT) {
+                board->hits[row] |= (uint32_t) 1 << col;
+            } else if (p == FIELD_POSITION_UNKNOWN) {
+                board->unknown[row] |= (uint32_t) 1 << col;
+            }
+        }
+        board->open[row] = board->hits[row] | board->unknown[row];
+    }
+    board->alive = alive;
+}
+
+/**
+ * Draws `samples` random fleets consistent with `board` and counts how many of them have a live
+ * boat on each unknown cell.
+ * @param board What's known about the enemy's field.
+ * @param seed Seeds the random choices.
+ * @param samples How many fleets to try to draw.
+ * @param scratch Working memory, which receives the counts.
+ * @return How many fleets were drawn successfully.
+ */
+int SamplerRun(const SamplerBoard *board, uint32_t seed, int samples, SamplerScratch *scratch)
+{
+    uint32_t random = seed ^ 0x9E3779B9;
+    int accepted = 0, sample, row, col, b, s, k;
+    for (row = 0; row < FIELD_ROWS; row++) {
+        for (col = 0; col < FIELD_COLS; col++) {
+            scratch->counts[row][col] = 0;
+        }
+    }
+    if (random == 0) {
+        random = 1;
+    }
+
+    for (sample = 0; sample < samples; sample++) {
+        uint32_t occupied[FIELD_ROWS] = {0};
+        uint16_t placements[FIELD_NUM_BOATS];
+        uint8_t placed = 0, ok = TRUE;
+
+        //every hit belongs to some boat, so first put a boat through each hit that has none yet
+        while (ok) {
+            int n = 0;
+            for (row = 0; row < FIELD_ROWS; row++) {
+                if (board->hits[row] & ~occupied[row]) {
+                    break;
+                }
+            }
+            if (row == FIELD_ROWS) {
+                break;
+            }
+            col = __builtin_ctz(board->hits[row] & ~occupied[row]);
+            for (b = 0; b < FIELD_NUM_BOATS; b++) {
+                int length = SAMPLER_LENGTH(b);
+                uint8_t sunk = (board->alive & (1 << b)) == 0;
+                uint16_t boat = b << SAMPLER_BOAT_SHIFT;
+                if (placed & (1 << b)) {
+                    continue;
+                }
+                for (s = col - length + 1; s <= col; s++) {
+                    if (s >= 0 && SamplerFits(board, occupied, length, row, s, FALSE, sunk)) {
+                        scratch->candidates[n++] = boat | (row * FIELD_COLS + s);
+                    }
+                }
+                for (s = row - length + 1; s <= row; s++) {
+                    if (s >= 0 && SamplerFits(board, occupied, length, s, col, TRUE, sunk)) {
+                        scratch->candidates[n++] = boat | SAMPLER_VERTICAL | (s * FIELD_COLS + col);
+                    }
+                }
+            }
+            if (n == 0) {
+                ok = FALSE;
+            } else {
+                uint16_t p = scratch->candidates[SamplerRandom(&random) % n];
+                b = p >> SAMPLER_BOAT_SHIFT;
+                SamplerPlace(occupied, p);
+                placements[b] = p;
+                placed |= 1 << b;
+            }
+        }
+
+        //then the boats that are left go wherever they fit, biggest first as it has the least room
+        for (b = FIELD_NUM_BOATS - 1; b >= 0 && ok; b--) {
+            if ((placed & (1 << b)) == 0) {
+                //a sunk boat only covers hits, and those are all taken by now
+                ok = (board->alive & (1 << b)) &&
+                        SamplerPlaceAnywhere(board, occupied, b, &random, &placements[b]);
+            }
+        }
+        if (!ok) {
+            continue;
+        }
+
+        accepted++;
+        for (b = 0; b < FIELD_NUM_BOATS; b++) {
+            uint16_t p = placements[b];
+            int cell = p & SAMPLER_CELL_MASK;
+            if ((board->alive & (1 << b)) == 0) {
+                continue;
+            }
+            row = cell / FIELD_COLS;
+            col = cell % FIELD_COLS;
+            for (k = 0; k < SAMPLER_LENGTH(b); k++) {
+                if (board->unknown[row] & ((uint32_t) 1 << col)) {
+                    scratch->counts[row][col]++;
+                }
+                if (p & SAMPLER_VERTICAL) {
+                    row++;
+                } else {
+                    col++;
+                }
+            }
+        }
+    }
+    return accepted;
+}
+
+/**
+ * Chooses the unknown cell that held a live boat in the most samples.
+ * @param board What's known about the enemy's field.
+ * @param counts The counts left by SamplerRun().
+ * @param random A random number used to pick among equally good cells.
+ * @param guess Receives the row and column to fire at.
+ * @return SUCCESS, or STANDARD_ERROR if no cell was ever covered.
+ */
+int SamplerPick(const SamplerBoard *board, const uint32_t counts[FIELD_ROWS][FIELD_COLS],
+        uint32_t random, GuessData *guess)
+{
+    uint32_t best = 0;
+    int ties = 0, row, col;
+    for (row = 0; row < FIELD_ROWS; row++) {
+        for (col = 0; col < FIELD_COLS; col++) {
+            if ((board->unknown[row] & ((uint32_t) 1 << col)) == 0) {
+                continue;
+            }
+            if (counts[row][col] > best) {
+                best = counts[row][col];
+                ties = 1;
+            } else if (counts[row][col] == best) {
+                ties++;
+            }
+        }
+    }
+    if (best == 0) {
+        return STANDARD_ERROR;
+    }
+    ties = random % ties;
+    for (row = 0; row < FIELD_ROWS; row++) {
+        for (col = 0; col < FIELD_COLS; col++) {
+            if ((board->unknown[row] & ((uint32_t) 1 << col)) && counts[row][col] == best &&
+                    ties-- == 0) {
+                guess->row = row;
+                guess->col = col;
+                return SUCCESS;
+            }
+        }
+    }
+    return STANDARD_ERROR;
+}
+
+/**
+ * Samples the enemy's fleet and chooses where to fire.
+ * @param knowledge The field holding what's known about the enemy's board.
+ * @param alive The enemy boats still afloat, as a BoatStatus bitfield.
+ * @param seed Seeds the random choices.
+ * @param samples How many fleets to try to draw.
+ * @param guess Receives the row and column to fire at.
+ * @return SUCCESS, or STANDARD_ERROR if no fleet consistent with `knowledge` was found.
+ */
+int SamplerChoose(const Field *knowledge, uint8_t alive, uint32_t seed, int samples,
+        GuessData *guess)
+{
+    SamplerBoard board;
+#ifdef HOST_BUILD
+    SamplerScratch arena;
+#endif
+    SamplerBoardInit(&board, knowledge, alive);
+    if (SamplerRun(&board, seed, samples, &arena) == 0) {
+        return STANDARD_ERROR;
+    }
+    return SamplerPick(&board, arena.counts, SamplerRandom(&seed), guess);
+}
+
+#ifdef HOST_BUILD
+/**
+ * The share of the samples drawn by one thread of SamplerChooseParallel().
+ */
+typedef struct {
+    const SamplerBoard *board;
+    uint32_t seed;
+    int samples;
+    SamplerScratch scratch;
+} SamplerJob;
+
+static void *SamplerJobRun(void *arg)
+{
+    SamplerJob *job = arg;
+    SamplerRun(job->board, job->seed, job->samples, &job->scratch);
+    return NULL;
+}
+
+int SamplerChooseParallel(const Field *knowledge, uint8_t alive, uint32_t seed, int samples,
+        int threads, GuessData *guess)
+{
+    SamplerBoard board;
+    SamplerJob jobs[SAMPLER_MAX_THREADS];
+    pthread_t workers[SAMPLER_MAX_THREADS];
+    uint8_t started[SAMPLER_MAX_THREADS] = {FALSE};
+    int i, row, col;
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > SAMPLER_MAX_THREADS) {
+        threads = SAMPLER_MAX_THREADS;
+    }
+    SamplerBoardInit(&board, knowledge, alive);
+    for (i = 0; i < threads; i++) {
+        jobs[i].board = &board;
+        jobs[i].seed = seed + i * 0x61C88647;
+        jobs[i].samples = samples / threads + (i < samples % threads);
+        if (i > 0) {
+            started[i] = pthread_create(&workers[i], NULL, SamplerJobRun, &jobs[i]) == 0;
+            if (!started[i]) {
+                //run it here instead
+                SamplerJobRun(&jobs[i]);
+            }
+        }
+    }
+    SamplerJobRun(&jobs[0]);
+    for (i = 1; i < threads; i++) {
+        if (started[i]) {
+            pthread_join(workers[i], NULL);
+        }
+        for (row = 0; row < FIELD_ROWS; row++) {
+            for (col = 0; col < FIELD_COLS; col++) {
+                jobs[0].scratch.counts[row][col] += jobs[i].scratch.counts[row][col];
+            }
+        }
+    }
+    return SamplerPick(&board, jobs[0].scratch.counts, SamplerRandom(&seed), guess);
+}
+#endif
+
+/**
+ * Returns the next number from a xorshift generator.
+ */
+static uint32_t SamplerRandom(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * Returns whether a boat of `length` with its first cell at (row, col) lies on the field, crosses
+ * only cells that may hold a boat and no other boat, and is either made up entirely of hits if
+ * `sunk`, or has at least one cell that isn't a hit otherwise.
+ */
+static uint8_t SamplerFits(const SamplerBoard *board, const uint32_t occupied[FIELD_ROWS],
+        int length, int row, int col, uint8_t vertical, uint8_t sunk)
+{
+    uint8_t allHits = TRUE;
+    int k;
+    if (vertical) {
+        uint32_t bit = (uint32_t) 1 << col;
+        if (row + length > FIELD_ROWS) {
+            return FALSE;
+        }
+        for (k = row; k < row + length; k++) {
+            if ((board->open[k] & ~occupied[k] & bit) == 0) {
+                return FALSE;
+            }
+            if ((board->hits[k] & bit) == 0) {
+                allHits = FALSE;
+            }
+        }
+    } else {
+        uint32_t mask = (((uint32_t) 1 << length) - 1) << col;
+        if (col + length > FIELD_COLS || (board->open[row] & ~occupied[row] & mask) != mask) {
+            return FALSE;
+        }
+        allHits = (board->hits[row] & mask) == mask;
+    }
+    return sunk ? allHits : !allHits;
+}
+
+/**
+ * Marks the cells of a placement as occupied.
+ */
+static void SamplerPlace(uint32_t occupied[FIELD_ROWS], uint16_t placement)
+{
+    int length = SAMPLER_LENGTH(placement >> SAMPLER_BOAT_SHIFT);
+    int cell = placement & SAMPLER_CELL_MASK;
+    int row = cell / FIELD_COLS, col = cell % FIELD_COLS, k;
+    if (placement & SAMPLER_VERTICAL) {
+        for (k = 0; k < length; k++) {
+            occupied[row + k] |= (uint32_t) 1 << col;
+        }
+    } else {
+        occupied[row] |= (((uint32_t) 1 << length) - 1) << col;
+    }
+}
+
+/**
+ * Places a live boat at a uniformly random spot where it fits, once every hit is already covered.
+ * @return TRUE if the boat was placed, FALSE if it fits nowhere.
+ */
+static int SamplerPlaceAnywhere(const SamplerBoard *board, uint32_t occupied[FIELD_ROWS],
+        BoatType boat, uint32_t *random, uint16_t *placement)
+{
+    uint32_t free[FIELD_ROWS];
+    uint8_t row, col, vertical;
+    for (row = 0; row < FIELD_ROWS; row++) {
+        free[row] = board->open[row] & ~occupied[row];
+    }
+    if (!PlacementChoose(free, SAMPLER_LENGTH(boat), SamplerRandom(random), &row, &col,
+            &vertical)) {
+        return FALSE;
+    }
+    *placement = (boat << SAMPLER_BOAT_SHIFT) | (row * FIELD_COLS + col);
+    if (vertical) {
+        *placement |= SAMPLER_VERTICAL;
+    }
+    SamplerPlace(occupied, *placement);
+    return TRUE;
+}
@@ -0,0 +1,127 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdint.h>
+
+#include "Field.h"
+#include "Protocol.h"
+
+/**
+ * The sampler picks where to fire next by drawing random placements of the whole enemy fleet that
+ * agree with everything known about the enemy's field, and firing at the unknown cell that holds a
+ * boat in the most of them. Unlike the placement counts kept by Targeting.h, each sample accounts
+ * for the boats together: they can't overlap, every hit has to belong to one of them and a sunk
+ * boat has to lie entirely on hits. That makes it much sharper late in the game, when the few
+ * placements left interact.
+ *
+ * Each sample is built with some constraint propagation so that few get thrown away: the boats are
+ * first placed one by one through the hits that no boat covers yet, choosing among only the
+ * placements that still fit, and then the remaining boats are placed wherever they fit. A sample
+ * is rejected when some boat has nowhere left to go.
+ *
+ * All scratch space needed for sampling lives in a SamplerScratch of fixed size. On the PIC32
+ * SamplerChoose() uses a single static one, so it must not be called from more than one context at
+ * a time; on the host each call has its own and SamplerChooseParallel() spreads the samples over
+ * several threads.
+ */
+
+#if FIELD_COLS > 32
+#error "The sampler keeps each row of the field in a 32-bit mask"
+#endif
+#if FIELD_ROWS * FIELD_COLS > 4096
+#error "The sampler numbers cells with 12 bits"
+#endif
+
+/**
+ * How many fleets to draw for every shot. Sampling time grows linearly with this, so it should be
+ * tuned to the time allowed per move: about 200 samples fit within the delay before each guess on
+ * the PIC32. More samples give a better estimate, with quickly diminishing returns.
+ */
+#ifndef SAMPLER_SAMPLES
+#ifdef HOST_BUILD
+#define SAMPLER_SAMPLES 1000
+#else
+#define SAMPLER_SAMPLES 200
+#endif
+#endif
+
+// The most placements there can be to choose from at once.
+#define SAMPLER_MAX_CANDIDATES (2 * FIELD_ROWS * FIELD_COLS)
+
+// The most threads SamplerChooseParallel() will use.
+#define SAMPLER_MAX_THREADS 16
+
+/**
+ * What's known about the enemy's field, as one mask per row with bit `col` for each cell.
+ */
+typedef struct {
+    uint32_t open[FIELD_ROWS];    // Cells that may hold a boat: unknown cells and hits.
+    uint32_t hits[FIELD_ROWS];    // Cells that were hit.
+    uint32_t unknown[FIELD_ROWS]; // Cells that haven't been fired at.
+    uint8_t alive;                // The boats still afloat, as a BoatStatus bitfield.
+} SamplerBoard;
+
+/**
+ * Working memory for drawing samples.
+ */
+typedef struct {
+    uint32_t counts[FIELD_ROWS][FIELD_COLS];       // Samples with a live boat on each cell.
+    uint16_t candidates[SAMPLER_MAX_CANDIDATES];   // Placements to choose the next one from.
+} SamplerScratch;
+
+/**
+ * Collects what's known about the enemy's field into a SamplerBoard.
+ * @param board The board to fill in.
+ * @param knowledge The field holding what's known about the enemy's board.
+ * @param alive The enemy boats still afloat, as a BoatStatus bitfield.
+ */
+void SamplerBoardInit(SamplerBoard *board, const Field *knowledge, uint8_t alive);
+
+/**
+ * Draws `samples` random fleets consistent with `board` and counts, for every unknown cell, how
+ * many of them have a live boat there. The counts are left in `scratch->counts`.
+ * @param board What's known about the enemy's field.
+ * @param seed Seeds the random choices, so the same seed always gives the same counts.
+ * @param samples How many fleets to try to draw.
+ * @param scratch Working memory.
+ * @return How many fleets were drawn successfully.
+ */
+int SamplerRun(const SamplerBoard *board, uint32_t seed, int samples, SamplerScratch *scratch);
+
+/**
+ * Chooses the unknown cell that held a live boat in the most samples. Ties are broken using
+ * `random`.
+ * @param board What's known about the enemy's field.
+ * @param counts The counts left by SamplerRun().
+ * @param random A random number used to pick among equally good cells.
+ * @param guess Receives the row and column to fire at.
+ * @return SUCCESS, or STANDARD_ERROR if no cell was ever covered, in which case `guess` is
+ *         untouched.
+ */
+int SamplerPick(const SamplerBoard *board, const uint32_t counts[FIELD_ROWS][FIELD_COLS],
+        uint32_t random, GuessData *guess);
+
+/**
+ * Samples the enemy's fleet and chooses where to fire, see SamplerRun() and SamplerPick().
+ * @param knowledge The field holding what's known about the enemy's board.
+ * @param alive The enemy boats still afloat, as a BoatStatus bitfield.
+ * @param seed Seeds the random choices.
+ * @param samples How many fleets to try to draw, normally SAMPLER_SAMPLES.
+ * @param guess Receives the row and column to fire at.
+ * @return SUCCESS, or STANDARD_ERROR if no fleet consistent with `knowledge` was found, in which
+ *         case the caller should choose some other way.
+ */
+int SamplerChoose(const Field *knowledge, uint8_t alive, uint32_t seed, int samples,
+        GuessData *guess);
+
+#ifdef HOST_BUILD
+/**
+ * Works like SamplerChoose(), but splits the samples evenly over `threads` threads, each with its
+ * own scratch space and seed. The result only depends on `seed`, `samples` and `threads`.
+ * @param threads How many threads to use, at most SAMPLER_MAX_THREADS.
+ */
+int SamplerChooseParallel(const Field *knowledge, uint8_t alive, uint32_t seed, int samples,
+        int threads, GuessData *guess);
+#endif
+
+#endif // SAMPLER_H
@@ -0,0 +1,81 @@
+#include "Scheduler.h"
+#include "BOARD.h"
+
+#ifndef HOST_BUILD
+#include <xc.h>
+#endif
+
+#ifdef HOST_BUILD
+// Every thread of the host tools keeps time of its own, so that games played side by side don't
+// disturb each other's timers.
+static __thread uint32_t ticks;
+static __thread uint8_t pendingEvents;
+#else
+// Both of these are written from the Timer2 interrupt.
+static volatile uint32_t ticks;
+static volatile uint8_t pendingEvents;
+#endif
+
+void SchedulerTick(void)
+{
+    ticks++;
+    pendingEvents |= SCHEDULER_EVENT_TICK;
+}
+
+uint32_t SchedulerNow(void)
+{
+    return ticks;
+}
+
+void SchedulerSignal(uint8_t events)
+{
+    pendingEvents |= events;
+}
+
+uint8_t SchedulerTakeEvents(void)
+{
+    uint8_t events;
+#ifdef HOST_BUILD
+    events = pendingEvents;
+    pendingEvents = SCHEDULER_EVENT_NONE;
+#else
+    // Keep the interrupt from raising an event between the read and the clear.
+    unsigned int status = __builtin_disable_interrupts();
+    events = pendingEvents;
+    pendingEvents = SCHEDULER_EVENT_NONE;
+    __builtin_mtc0(_CP0_STATUS, _CP0_STATUS_SELECT, status);
+#endif
+    return events;
+}
+
+void SchedulerTimerStart(SchedulerTimer *timer, uint32_t delay)
+{
+    timer->deadline = ticks + delay;
+    timer->armed = TRUE;
+}
+
+uint8_t SchedulerTimerExpired(SchedulerTimer *timer)
+{
+    // Compare as a signed difference so that the tick counter wrapping around doesn't matter.
+    if (timer->armed && (int32_t) (ticks - timer->deadline) >= 0) {
+        timer->armed = FALSE;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+uint8_t SchedulerTimerRunning(const SchedulerTimer *timer)
+{
+    return timer->armed;
+}
+
+void SchedulerIdle(void)
+{
+#ifndef HOST_BUILD
+    // An interrupt between this check and the wait is only noticed at the next one, which the
+    // 100Hz tick bounds to 10ms.
+    if (pendingEvents == SCHEDULER_EVENT_NONE) {
+        _wait();
+    }
+#endif
+}
@@ -0,0 +1,91 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+/**
+ * The scheduler lets the main loop wait for things to happen instead of spinning. Time is counted
+ * in ticks of the 100Hz Timer2 interrupt, which calls SchedulerTick(). Delays are expressed as
+ * SchedulerTimers holding a deadline, which the code that owns them polls as it runs, so nothing
+ * blocks while a delay is pending. Interrupts can also raise event flags with SchedulerSignal(),
+ * which the main loop collects with SchedulerTakeEvents(). When there is nothing left to do the
+ * main loop calls SchedulerIdle(), which sleeps the CPU until the next interrupt.
+ *
+ * On the host build each thread has a clock of its own, which only moves when that thread calls
+ * SchedulerTick() itself. Tools that don't simulate time never do, so there time stands still and
+ * only timers started with a delay of 0 ticks ever expire, immediately.
+ */
+
+// How many times per second SchedulerTick() is called.
+#define SCHEDULER_TICKS_PER_SECOND 100
+
+// Converts milliseconds to scheduler ticks, rounding up.
+#define SCHEDULER_MS_TO_TICKS(ms) (((ms) * SCHEDULER_TICKS_PER_SECOND + 999) / 1000)
+
+/**
+ * The event flags that interrupts can raise for the main loop.
+ */
+typedef enum {
+    SCHEDULER_EVENT_NONE = 0x00,
+    SCHEDULER_EVENT_TICK = 0x01,   // A timer tick has passed, so a SchedulerTimer may have expired.
+    SCHEDULER_EVENT_BUTTONS = 0x02 // There are new button events.
+} SchedulerEvent;
+
+/**
+ * A one-shot timer that expires a number of ticks after it was started.
+ */
+typedef struct {
+    uint32_t deadline; // The tick at which the timer expires.
+    uint8_t armed;     // Whether the timer is running.
+} SchedulerTimer;
+
+/**
+ * Advances the scheduler's clock by one tick. Called from the 100Hz Timer2 interrupt, or on the host
+ * by whatever simulates the passing of time.
+ */
+void SchedulerTick(void);
+
+/**
+ * Returns the number of ticks since startup. It wraps around after about 16 months.
+ */
+uint32_t SchedulerNow(void);
+
+/**
+ * Raises event flags for the main loop. Safe to call from an interrupt.
+ * @param events A bitfield of SchedulerEvents.
+ */
+void SchedulerSignal(uint8_t events);
+
+/**
+ * Returns the event flags raised since the last call and clears them.
+ * @return A bitfield of SchedulerEvents.
+ */
+uint8_t SchedulerTakeEvents(void);
+
+/**
+ * Starts (or restarts) a timer so that it expires `ticks` ticks from now.
+ * @param timer The timer to start.
+ * @param ticks How long until it expires.
+ */
+void SchedulerTimerStart(SchedulerTimer *timer, uint32_t ticks);
+
+/**
+ * Checks whether a timer has expired. A timer reports its expiry only once, after which it is
+ * stopped until it is started again.
+ * @param timer The timer to check.
+ * @return TRUE if the timer was running and its deadline has passed, FALSE otherwise.
+ */
+uint8_t SchedulerTimerExpired(SchedulerTimer *timer);
+
+/**
+ * Returns whether a timer has been started and has not yet been reported as expired.
+ */
+uint8_t SchedulerTimerRunning(const SchedulerTimer *timer);
+
+/**
+ * Sleeps until the next interrupt, unless an event is already pending. The 100Hz tick guarantees
+ * this returns within 10ms, and a UART interrupt wakes it as soon as a byte arrives.
+ */
+void SchedulerIdle(void);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,232 @@
+#include "Targeting.h"
+#include "BOARD.h"
+
+/*
+ * Placements of a boat of length L are numbered with all the horizontal ones first, row by row and
+ * then by the column of their left end, followed by the vertical ones, by the row of their top end
+ * and then by column.
+ */
+
+static int TargetingHorizontalCount(int length);
+static int TargetingPlacementCount(int length);
+static void TargetingApply(TargetingState *t, int length, int p, int delta);
+static void TargetingRemove(TargetingState *t, BoatType boat, int p);
+
+/**
+ * Resets the targeting state for a fresh enemy field where nothing is known yet, so every
+ * placement of every boat is legal.
+ * @param t The state to initialize.
+ */
+void TargetingInit(TargetingState *t)
+{
+    int b, p, row, col;
+    for (row = 0; row < FIELD_ROWS; row++) {
+        for (col = 0; col < FIELD_COLS; col++) {
+            t->density[row][col] = 0;
+        }
+    }
+    for (b = 0; b < FIELD_NUM_BOATS; b++) {
+        int count = TargetingPlacementCount(fieldBoatLengths[b]);
+        for (p = 0; p < (TARGETING_MAX_PLACEMENTS + 31) / 32; p++) {
+            t->legal[b][p] = 0;
+        }
+        for (p = 0; p < count; p++) {
+            t->legal[b][p / 32] |= (uint32_t) 1 << (p % 32);
+            TargetingApply(t, fieldBoatLengths[b], p, 1);
+        }
+    }
+    t->alive = FIELD_BOAT_STATUS_ALL;
+}
+
+/**
+ * Updates the targeting state with the result of one of our shots.
+ * @param t The state to update.
+ * @param result The coordinates of the shot along with its HitStatus.
+ */
+void TargetingUpdate(TargetingState *t, const GuessData *result)
+{
+    int b, p, s, row = result->row, col = result->col;
+    if (result->row >= FIELD_ROWS || result->col >= FIELD_COLS) {
+        return;
+    }
+    if (result->hit == HIT_MISS) {
+        //only the placements crossing the missed cell become illegal
+        for (b = 0; b < FIELD_NUM_BOATS; b++) {
+            int length = fieldBoatLengths[b];
+            int horizontal = TargetingHorizontalCount(length);
+            if ((t->alive & (1 << b)) == 0) {
+                continue;
+            }
+            if (length <= FIELD_COLS) {
+                for (s = col - length + 1; s <= col; s++) {
+                    if (s >= 0 && s + length <= FIELD_COLS) {
+                        TargetingRemove(t, b, row * (FIELD_COLS - length + 1) + s);
+                    }
+                }
+            }
+            for (s = row - length + 1; s <= row; s++) {
+                if (s >= 0 && s + length <= FIELD_ROWS) {
+                    TargetingRemove(t, b, horizontal + s * FIELD_COLS + col);
+                }
+            }
+        }
+    } else if (FIELD_HIT_IS_SUNK(result->hit)) {
+        //a sunk boat no longer contributes anywhere
+        b = FIELD_HIT_SUNK_BOAT(result->hit);
+        if (t->alive & (1 << b)) {
+            int count = TargetingPlacementCount(fieldBoatLengths[b]);
+            for (p = 0; p < count; p++) {
+                TargetingRemove(t, b, p);
+            }
+            t->alive &= ~(1 << b);
+        }
+    }
+}
+
+/**
+ * Chooses the unknown cell most likely to hold a boat.
+ * @param t The current targeting state.
+ * @param knowledge The field holding what's known about the enemy's board.
+ * @param random A random number used to pick among equally good cells.
+ * @param guess Receives the row and column to fire at.
+ */
+void TargetingChoose(const TargetingState *t, const Field *knowledge, uint32_t random,
+        GuessData *guess)
+{
+    uint16_t bonus[FIELD_ROWS][FIELD_COLS] = {{0}};
+    uint32_t best = 0, score;
+    int ties = 0, sunkCells = 0, targeting;
+    int b, row, col;
+
+    //hits beyond the cells of the sunk boats belong to a boat that's still afloat
+    for (b = 0; b < FIELD_NUM_BOATS; b++) {
+        if ((t->alive & (1 << b)) == 0) {
+            sunkCells += fieldBoatLengths[b];
+        }
+    }
+    targeting = FieldCountPositions(knowledge, FIELD_POSITION_HIT) > sunkCells;
+    if (targeting) {
+        //favour every unknown cell of each legal placement running through a hit
+        for (row = 0; row < FIELD_ROWS; row++) {
+            for (col = 0; col < FIELD_COLS; col++) {
+                if (FieldAt(knowledge, row, col) != FIELD_POSITION_HIT) {
+                    continue;
+                }
+                for (b = 0; b < FIELD_NUM_BOATS; b++) {
+                    int length = fieldBoatLengths[b], s, k;
+                    int horizontal = TargetingHorizontalCount(length);
+                    if ((t->alive & (1 << b)) == 0) {
+                        continue;
+                    }
+                    for (s = col - length + 1; s <= col; s++) {
+                        int p = row * (FIELD_COLS - length + 1) + s;
+                        if (s < 0 || s + length > FIELD_COLS ||
+                                (t->legal[b][p / 32] & ((uint32_t) 1 << (p % 32))) == 0) {
+                            continue;
+                        }
+                        for (k = 0; k < length; k++) {
+                            bonus[row][s + k]++;
+                        }
+                    }
+                    for (s = row - length + 1; s <= row; s++) {
+                        int p = horizontal + s * FIELD_COLS + col;
+                        if (s < 0 || s + length > FIELD_ROWS ||
+                                (t->legal[b][p / 32] & ((uint32_t) 1 << (p % 32))) == 0) {
+                            continue;
+                        }
+                        for (k = 0; k < length; k++) {
+                            bonus[s + k][col]++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    //find the best score and how many cells share it
+    for (row = 0; row < FIELD_ROWS; row++) {
+        for (col = 0; col < FIELD_COLS; col++) {
+            if (FieldAt(knowledge, row, col) != FIELD_POSITION_UNKNOWN) {
+                continue;
+            }
+            score = t->density[row][col] + TARGETING_HIT_WEIGHT * (uint32_t) bonus[row][col];
+            if (ties == 0 || score > best) {
+                best = score;
+                ties = 1;
+            } else if (score == best) {
+                ties++;
+            }
+        }
+    }
+    guess->row = 0;
+    guess->col = 0;
+    if (ties == 0) {
+        return;
+    }
+    //then take the randomly chosen one of them
+    ties = random % ties;
+    for (row = 0; row < FIELD_ROWS; row++) {
+        for (col = 0; col < FIELD_COLS; col++) {
+            if (FieldAt(knowledge, row, col) != FIELD_POSITION_UNKNOWN) {
+                continue;
+            }
+            score = t->density[row][col] + TARGETING_HIT_WEIGHT * (uint32_t) bonus[row][col];
+            if (score == best && ties-- == 0) {
+                guess->row = row;
+                guess->col = col;
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * Returns how many horizontal placements a boat of the given length has.
+ */
+static int TargetingHorizontalCount(int length)
+{
+    return length <= FIELD_COLS ? FIELD_ROWS * (FIELD_COLS - length + 1) : 0;
+}
+
+/**
+ * Returns how many placements in total a boat of the given length has.
+ */
+static int TargetingPlacementCount(int length)
+{
+    int vertical = length <= FIELD_ROWS ? (FIELD_ROWS - length + 1) * FIELD_COLS : 0;
+    return TargetingHorizontalCount(length) + vertical;
+}
+
+/**
+ * Adds `delta` to the density of every cell covered by placement `p` of a boat of `length`.
+ */
+static void TargetingApply(TargetingState *t, int length, int p, int delta)
+{
+    int horizontal = TargetingHorizontalCount(length);
+    int row, col, k;
+    if (p < horizontal) {
+        row = p / (FIELD_COLS - length + 1);
+        col = p % (FIELD_COLS - length + 1);
+        for (k = 0; k < length; k++) {
+            t->density[row][col + k] += delta;
+        }
+    } else {
+        row = (p - horizontal) / FIELD_COLS;
+        col = (p - horizontal) % FIELD_COLS;
+        for (k = 0; k < length; k++) {
+            t->density[row + k][col] += delta;
+        }
+    }
+}
+
+/**
+ * Marks placement `p` of `boat` as illegal, removing it from the densities if it was still legal.
+ */
+static void TargetingRemove(TargetingState *t, BoatType boat, int p)
+{
+    uint32_t bit = (uint32_t) 1 << (p % 32);
+    if (t->legal[boat][p / 32] & bit) {
+        t->legal[boat][p / 32] &= ~bit;
+        TargetingApply(t, fieldBoatLengths[boat], p, -1);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef TARGETING_H
+#define TARGETING_H
+
+#include <stdint.h>
+
+#include "Field.h"
+#include "Protocol.h"
+
+/**
+ * The targeting engine picks where to fire next by counting, for every cell of the enemy's field,
+ * how many legal placements of the boats that are still afloat would cover it. A placement is legal
+ * as long as it doesn't cross a cell that is known to be empty. The cell covered by the most
+ * placements is the one most likely to hold a boat.
+ *
+ * The counts are kept up to date incrementally: a miss only removes the few placements that cross
+ * that cell and a sunk boat removes that boat's placements, so hunting costs a single scan over the
+ * field per move. While there are hits that don't yet belong to a sunk boat, the placements through
+ * those hits are weighted much more heavily so the engine finishes off a boat it has found.
+ */
+
+// The most placements a boat can have: every cell as the top or left end, in both orientations.
+#define TARGETING_MAX_PLACEMENTS (2 * FIELD_ROWS * FIELD_COLS)
+
+// How many times more a placement counts when it runs through an unresolved hit.
+#define TARGETING_HIT_WEIGHT 64
+
+/**
+ * The incremental state of the targeting engine for one enemy field.
+ */
+typedef struct {
+    uint32_t legal[FIELD_NUM_BOATS][(TARGETING_MAX_PLACEMENTS + 31) / 32]; // Legal placements.
+    uint16_t density[FIELD_ROWS][FIELD_COLS]; // Legal placements of live boats covering each cell.
+    uint8_t alive; // The boats still afloat, as a BoatStatus bitfield.
+} TargetingState;
+
+/**
+ * Resets the targeting state for a fresh enemy field where nothing is known yet, so every
+ * placement of every boat is legal.
+ * @param t The state to initialize.
+ */
+void TargetingInit(TargetingState *t);
+
+/**
+ * Updates the targeting state with the result of one of our shots. This should be called after the
+ * result has been recorded in the knowledge field with FieldUpdateKnowledge().
+ * @param t The state to update.
+ * @param result The coordinates of the shot along with its HitStatus.
+ */
+void TargetingUpdate(TargetingState *t, const GuessData *result);
+
+/**
+ * Chooses the unknown cell most likely to hold a boat. Ties are broken using `random`, so that the
+ * agent's shots can't be predicted from its targeting.
+ * @param t The current targeting state.
+ * @param knowledge The field holding what's known about the enemy's board.
+ * @param random A random number used to pick among equally good cells.
+ * @param guess Receives the row and column to fire at.
+ */
+void TargetingChoose(const TargetingState *t, const Field *knowledge, uint32_t random,
+        GuessData *guess);
+
+#endif // TARGETING_H
@@ -0,0 +1,218 @@
+/*
+ * AgentCheck plays the artificial agent against itself in games where one side does something
+ * unusual, to check that the game still ends with one agent having won and the other having lost.
+ * Each case tampers with what one of the agents sends, and every step is one scheduler tick, so
+ * the agents' timeouts run like in Tournament.
+ *
+ * Usage: AgentCheck [-v]
+ *
+ * -v prints every message sent. The exit status is 0 only if every case passed.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Agent.h"
+#include "BOARD.h"
+#include "Protocol.h"
+#include "Scheduler.h"
+
+// A game that hasn't finished after this many steps has stalled.
+#define CHECK_MAX_STEPS 100000
+
+// Big enough for everything sent in one direction in one step.
+#define CHECK_PIPE_SIZE 256
+
+// The seeds of the two agents, the same for every case.
+#define CHECK_SEED_A 0x1234
+#define CHECK_SEED_B 0x5678
+
+/**
+ * What a case has seen so far of the game it tampers with.
+ */
+typedef struct {
+    ProtocolParser parsers[2]; // For what each agent sends.
+    NegotiationData nData;
+    GuessData gData;
+    GuessData firstShot; // The first COO agent B sent.
+    uint8_t shotSeen;    // Whether there was one yet.
+    uint8_t tampered;    // Whether the case has tampered with a message yet.
+} CheckTamper;
+
+/**
+ * A game to play. `tamper` is handed everything agent `p` sends in one step, and may change it.
+ */
+typedef struct {
+    const char *name;
+    uint8_t nak; // Whether the agents offer NAKs.
+    void (*tamper)(CheckTamper *t, const AgentContext *agents, int p, char *out, int *length);
+} CheckCase;
+
+static void CheckRepeatShot(CheckTamper *t, const AgentContext *agents, int p, char *out,
+        int *length);
+static void CheckCorruptLastHit(CheckTamper *t, const AgentContext *agents, int p, char *out,
+        int *length);
+
+static const CheckCase cases[] = {
+    // B fires at the same cell every turn, which must be answered each time rather than taken for
+    // the COO it already answered arriving again.
+    {"repeated shot, NAK", TRUE, CheckRepeatShot},
+    {"repeated shot, no NAK", FALSE, CheckRepeatShot},
+    // The HIT for the shot that sinks the loser's last boat is corrupted, so the loser must still
+    // answer the winner's NAK after having lost.
+    {"last HIT corrupted", TRUE, CheckCorruptLastHit},
+};
+
+static const char *const CheckStateNames[] = {
+    [AGENT_STATE_GENERATE_NEG_DATA] = "GENERATE_NEG_DATA",
+    [AGENT_STATE_SEND_CHALLENGE_DATA] = "SEND_CHALLENGE_DATA",
+    [AGENT_STATE_DETERMINE_TURN_ORDER] = "DETERMINE_TURN_ORDER",
+    [AGENT_STATE_SEND_GUESS] = "SEND_GUESS",
+    [AGENT_STATE_WAIT_FOR_HIT] = "WAIT_FOR_HIT",
+    [AGENT_STATE_WAIT_FOR_GUESS] = "WAIT_FOR_GUESS",
+    [AGENT_STATE_INVALID] = "INVALID",
+    [AGENT_STATE_LOST] = "LOST",
+    [AGENT_STATE_WON] = "WON"
+};
+
+static int verbose;
+
+/**
+ * Replaces every COO agent B sends after its first with the first one. B still believes it fired
+ * where it chose to, so the HITs A sends back are turned into the HITs for those cells.
+ */
+static void CheckRepeatShot(CheckTamper *t, const AgentContext *agents, int p, char *out,
+        int *length)
+{
+    char tampered[CHECK_PIPE_SIZE];
+    int tamperedLength = 0, start = 0, i;
+
+    for (i = 0; i < *length; i++) {
+        ProtocolParserStatus status;
+        if (out[i] == '$') {
+            start = tamperedLength;
+        }
+        tampered[tamperedLength++] = out[i];
+        status = ProtocolParserDecode(&t->parsers[p], out[i], &t->nData, &t->gData);
+        if (p == 1 && status == PROTOCOL_PARSED_COO_MESSAGE) {
+            if (!t->shotSeen) {
+                t->firstShot = t->gData;
+                t->shotSeen = TRUE;
+                continue;
+            }
+            tamperedLength = start + ProtocolEncodeCoo(&tampered[start], &t->firstShot,
+                    PROTOCOL_WIRE_TEXT);
+            t->tampered = TRUE;
+        } else if (p == 0 && status == PROTOCOL_PARSED_HIT_MESSAGE) {
+            t->gData.row = agents[1].guess.row;
+            t->gData.col = agents[1].guess.col;
+            tamperedLength = start + ProtocolEncodeHit(&tampered[start], &t->gData,
+                    PROTOCOL_WIRE_TEXT);
+        }
+    }
+    memcpy(out, tampered, tamperedLength);
+    *length = tamperedLength;
+}
+
+/**
+ * Breaks the checksum of the message sent by the agent that has just lost.
+ */
+static void CheckCorruptLastHit(CheckTamper *t, const AgentContext *agents, int p, char *out,
+        int *length)
+{
+    if (t->tampered || AgentContextGetState(&agents[p]) != AGENT_STATE_LOST || *length < 2) {
+        return;
+    }
+    //the last digit of the checksum, just before the newline
+    out[*length - 2] = out[*length - 2] == '0' ? '1' : '0';
+    t->tampered = TRUE;
+}
+
+/**
+ * Plays the game of case `c`.
+ * @return NULL if it ended with one agent having won and the other having lost, otherwise why not.
+ */
+static const char *CheckRun(const CheckCase *c)
+{
+    static AgentContext agents[2];
+    char pipes[2][CHECK_PIPE_SIZE];
+    int pipeLengths[2] = {0, 0};
+    char out[AGENT_RUN_BUFFER_OUT_LEN(CHECK_PIPE_SIZE)];
+    CheckTamper t;
+    uint32_t step;
+    int p;
+
+    memset(&t, 0, sizeof(t));
+    ProtocolParserInit(&t.parsers[0]);
+    ProtocolParserInit(&t.parsers[1]);
+    AgentContextInit(&agents[0], CHECK_SEED_A);
+    AgentContextInit(&agents[1], CHECK_SEED_B);
+    for (p = 0; p < 2; p++) {
+        //text, so that the messages are easy to tamper with
+        AgentContextSetWireFormat(&agents[p], PROTOCOL_WIRE_TEXT);
+        AgentContextSetNak(&agents[p], c->nak);
+    }
+
+    for (step = 0; step < CHECK_MAX_STEPS; step++) {
+        SchedulerTick();
+        for (p = 0; p < 2; p++) {
+            int length = AgentContextRunBuffer(&agents[p], pipes[p], pipeLengths[p], out);
+            pipeLengths[p] = 0;
+            if (length <= 0) {
+                continue;
+            }
+            c->tamper(&t, agents, p, out, &length);
+            if (verbose) {
+                printf("  %c: %.*s", 'A' + p, length, out);
+            }
+            if (pipeLengths[!p] + length > CHECK_PIPE_SIZE) {
+                return "too much sent in one step";
+            }
+            memcpy(&pipes[!p][pipeLengths[!p]], out, length);
+            pipeLengths[!p] += length;
+        }
+        AgentState a = AgentContextGetState(&agents[0]);
+        AgentState b = AgentContextGetState(&agents[1]);
+        if (a == AGENT_STATE_INVALID || b == AGENT_STATE_INVALID) {
+            printf("  A is %s, B is %s\n", CheckStateNames[a], CheckStateNames[b]);
+            return "an agent gave up on the game";
+        }
+        if ((a == AGENT_STATE_WON && b == AGENT_STATE_LOST) ||
+                (a == AGENT_STATE_LOST && b == AGENT_STATE_WON)) {
+            return t.tampered ? NULL : "the game was never tampered with";
+        }
+    }
+    printf("  A is %s, B is %s\n", CheckStateNames[AgentContextGetState(&agents[0])],
+            CheckStateNames[AgentContextGetState(&agents[1])]);
+    return "the game stalled";
+}
+
+int main(int argc, char *argv[])
+{
+    int failures = 0;
+    size_t i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = TRUE;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const char *failure = CheckRun(&cases[i]);
+        if (failure != NULL) {
+            printf("FAIL %s: %s\n", cases[i].name, failure);
+            failures++;
+        } else {
+            printf("ok   %s\n", cases[i].name);
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,494 @@
+/*
+ * EngineBench measures the throughput of the game engine's hot paths on the host. Each benchmark
+ * runs a fixed number of iterations and reports how many operations per second it sustained, so
+ * that runs from different commits can be compared directly.
+ *
+ * Usage: EngineBench [iterations] [benchmark name]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Agent.h"
+#include "BOARD.h"
+#include "Field.h"
+#include "Journal.h"
+#include "LegacyProtocol.h"
+#include "Placement.h"
+#include "Protocol.h"
+#include "Sampler.h"
+#include "Targeting.h"
+
+#define BENCH_DEFAULT_ITERATIONS 200000
+
+typedef struct {
+    const char *name;
+    const char *unit;
+    uint64_t (*run)(uint32_t iterations);
+    const char *also; // A second unit the benchmark counts in benchAlso, NULL if there is none.
+} Benchmark;
+
+static uint32_t benchSeed = 0x12345678;
+static uint64_t benchAlso;
+
+// A small xorshift generator so that the benchmarks don't measure rand() and are repeatable.
+static uint32_t BenchRandom(void)
+{
+    benchSeed ^= benchSeed << 13;
+    benchSeed ^= benchSeed >> 17;
+    benchSeed ^= benchSeed << 5;
+    return benchSeed;
+}
+
+static void BenchPlaceFleet(Field *f)
+{
+    BoatType type;
+    FieldInit(f, FIELD_POSITION_EMPTY);
+    for (type = 0; type < FIELD_NUM_BOATS; type++) {
+        while (FieldAddBoat(f, BenchRandom() % FIELD_ROWS, BenchRandom() % FIELD_COLS,
+                BenchRandom() % 4, type) == FALSE);
+    }
+}
+
+/**
+ * Places a full fleet on a fresh field.
+ */
+static uint64_t BenchPlacement(uint32_t iterations)
+{
+    Field f;
+    uint32_t n;
+    for (n = 0; n < iterations; n++) {
+        BenchPlaceFleet(&f);
+    }
+    return iterations;
+}
+
+// How many fleets the uniform placement benchmark generates per batch.
+#define BENCH_FLEET_BATCH 256
+
+/**
+ * Places fleets in batches with the single-step generator, for comparison with BenchPlacement(),
+ * which retries random spots until each boat fits.
+ */
+static uint64_t BenchPlacementUniform(uint32_t iterations)
+{
+    static Field fleets[BENCH_FLEET_BATCH];
+    uint64_t placed = 0;
+    uint32_t n;
+    for (n = 0; n < iterations; n += BENCH_FLEET_BATCH) {
+        int count = iterations - n < BENCH_FLEET_BATCH ? iterations - n : BENCH_FLEET_BATCH;
+        placed += PlacementFleets(fleets, count, BenchRandom());
+    }
+    return placed;
+}
+
+/**
+ * Plays out whole boards: every cell is attacked in a shuffled order and the result is recorded in
+ * a knowledge field, until the whole fleet is sunk. Each attack counts as one move.
+ */
+static uint64_t BenchMoves(uint32_t iterations)
+{
+    Field mine, theirs;
+    GuessData g;
+    uint8_t cells[FIELD_ROWS * FIELD_COLS];
+    uint64_t moves = 0;
+    uint32_t n;
+    int i;
+    for (n = 0; n < iterations; n++) {
+        BenchPlaceFleet(&mine);
+        FieldInit(&theirs, FIELD_POSITION_UNKNOWN);
+        for (i = 0; i < FIELD_ROWS * FIELD_COLS; i++) {
+            cells[i] = i;
+        }
+        for (i = FIELD_ROWS * FIELD_COLS - 1; i >= 0 && FieldGetBoatStates(&mine); i--) {
+            int j = BenchRandom() % (i + 1);
+            uint8_t cell = cells[j];
+            cells[j] = cells[i];
+            g.row = cell / FIELD_COLS;
+            g.col = cell % FIELD_COLS;
+            FieldRegisterEnemyAttack(&mine, &g);
+            FieldUpdateKnowledge(&theirs, &g);
+            moves++;
+        }
+    }
+    return moves;
+}
+
+// How many boards the attack benchmark fires at in turn.
+#define BENCH_ATTACK_BOARDS 256
+
+/**
+ * Fires one shot at a random cell of each of a batch of random boards per iteration, repeats
+ * included, the way the opponent's COO messages land. The boards are restored once each has taken
+ * as many shots as it has cells.
+ */
+static uint64_t BenchAttack(uint32_t iterations)
+{
+    static Field fresh[BENCH_ATTACK_BOARDS], boards[BENCH_ATTACK_BOARDS];
+    GuessData g;
+    uint32_t n;
+    int b;
+    PlacementFleets(fresh, BENCH_ATTACK_BOARDS, BenchRandom());
+    for (n = 0; n < iterations; n++) {
+        if (n % (FIELD_ROWS * FIELD_COLS) == 0) {
+            memcpy(boards, fresh, sizeof(boards));
+        }
+        for (b = 0; b < BENCH_ATTACK_BOARDS; b++) {
+            uint32_t r = BenchRandom();
+            g.row = (r >> 8) % FIELD_ROWS;
+            g.col = (r >> 16) % FIELD_COLS;
+            FieldRegisterEnemyAttack(&boards[b], &g);
+        }
+    }
+    return (uint64_t) iterations * BENCH_ATTACK_BOARDS;
+}
+
+/**
+ * Plays out whole boards with the density targeting engine choosing every shot. Each shot, with
+ * its TargetingChoose() and TargetingUpdate(), counts as one move.
+ */
+static uint64_t BenchTargeting(uint32_t iterations)
+{
+    Field mine, theirs;
+    TargetingState t;
+    GuessData g;
+    uint64_t moves = 0;
+    uint32_t n;
+    for (n = 0; n < iterations; n++) {
+        BenchPlaceFleet(&mine);
+        FieldInit(&theirs, FIELD_POSITION_UNKNOWN);
+        TargetingInit(&t);
+        while (FieldGetBoatStates(&mine)) {
+            TargetingChoose(&t, &theirs, BenchRandom(), &g);
+            FieldRegisterEnemyAttack(&mine, &g);
+            FieldUpdateKnowledge(&theirs, &g);
+            TargetingUpdate(&t, &g);
+            moves++;
+        }
+    }
+    return moves;
+}
+
+/**
+ * Counts the unknown cells of a partially explored knowledge field, as the targeting code does to
+ * see how much of the board is left.
+ */
+static uint64_t BenchCount(uint32_t iterations)
+{
+    Field theirs;
+    uint64_t total = 0;
+    uint32_t n;
+    int i;
+    FieldInit(&theirs, FIELD_POSITION_UNKNOWN);
+    for (i = 0; i < FIELD_ROWS * FIELD_COLS / 2; i++) {
+        FieldSetLocation(&theirs, BenchRandom() % FIELD_ROWS, BenchRandom() % FIELD_COLS,
+                (BenchRandom() & 1) ? FIELD_POSITION_HIT : FIELD_POSITION_EMPTY);
+    }
+    for (n = 0; n < iterations; n++) {
+        total += FieldCountPositions(&theirs, FIELD_POSITION_UNKNOWN);
+    }
+    return total ? iterations : 0;
+}
+
+/**
+ * Encodes a COO and a HIT message and decodes both of them again, one byte at a time.
+ */
+static uint64_t BenchProtocol(uint32_t iterations)
+{
+    char message[PROTOCOL_MAX_MESSAGE_LEN];
+    NegotiationData nData;
+    GuessData in, out;
+    uint64_t messages = 0;
+    uint32_t n;
+    int len, i;
+    for (n = 0; n < iterations; n++) {
+        in.row = BenchRandom() % FIELD_ROWS;
+        in.col = BenchRandom() % FIELD_COLS;
+        in.hit = BenchRandom() % (HIT_SUNK_HUGE_BOAT + 1);
+        len = ProtocolEncodeCooMessage(message, &in);
+        for (i = 0; i < len; i++) {
+            ProtocolDecode(message[i], &nData, &out);
+        }
+        len = ProtocolEncodeHitMessage(message, &in);
+        for (i = 0; i < len; i++) {
+            ProtocolDecode(message[i], &nData, &out);
+        }
+        messages += 2;
+    }
+    return messages;
+}
+
+/**
+ * Does the same with COO and HIT binary frames.
+ */
+static uint64_t BenchProtocolBinary(uint32_t iterations)
+{
+    char message[PROTOCOL_MAX_MESSAGE_LEN];
+    NegotiationData nData;
+    GuessData in, out;
+    uint64_t messages = 0;
+    uint32_t n;
+    int len, i;
+    for (n = 0; n < iterations; n++) {
+        in.row = BenchRandom() % FIELD_ROWS;
+        in.col = BenchRandom() % FIELD_COLS;
+        in.hit = BenchRandom() % (HIT_SUNK_HUGE_BOAT + 1);
+        len = ProtocolEncodeCooFrame(message, &in);
+        for (i = 0; i < len; i++) {
+            ProtocolDecode(message[i], &nData, &out);
+        }
+        len = ProtocolEncodeHitFrame(message, &in);
+        for (i = 0; i < len; i++) {
+            ProtocolDecode(message[i], &nData, &out);
+        }
+        if (out.row != in.row || out.col != in.col || out.hit != in.hit) {
+            printf("frame decoded wrong\n");
+            return 0;
+        }
+        messages += 2;
+    }
+    return messages;
+}
+
+// How many messages the decode benchmarks cycle through.
+#define BENCH_STREAM_MESSAGES 1024
+
+typedef ProtocolParserStatus (*BenchDecoder)(char in, NegotiationData *nData, GuessData *gData);
+
+/**
+ * Decodes a stream of every message type, one byte at a time, with the given decoder. The stream
+ * is encoded up front so that only decoding is timed. The messages decoded are counted in
+ * benchAlso.
+ * @param corrupt Breaks one byte of every `corrupt`th message, so that the decoder has to find the
+ *                next one. 0 breaks none.
+ */
+static uint64_t BenchDecodeStream(uint32_t iterations, BenchDecoder decode,
+        ProtocolWireFormat format, uint32_t corrupt)
+{
+    static char stream[BENCH_STREAM_MESSAGES * PROTOCOL_MAX_MESSAGE_LEN];
+    NegotiationData nData;
+    GuessData gData;
+    size_t length = 0, i;
+    uint32_t n, broken = 0;
+    int len;
+    for (n = 0; n < BENCH_STREAM_MESSAGES; n++) {
+        nData.guess = BenchRandom() & 0xFFFF;
+        nData.encryptionKey = BenchRandom() & 0xFFFF;
+        ProtocolEncryptNegotiationData(&nData);
+        gData.row = BenchRandom() % FIELD_ROWS;
+        gData.col = BenchRandom() % FIELD_COLS;
+        gData.hit = BenchRandom() % (HIT_SUNK_HUGE_BOAT + 1);
+        switch (n % 4) {
+        case 0:
+            len = ProtocolEncodeChaMessage(stream + length, &nData);
+            break;
+        case 1:
+            len = ProtocolEncodeDetMessage(stream + length, &nData);
+            break;
+        case 2:
+            len = ProtocolEncodeCoo(stream + length, &gData, format);
+            break;
+        default:
+            len = ProtocolEncodeHit(stream + length, &gData, format);
+            break;
+        }
+        //'#' can't stand anywhere in a message, nor start one
+        if (corrupt && n % corrupt == corrupt - 1) {
+            stream[length + BenchRandom() % len] = '#';
+            broken++;
+        }
+        length += len;
+    }
+    benchAlso = 0;
+    for (n = 0; n < iterations; n++) {
+        for (i = 0; i < length; i++) {
+            benchAlso += decode(stream[i], &nData, &gData) >= PROTOCOL_PARSED_COO_MESSAGE;
+        }
+    }
+    if (benchAlso != (uint64_t) iterations * (BENCH_STREAM_MESSAGES - broken)) {
+        printf("decoded %llu of %llu messages\n", (unsigned long long) benchAlso,
+                (unsigned long long) iterations * (BENCH_STREAM_MESSAGES - broken));
+    }
+    return (uint64_t) iterations * length;
+}
+
+/**
+ * Decodes a stream of messages with ProtocolDecode().
+ */
+static uint64_t BenchDecode(uint32_t iterations)
+{
+    return BenchDecodeStream(iterations, ProtocolDecode, PROTOCOL_WIRE_TEXT, 0);
+}
+
+/**
+ * Decodes the same stream with CRC-16 checksums on the COO and HIT messages.
+ */
+static uint64_t BenchDecodeCrc16(uint32_t iterations)
+{
+    return BenchDecodeStream(iterations, ProtocolDecode, PROTOCOL_WIRE_TEXT_CRC16, 0);
+}
+
+/**
+ * Decodes the same stream with binary frames for the COO and HIT messages.
+ */
+static uint64_t BenchDecodeBinary(uint32_t iterations)
+{
+    return BenchDecodeStream(iterations, ProtocolDecode, PROTOCOL_WIRE_BINARY, 0);
+}
+
+/**
+ * Decodes the same stream in text with one message in 16 broken, as a noisy link would deliver it.
+ */
+static uint64_t BenchDecodeNoisy(uint32_t iterations)
+{
+    return BenchDecodeStream(iterations, ProtocolDecode, PROTOCOL_WIRE_TEXT, 16);
+}
+
+/**
+ * Decodes the same stream with the original buffering decoder, for comparison.
+ */
+static uint64_t BenchDecodeLegacy(uint32_t iterations)
+{
+    return BenchDecodeStream(iterations, LegacyProtocolDecode, PROTOCOL_WIRE_TEXT, 0);
+}
+
+/**
+ * Initializes the agent, which places its fleet.
+ */
+static uint64_t BenchAgentInit(uint32_t iterations)
+{
+    uint32_t n;
+    for (n = 0; n < iterations; n++) {
+        AgentInit();
+    }
+    return iterations;
+}
+
+/**
+ * Records what one exchanged message adds to the journal: the bytes that came in, the message they
+ * decoded to, the bytes sent back and a change of state, all on the same tick.
+ */
+static uint64_t BenchJournal(uint32_t iterations)
+{
+    static Journal journal;
+    static const char line[] = "$COO,3,7*5b\n";
+    GuessData g = {3, 7, HIT_MISS};
+    uint32_t n;
+    JournalInit(&journal);
+    for (n = 0; n < iterations; n++) {
+        JournalBytes(&journal, JOURNAL_EVENT_RUN_BUFFER, line, sizeof(line) - 1);
+        JournalDecoded(&journal, PROTOCOL_PARSED_COO_MESSAGE, NULL, &g);
+        JournalBytes(&journal, JOURNAL_EVENT_SENT, line, sizeof(line) - 1);
+        JournalValue(&journal, JOURNAL_EVENT_STATE, n & 7);
+    }
+    return (uint64_t) iterations * 4;
+}
+
+/**
+ * Fills `theirs` with what's known after a third of the cells of a random fleet have been fired at,
+ * for the sampling benchmarks.
+ * @return The enemy boats still afloat.
+ */
+static uint8_t BenchMidGame(Field *theirs)
+{
+    Field mine;
+    GuessData g;
+    int i;
+    BenchPlaceFleet(&mine);
+    FieldInit(theirs, FIELD_POSITION_UNKNOWN);
+    for (i = 0; i < FIELD_ROWS * FIELD_COLS / 3; i++) {
+        g.row = BenchRandom() % FIELD_ROWS;
+        g.col = BenchRandom() % FIELD_COLS;
+        FieldRegisterEnemyAttack(&mine, &g);
+        FieldUpdateKnowledge(theirs, &g);
+    }
+    return FieldGetBoatStates(&mine);
+}
+
+/**
+ * Draws `iterations` fleets for a mid-game board with the sampler on one thread.
+ */
+static uint64_t BenchSampling(uint32_t iterations)
+{
+    static SamplerScratch scratch;
+    SamplerBoard board;
+    Field theirs;
+    uint8_t alive = BenchMidGame(&theirs);
+    SamplerBoardInit(&board, &theirs, alive);
+    if (SamplerRun(&board, BenchRandom(), iterations, &scratch) == 0) {
+        printf("no fleet fits the board\n");
+    }
+    return iterations;
+}
+
+/**
+ * Draws `iterations` fleets for the same kind of board, spread over every core.
+ */
+static uint64_t BenchSamplingParallel(uint32_t iterations)
+{
+    Field theirs;
+    GuessData g;
+    uint8_t alive = BenchMidGame(&theirs);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    SamplerChooseParallel(&theirs, alive, BenchRandom(), iterations,
+            cores > SAMPLER_MAX_THREADS ? SAMPLER_MAX_THREADS : (int) cores, &g);
+    return iterations;
+}
+
+static const Benchmark benchmarks[] = {
+    {"placement", "fleets", BenchPlacement},
+    {"placement-uniform", "fleets", BenchPlacementUniform},
+    {"moves", "moves", BenchMoves},
+    {"attack", "attacks", BenchAttack},
+    {"count", "counts", BenchCount},
+    {"targeting", "moves", BenchTargeting},
+    {"sampling", "samples", BenchSampling},
+    {"sampling-threads", "samples", BenchSamplingParallel},
+    {"protocol", "messages", BenchProtocol},
+    {"protocol-binary", "messages", BenchProtocolBinary},
+    {"decode", "bytes", BenchDecode, "messages"},
+    {"decode-crc16", "bytes", BenchDecodeCrc16, "messages"},
+    {"decode-binary", "bytes", BenchDecodeBinary, "messages"},
+    {"decode-noisy", "bytes", BenchDecodeNoisy, "messages"},
+    {"decode-legacy", "bytes", BenchDecodeLegacy, "messages"},
+    {"agent-init", "inits", BenchAgentInit},
+    {"journal", "events", BenchJournal},
+};
+
+int main(int argc, char *argv[])
+{
+    uint32_t iterations = BENCH_DEFAULT_ITERATIONS;
+    const char *only = NULL;
+    size_t b;
+    if (argc > 1) {
+        iterations = strtoul(argv[1], NULL, 0);
+    }
+    if (argc > 2) {
+        only = argv[2];
+    }
+    srand(1);
+    printf("sizeof(Field) = %u bytes\n", (unsigned) sizeof(Field));
+    for (b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); b++) {
+        struct timespec start, end;
+        uint64_t ops;
+        double seconds;
+        if (only && strcmp(only, benchmarks[b].name) != 0) {
+            continue;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ops = benchmarks[b].run(iterations);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("%-16s %12llu %-10s %8.3f s %14.0f %s/s", benchmarks[b].name,
+                (unsigned long long) ops, benchmarks[b].unit, seconds, ops / seconds,
+                benchmarks[b].unit);
+        if (benchmarks[b].also) {
+            printf(" %14.0f %s/s", benchAlso / seconds, benchmarks[b].also);
+        }
+        printf("\n");
+    }
+    return 0;
+}
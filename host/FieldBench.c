@@ -0,0 +1,197 @@
+/*
+ * FieldBench measures how much memory a Field takes and how fast its cells can be read and written
+ * with the layout and board size it was compiled for. The Makefile builds it once per layout
+ * (array, FIELD_BITBOARD, FIELD_PACKED) and size under build/field/, so that the layouts can be
+ * compared as the board grows. Every benchmark works over a set of FIELD_BENCH_FIELDS fields, so
+ * that the fields that fit in the cache are also part of what is measured.
+ *
+ * Usage: FieldBench [iterations] [benchmark name]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "BOARD.h"
+#include "Field.h"
+#include "Protocol.h"
+
+#define BENCH_DEFAULT_ITERATIONS 20000000
+
+// How many fields every benchmark spreads its work over.
+#define FIELD_BENCH_FIELDS 1024
+
+#define FIELD_BENCH_CELLS (FIELD_ROWS * FIELD_COLS)
+
+#if defined(FIELD_BITBOARD)
+#define FIELD_BENCH_LAYOUT "bitboard"
+#elif defined(FIELD_PACKED)
+#define FIELD_BENCH_LAYOUT "packed"
+#else
+#define FIELD_BENCH_LAYOUT "array"
+#endif
+
+typedef struct {
+    const char *name;
+    const char *unit;
+    uint64_t (*run)(uint32_t iterations);
+} Benchmark;
+
+static Field fields[FIELD_BENCH_FIELDS];
+
+// Keeps the compiler from dropping reads whose results are otherwise unused.
+static volatile uint32_t benchSink;
+
+static uint32_t benchSeed = 0x12345678;
+
+// A small xorshift generator so that the benchmarks don't measure rand() and are repeatable.
+static uint32_t BenchRandom(void)
+{
+    benchSeed ^= benchSeed << 13;
+    benchSeed ^= benchSeed >> 17;
+    benchSeed ^= benchSeed << 5;
+    return benchSeed;
+}
+
+/**
+ * Gives every field a fleet and a scattering of misses, so that reads see a realistic mix of values.
+ */
+static void BenchFillFields(void)
+{
+    int n, k;
+    for (n = 0; n < FIELD_BENCH_FIELDS; n++) {
+        BoatType type;
+        FieldInit(&fields[n], FIELD_POSITION_EMPTY);
+        for (type = 0; type < FIELD_NUM_BOATS; type++) {
+            while (FieldAddBoat(&fields[n], BenchRandom() % FIELD_ROWS, BenchRandom() % FIELD_COLS,
+                    BenchRandom() % 4, type) == FALSE);
+        }
+        for (k = 0; k < FIELD_BENCH_CELLS / 8; k++) {
+            uint8_t row = BenchRandom() % FIELD_ROWS, col = BenchRandom() % FIELD_COLS;
+            if (FieldAt(&fields[n], row, col) == FIELD_POSITION_EMPTY) {
+                FieldSetLocation(&fields[n], row, col, FIELD_POSITION_MISS);
+            }
+        }
+    }
+}
+
+/**
+ * Reads every cell of one field after another, the way the renderer and the targeting code do.
+ */
+static uint64_t BenchAtScan(uint32_t iterations)
+{
+    uint64_t reads = 0;
+    uint32_t sum = 0;
+    int n = 0;
+    uint8_t row, col;
+    while (reads < iterations) {
+        for (row = 0; row < FIELD_ROWS; row++) {
+            for (col = 0; col < FIELD_COLS; col++) {
+                sum += FieldAt(&fields[n], row, col);
+            }
+        }
+        reads += FIELD_BENCH_CELLS;
+        n = (n + 1) % FIELD_BENCH_FIELDS;
+    }
+    benchSink = sum;
+    return reads;
+}
+
+/**
+ * Reads single cells of random fields, the way incoming shots do.
+ */
+static uint64_t BenchAtRandom(uint32_t iterations)
+{
+    uint32_t n, sum = 0;
+    for (n = 0; n < iterations; n++) {
+        uint32_t r = BenchRandom();
+        sum += FieldAt(&fields[r % FIELD_BENCH_FIELDS], (r >> 10) % FIELD_ROWS,
+                (r >> 18) % FIELD_COLS);
+    }
+    benchSink = sum;
+    return iterations;
+}
+
+/**
+ * Writes single cells of random fields.
+ */
+static uint64_t BenchSet(uint32_t iterations)
+{
+    uint32_t n;
+    for (n = 0; n < iterations; n++) {
+        uint32_t r = BenchRandom();
+        Field *f = &fields[r % FIELD_BENCH_FIELDS];
+        uint8_t row = (r >> 10) % FIELD_ROWS, col = (r >> 18) % FIELD_COLS;
+        FieldSetLocation(f, row, col, FieldAt(f, row, col));
+    }
+    return iterations;
+}
+
+/**
+ * Registers attacks on random cells of random fields.
+ */
+static uint64_t BenchAttack(uint32_t iterations)
+{
+    uint32_t n;
+    for (n = 0; n < iterations; n++) {
+        uint32_t r = BenchRandom();
+        GuessData g = {(r >> 10) % FIELD_ROWS, (r >> 18) % FIELD_COLS, HIT_MISS};
+        FieldRegisterEnemyAttack(&fields[r % FIELD_BENCH_FIELDS], &g);
+    }
+    return iterations;
+}
+
+/**
+ * Counts the empty cells of one field after another.
+ */
+static uint64_t BenchCount(uint32_t iterations)
+{
+    uint32_t n, sum = 0;
+    for (n = 0; n < iterations; n++) {
+        sum += FieldCountPositions(&fields[n % FIELD_BENCH_FIELDS], FIELD_POSITION_EMPTY);
+    }
+    benchSink = sum;
+    return iterations;
+}
+
+static const Benchmark benchmarks[] = {
+    {"at-scan", "cells", BenchAtScan},
+    {"at-random", "cells", BenchAtRandom},
+    {"set", "cells", BenchSet},
+    {"attack", "attacks", BenchAttack},
+    {"count", "counts", BenchCount},
+};
+
+int main(int argc, char *argv[])
+{
+    uint32_t iterations = BENCH_DEFAULT_ITERATIONS;
+    const char *only = NULL;
+    size_t b;
+    if (argc > 1) {
+        iterations = strtoul(argv[1], NULL, 0);
+    }
+    if (argc > 2) {
+        only = argv[2];
+    }
+    printf("%s %dx%d: sizeof(Field) = %u bytes, %u fields in %u KB\n", FIELD_BENCH_LAYOUT,
+            FIELD_ROWS, FIELD_COLS, (unsigned) sizeof(Field), FIELD_BENCH_FIELDS,
+            (unsigned) (sizeof(fields) / 1024));
+    for (b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); b++) {
+        struct timespec start, end;
+        uint64_t ops;
+        double seconds;
+        if (only && strcmp(only, benchmarks[b].name) != 0) {
+            continue;
+        }
+        BenchFillFields();
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ops = benchmarks[b].run(iterations);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        printf("%-16s %12llu %-10s %8.3f s %14.0f %s/s\n", benchmarks[b].name,
+                (unsigned long long) ops, benchmarks[b].unit, seconds, ops / seconds,
+                benchmarks[b].unit);
+    }
+    return 0;
+}
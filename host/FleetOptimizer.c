@@ -0,0 +1,530 @@
+/*
+ * FleetOptimizer searches for fleet layouts that take the targeting policies as many shots as
+ * possible to sink, and writes the best of them out as the layout table used by
+ * PlacementFromTable(). Each layout is scored by letting simulated opponents fire at it until the
+ * whole fleet is sunk, and improved by simulated annealing: a boat is moved by one cell, turned, or
+ * put somewhere else at random, and the move is kept if the score got better, or with a chance that
+ * shrinks as the temperature falls if it got worse.
+ *
+ * Usage: FleetOptimizer [-n layouts] [-k keep] [-i iterations] [-g games] [-e games] [-t threads]
+ *                       [-s seed] [-m models] > ../PlacementTable.c
+ *
+ * -n independent annealing runs are spread over -t threads, each producing one layout. Every score
+ * during a run comes from -g games against each opponent model in -m, a comma separated list of
+ * FleetModels below. All layouts in a run are scored on the same games so that their scores can be
+ * compared closely, and the games are drawn afresh every FLEET_EPOCH iterations so that the run
+ * can't settle on a layout that only does well on one particular set of games. At the end every
+ * run's layout is scored again on -e fresh games per model, and the best -k are written out.
+ *
+ * The random opponent is left out of the search by default: the order it fires in doesn't depend on
+ * what it hits, so every layout takes it the same number of shots on the same games. It is still
+ * part of the before/after comparison printed at the end, against fleets placed by PlacementFleet().
+ */
+
+#include <pthread.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "BOARD.h"
+#include "Field.h"
+#include "HuntTarget.h"
+#include "Parity.h"
+#include "Placement.h"
+#include "Protocol.h"
+#include "Targeting.h"
+
+#define FLEET_DEFAULT_LAYOUTS 32
+#define FLEET_DEFAULT_KEEP 16
+#define FLEET_DEFAULT_ITERATIONS 2000
+#define FLEET_DEFAULT_GAMES 24
+#define FLEET_DEFAULT_CHECK_GAMES 4000
+#define FLEET_MAX_LAYOUTS 1024
+#define FLEET_MAX_THREADS 256
+
+// How many iterations share one set of games.
+#define FLEET_EPOCH 250
+
+// The temperature falls geometrically from the first to the second over a run, in shots.
+#define FLEET_TEMPERATURE_START 1.5
+#define FLEET_TEMPERATURE_END 0.05
+
+// Spells out a macro's value, for naming the fleet the table was generated for.
+#define FLEET_STRING(...) FLEET_STRING_(__VA_ARGS__)
+#define FLEET_STRING_(...) #__VA_ARGS__
+
+typedef enum {
+    FLEET_MODEL_DENSITY,
+    FLEET_MODEL_PARITY,
+    FLEET_MODEL_RANDOM,
+    FLEET_MODEL_COUNT
+} FleetModel;
+
+typedef struct {
+    const char *name;
+    FleetModel model;
+} ModelName;
+
+// The opponents, each targeting like the agent policy of the same name.
+static const ModelName FleetModels[] = {
+    {"density", FLEET_MODEL_DENSITY},
+    {"parity", FLEET_MODEL_PARITY},
+    {"random", FLEET_MODEL_RANDOM},
+};
+
+/**
+ * A fleet layout, in the format of the entries of placementTable.
+ */
+typedef struct {
+    uint8_t boats[FIELD_NUM_BOATS];
+} Layout;
+
+typedef struct {
+    Layout layout;
+    double score; // Mean shots to sink it over the final check.
+} Result;
+
+static uint32_t fleetSeed = 1;
+static int iterations = FLEET_DEFAULT_ITERATIONS;
+static int games = FLEET_DEFAULT_GAMES;
+static int checkGames = FLEET_DEFAULT_CHECK_GAMES;
+static uint8_t useModel[FLEET_MODEL_COUNT] = {TRUE, TRUE, FALSE};
+
+static Result results[FLEET_MAX_LAYOUTS];
+static int layoutCount = FLEET_DEFAULT_LAYOUTS;
+static int nextLayout;
+static pthread_mutex_t nextLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Derives an independent seed from the optimizer seed and two indices, so that every run and
+ * every game is the same whichever thread does it.
+ */
+static uint32_t FleetSeed(uint64_t a, uint64_t b)
+{
+    uint64_t z = ((uint64_t) fleetSeed << 32) + a * 0x100000001ULL + b + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return (uint32_t) (z ^ (z >> 31));
+}
+
+static uint32_t FleetRandom(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ * Lays `layout` out on a fresh field.
+ * @return TRUE if every boat fit, FALSE if some boats overlap or stick out.
+ */
+static int LayoutToField(const Layout *layout, Field *f)
+{
+    int type;
+    FieldInit(f, FIELD_POSITION_EMPTY);
+    for (type = 0; type < FIELD_NUM_BOATS; type++) {
+        uint8_t cell = layout->boats[type] & PLACEMENT_TABLE_CELL;
+        if (!FieldAddBoat(f, cell / FIELD_COLS, cell % FIELD_COLS,
+                (layout->boats[type] & PLACEMENT_TABLE_VERTICAL) ?
+                FIELD_BOAT_DIRECTION_SOUTH : FIELD_BOAT_DIRECTION_EAST, type)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * Marks the cells of every boat in `layout` except `skip` as taken in `free`.
+ */
+static void LayoutFree(const Layout *layout, int skip, uint32_t free[FIELD_ROWS])
+{
+    int type, k;
+    for (k = 0; k < FIELD_ROWS; k++) {
+        free[k] = (uint32_t) -1 >> (32 - FIELD_COLS);
+    }
+    for (type = 0; type < FIELD_NUM_BOATS; type++) {
+        uint8_t cell = layout->boats[type] & PLACEMENT_TABLE_CELL;
+        if (type == skip) {
+            continue;
+        }
+        for (k = 0; k < fieldBoatLengths[type]; k++) {
+            if (layout->boats[type] & PLACEMENT_TABLE_VERTICAL) {
+                free[cell / FIELD_COLS + k] &= ~((uint32_t) 1 << (cell % FIELD_COLS));
+            } else {
+                free[cell / FIELD_COLS] &= ~((uint32_t) 1 << (cell % FIELD_COLS + k));
+            }
+        }
+    }
+}
+
+/**
+ * Checks whether a boat of `length` fits in `free` starting at (`row`, `col`).
+ */
+static int LayoutFits(const uint32_t free[FIELD_ROWS], int length, int row, int col, int vertical)
+{
+    int k;
+    if (row < 0 || col < 0) {
+        return FALSE;
+    }
+    if (vertical ? row + length > FIELD_ROWS || col >= FIELD_COLS :
+            col + length > FIELD_COLS || row >= FIELD_ROWS) {
+        return FALSE;
+    }
+    for (k = 0; k < length; k++) {
+        int r = vertical ? row + k : row, c = vertical ? col : col + k;
+        if (!(free[r] & ((uint32_t) 1 << c))) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * Moves one boat of `layout`: one cell in some direction, turned about its top or left end, or,
+ * when neither fits or one time in four anyway, to a random spot where it fits.
+ */
+static void LayoutMutate(Layout *layout, uint32_t *random)
+{
+    static const int8_t moves[5][3] = {{-1, 0, 0}, {1, 0, 0}, {0, -1, 0}, {0, 1, 0}, {0, 0, 1}};
+    uint32_t free[FIELD_ROWS];
+    int type = FleetRandom(random) % FIELD_NUM_BOATS;
+    int length = fieldBoatLengths[type];
+    uint8_t cell = layout->boats[type] & PLACEMENT_TABLE_CELL;
+    int vertical = (layout->boats[type] & PLACEMENT_TABLE_VERTICAL) != 0;
+    uint8_t row, col, turned;
+
+    LayoutFree(layout, type, free);
+    if (FleetRandom(random) % 4 != 0) {
+        const int8_t *m = moves[FleetRandom(random) % 5];
+        int r = cell / FIELD_COLS + m[0], c = cell % FIELD_COLS + m[1];
+        if (LayoutFits(free, length, r, c, vertical ^ m[2])) {
+            layout->boats[type] = (r * FIELD_COLS + c) |
+                    ((vertical ^ m[2]) ? PLACEMENT_TABLE_VERTICAL : 0);
+            return;
+        }
+    }
+    //the boat's own spot is always free, so this can't fail
+    PlacementChoose(free, length, FleetRandom(random), &row, &col, &turned);
+    layout->boats[type] = (row * FIELD_COLS + col) | (turned ? PLACEMENT_TABLE_VERTICAL : 0);
+}
+
+/**
+ * Draws a fresh layout the way PlacementFleet() does.
+ */
+static void LayoutRandom(Layout *layout, uint32_t seed)
+{
+    Field f;
+    int type, row, col;
+    PlacementFleet(&f, seed);
+    //find each boat's top or left end again, it's the cell with no cell of that boat above or left
+    for (row = 0; row < FIELD_ROWS; row++) {
+        for (col = 0; col < FIELD_COLS; col++) {
+            FieldPosition p = FieldAt(&f, row, col);
+            if (p == FIELD_POSITION_EMPTY || (row > 0 && FieldAt(&f, row - 1, col) == p) ||
+                    (col > 0 && FieldAt(&f, row, col - 1) == p)) {
+                continue;
+            }
+            type = p - FIELD_POSITION_SMALL_BOAT;
+            layout->boats[type] = row * FIELD_COLS + col;
+            if (row + 1 < FIELD_ROWS && FieldAt(&f, row + 1, col) == p) {
+                layout->boats[type] |= PLACEMENT_TABLE_VERTICAL;
+            }
+        }
+    }
+}
+
+/**
+ * Plays one game of an opponent firing at `fleet` until all of it is sunk, choosing its shots the
+ * same way the agent does with the matching policy.
+ * @return How many shots it took.
+ */
+static int FleetShotsToSink(const Field *fleet, FleetModel model, uint32_t seed)
+{
+    Field mine = *fleet, knowledge;
+    TargetingState targeting;
+    HuntTargetState hunt;
+    ParityState parity;
+    GuessData guess;
+    uint32_t random = seed ? seed : 1;
+    int shots = 0;
+
+    FieldInit(&knowledge, FIELD_POSITION_UNKNOWN);
+    TargetingInit(&targeting);
+    HuntTargetInit(&hunt);
+    ParityInit(&parity, FleetRandom(&random));
+    while (FieldGetBoatStates(&mine) != 0) {
+        switch (model) {
+        case FLEET_MODEL_DENSITY:
+            TargetingChoose(&targeting, &knowledge, FleetRandom(&random), &guess);
+            break;
+        case FLEET_MODEL_PARITY:
+            if (!HuntTargetChooseTarget(&hunt, &targeting, FleetRandom(&random), &guess)) {
+                ParityChoose(&parity, FieldGetBoatStates(&knowledge), FleetRandom(&random),
+                        &guess);
+            }
+            break;
+        default:
+            ParityChooseAny(&parity, FleetRandom(&random), &guess);
+            break;
+        }
+        FieldRegisterEnemyAttack(&mine, &guess);
+        FieldUpdateKnowledge(&knowledge, &guess);
+        TargetingUpdate(&targeting, &guess);
+        HuntTargetUpdate(&hunt, &guess);
+        ParityRemove(&parity, &guess);
+        shots++;
+    }
+    return shots;
+}
+
+/**
+ * Scores a layout as the mean shots to sink it over `count` games against each model in use,
+ * playing games `first` to `first + count - 1`.
+ */
+static double LayoutScore(const Layout *layout, uint64_t first, int count)
+{
+    Field fleet;
+    uint64_t shots = 0;
+    int model, n, used = 0;
+    LayoutToField(layout, &fleet);
+    for (model = 0; model < FLEET_MODEL_COUNT; model++) {
+        if (!useModel[model]) {
+            continue;
+        }
+        used++;
+        for (n = 0; n < count; n++) {
+            shots += FleetShotsToSink(&fleet, model, FleetSeed(first + n, model));
+        }
+    }
+    return (double) shots / ((uint64_t) used * count);
+}
+
+/**
+ * Anneals one layout from a random start.
+ * @param index The index of the run, which determines everything about it.
+ * @param result Receives the best layout found and its score on the final check.
+ */
+static void FleetAnneal(int index, Result *result)
+{
+    Layout current, candidate, best;
+    double currentScore, candidateScore, bestScore;
+    double cooling = pow(FLEET_TEMPERATURE_END / FLEET_TEMPERATURE_START, 1.0 / iterations);
+    double temperature = FLEET_TEMPERATURE_START;
+    uint32_t random = FleetSeed(index, 0xA11EA1);
+    //each run and each epoch plays its own range of games, well clear of the final check's
+    uint64_t epochGames = ((uint64_t) index + 1) << 32;
+    int i;
+
+    LayoutRandom(&current, FleetRandom(&random));
+    currentScore = LayoutScore(&current, epochGames, games);
+    best = current;
+    bestScore = currentScore;
+    for (i = 1; i <= iterations; i++) {
+        if (i % FLEET_EPOCH == 0) {
+            //new games, so the scores kept so far no longer compare
+            epochGames += games;
+            currentScore = LayoutScore(&current, epochGames, games);
+            bestScore = LayoutScore(&best, epochGames, games);
+        }
+        candidate = current;
+        LayoutMutate(&candidate, &random);
+        candidateScore = LayoutScore(&candidate, epochGames, games);
+        if (candidateScore >= currentScore ||
+                FleetRandom(&random) < exp((candidateScore - currentScore) / temperature) *
+                4294967295.0) {
+            current = candidate;
+            currentScore = candidateScore;
+            if (currentScore > bestScore) {
+                best = current;
+                bestScore = currentScore;
+            }
+        }
+        temperature *= cooling;
+    }
+    result->layout = best;
+    result->score = LayoutScore(&best, 0, checkGames);
+}
+
+static void *FleetWorker(void *arg)
+{
+    int index;
+    (void) arg;
+    while (TRUE) {
+        pthread_mutex_lock(&nextLock);
+        index = nextLayout++;
+        pthread_mutex_unlock(&nextLock);
+        if (index >= layoutCount) {
+            return NULL;
+        }
+        FleetAnneal(index, &results[index]);
+        fprintf(stderr, "layout %3d: %.2f shots\n", index, results[index].score);
+    }
+}
+
+static int FleetCompareResults(const void *a, const void *b)
+{
+    double d = ((const Result *) b)->score - ((const Result *) a)->score;
+    return (d > 0) - (d < 0);
+}
+
+/**
+ * Parses the comma separated model list given with -m.
+ * @return TRUE if every name was known.
+ */
+static int FleetParseModels(char *list)
+{
+    char *name;
+    size_t i;
+    memset(useModel, FALSE, sizeof(useModel));
+    for (name = strtok(list, ","); name != NULL; name = strtok(NULL, ",")) {
+        for (i = 0; i < sizeof(FleetModels) / sizeof(FleetModels[0]); i++) {
+            if (strcmp(name, FleetModels[i].name) == 0) {
+                useModel[FleetModels[i].model] = TRUE;
+                break;
+            }
+        }
+        if (i == sizeof(FleetModels) / sizeof(FleetModels[0])) {
+            fprintf(stderr, "unknown model '%s'\n", name);
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/**
+ * Prints the mean shots each model needs against fleets placed by PlacementFleet() and against the
+ * kept layouts, on games none of the layouts were chosen with.
+ */
+static void FleetReport(int keep)
+{
+    Field fleet;
+    size_t m;
+    int n;
+    fprintf(stderr, "mean shots to sink over %d games   uniform    table\n", checkGames);
+    for (m = 0; m < sizeof(FleetModels) / sizeof(FleetModels[0]); m++) {
+        uint64_t uniform = 0, table = 0;
+        for (n = 0; n < checkGames; n++) {
+            uint32_t seed = FleetSeed(n, 0xB0A7 + m);
+            PlacementFleet(&fleet, FleetSeed(n, 0xF1EE7));
+            uniform += FleetShotsToSink(&fleet, FleetModels[m].model, seed);
+            LayoutToField(&results[n % keep].layout, &fleet);
+            table += FleetShotsToSink(&fleet, FleetModels[m].model, seed);
+        }
+        fprintf(stderr, "  %-34s %7.2f  %7.2f\n", FleetModels[m].name,
+                (double) uniform / checkGames, (double) table / checkGames);
+    }
+}
+
+/**
+ * Writes the kept layouts out as PlacementTable.c.
+ */
+static void FleetWriteTable(int keep, int argc, char *argv[])
+{
+    int i, type;
+    printf("/*\n * Fleet layouts for PlacementFromTable(). Generated by host/FleetOptimizer, do not "
+            "edit.\n *\n *  ");
+    for (i = 0; i < argc; i++) {
+        printf(" %s", argv[i]);
+    }
+    printf("\n */\n#include \"Placement.h\"\n\n");
+#ifdef FIELD_FLEET
+    //the preprocessor can't compare the lengths, so a table for another fleet goes by its size
+    printf("#if FIELD_ROWS == %d && FIELD_COLS == %d && defined(FIELD_FLEET) && FIELD_NUM_BOATS == %d"
+            " // FIELD_FLEET=%s\n", FIELD_ROWS, FIELD_COLS, FIELD_NUM_BOATS, FLEET_STRING(FIELD_FLEET));
+#else
+    printf("#if FIELD_ROWS == %d && FIELD_COLS == %d && !defined(FIELD_FLEET)\n", FIELD_ROWS,
+            FIELD_COLS);
+#endif
+    printf("const uint8_t placementTable[][FIELD_NUM_BOATS] = {\n");
+    for (i = 0; i < keep; i++) {
+        printf("    {");
+        for (type = 0; type < FIELD_NUM_BOATS; type++) {
+            printf("0x%02X%s", results[i].layout.boats[type], type < FIELD_NUM_BOATS - 1 ? ", " : "");
+        }
+        printf("}, // %.2f shots\n", results[i].score);
+    }
+    printf("};\nconst uint16_t placementTableLength = sizeof(placementTable) / "
+            "sizeof(placementTable[0]);\n");
+    printf("#else\nconst uint8_t placementTable[1][FIELD_NUM_BOATS];\n"
+            "const uint16_t placementTableLength = 0;\n#endif\n");
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[FLEET_MAX_THREADS];
+    int threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+    int keep = FLEET_DEFAULT_KEEP;
+    struct timespec start, end;
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "n:k:i:g:e:t:s:m:")) != -1) {
+        switch (opt) {
+        case 'n':
+            layoutCount = atoi(optarg);
+            break;
+        case 'k':
+            keep = atoi(optarg);
+            break;
+        case 'i':
+            iterations = atoi(optarg);
+            break;
+        case 'g':
+            games = atoi(optarg);
+            break;
+        case 'e':
+            checkGames = atoi(optarg);
+            break;
+        case 't':
+            threadCount = atoi(optarg);
+            break;
+        case 's':
+            fleetSeed = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            if (!FleetParseModels(optarg)) {
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n layouts] [-k keep] [-i iterations] [-g games] "
+                    "[-e games] [-t threads] [-s seed] [-m models]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (layoutCount < 1 || layoutCount > FLEET_MAX_LAYOUTS || iterations < 1 || games < 1 ||
+            checkGames < 1) {
+        fprintf(stderr, "layouts must be 1 to %d, iterations and games at least 1\n",
+                FLEET_MAX_LAYOUTS);
+        return 1;
+    }
+    if (keep < 1 || keep > layoutCount) {
+        keep = layoutCount;
+    }
+    if (threadCount < 1) {
+        threadCount = 1;
+    } else if (threadCount > FLEET_MAX_THREADS) {
+        threadCount = FLEET_MAX_THREADS;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < threadCount; i++) {
+        pthread_create(&threads[i], NULL, FleetWorker, NULL);
+    }
+    for (i = 0; i < threadCount; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(stderr, "annealed %d layouts on %d threads in %.1f s\n", layoutCount, threadCount,
+            (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    qsort(results, layoutCount, sizeof(results[0]), FleetCompareResults);
+    FleetReport(keep);
+    FleetWriteTable(keep, argc, argv);
+    return 0;
+}
@@ -0,0 +1,13 @@
+#ifndef GENERIC_TYPE_DEFS_H
+#define GENERIC_TYPE_DEFS_H
+
+/**
+ * Host stand-in for Microchip's GenericTypeDefs.h. The game sources only rely on the BOOL
+ * constants from it.
+ */
+typedef enum {
+    FALSE = 0,
+    TRUE
+} BOOL;
+
+#endif // GENERIC_TYPE_DEFS_H
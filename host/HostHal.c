@@ -0,0 +1,241 @@
+/*
+ * Host implementation of the board support interfaces used by the game engine. See HostHal.h.
+ */
+
+#include <string.h>
+
+#include "BOARD.h"
+#include "Buttons.h"
+#include "FieldOled.h"
+#include "Oled.h"
+#include "OledDriver.h"
+#include "Uart1.h"
+#include "HostHal.h"
+
+// Mirror the clock configuration from BOARD.c so that timing math gives the same answers.
+#define SYSTEM_CLOCK 80000000L
+#define PB_CLOCK (SYSTEM_CLOCK / 4)
+
+// Match the size of the UART queues used by the Uart1 library.
+#define HOST_UART1_QUEUE_SIZE 1024
+
+typedef struct {
+    uint16_t readIndex;
+    uint16_t dataSize;
+    uint8_t data[HOST_UART1_QUEUE_SIZE];
+} HostQueue;
+
+volatile uint32_t TRISE, LATE;
+volatile uint32_t TRISD, PORTD;
+volatile uint32_t TRISF, PORTF, LATF;
+
+uint8_t rgbOledBmp[OLED_DRIVER_BUFFER_SIZE];
+
+static HostQueue uart1Rx, uart1Tx;
+static uint32_t uart1RxOverflows;
+
+static size_t HostQueueWrite(HostQueue *q, const uint8_t *data, size_t length);
+static size_t HostQueueRead(HostQueue *q, uint8_t *data, size_t length);
+
+/*******************************************************************************
+ * BOARD                                                                       *
+ ******************************************************************************/
+
+void BOARD_Init()
+{
+}
+
+void BOARD_End()
+{
+}
+
+unsigned int BOARD_GetPBClock()
+{
+    return PB_CLOCK;
+}
+
+unsigned int BOARD_GetSysClock()
+{
+    return SYSTEM_CLOCK;
+}
+
+/*******************************************************************************
+ * Buttons                                                                     *
+ ******************************************************************************/
+
+void ButtonsInit(void)
+{
+}
+
+uint8_t ButtonsCheckEvents(void)
+{
+    return BUTTON_EVENT_NONE;
+}
+
+/*******************************************************************************
+ * OLED                                                                        *
+ ******************************************************************************/
+
+void OledHostInit(void)
+{
+}
+
+void OledDriverInitDisplay(void)
+{
+}
+
+void OledDriverDisableDisplay(void)
+{
+}
+
+void OledDriverUpdateDisplay(void)
+{
+}
+
+void OledDriverSetDisplayInverted(void)
+{
+}
+
+void OledDriverSetDisplayNormal(void)
+{
+}
+
+void OledInit(void)
+{
+    OledClear(OLED_COLOR_BLACK);
+}
+
+void OledSetPixel(int x, int y, OledColor color)
+{
+    if (x < 0 || x >= OLED_DRIVER_PIXEL_COLUMNS || y < 0 || y >= OLED_DRIVER_PIXEL_ROWS) {
+        return;
+    }
+    uint8_t *column = &rgbOledBmp[(y / OLED_DRIVER_BUFFER_LINE_HEIGHT) * OLED_DRIVER_PIXEL_COLUMNS + x];
+    uint8_t mask = 1 << (y % OLED_DRIVER_BUFFER_LINE_HEIGHT);
+    if (color == OLED_COLOR_WHITE) {
+        *column |= mask;
+    } else {
+        *column &= ~mask;
+    }
+}
+
+int OledGetPixel(int x, int y)
+{
+    if (x < 0 || x >= OLED_DRIVER_PIXEL_COLUMNS || y < 0 || y >= OLED_DRIVER_PIXEL_ROWS) {
+        return OLED_COLOR_BLACK;
+    }
+    uint8_t column = rgbOledBmp[(y / OLED_DRIVER_BUFFER_LINE_HEIGHT) * OLED_DRIVER_PIXEL_COLUMNS + x];
+    return (column >> (y % OLED_DRIVER_BUFFER_LINE_HEIGHT)) & 1;
+}
+
+uint8_t OledDrawChar(int x, int y, char c)
+{
+    return TRUE;
+}
+
+void OledDrawString(const char *string)
+{
+}
+
+void OledClear(OledColor p)
+{
+    memset(rgbOledBmp, p == OLED_COLOR_WHITE ? 0xFF : 0x00, sizeof(rgbOledBmp));
+}
+
+void OledSetDisplayInverted(void)
+{
+}
+
+void OledSetDisplayNormal(void)
+{
+}
+
+void OledOn(void)
+{
+}
+
+void OledOff(void)
+{
+}
+
+void OledUpdate(void)
+{
+    OledDriverUpdateDisplay();
+}
+
+void FieldOledDrawScreen(const Field *myField, const Field *theirField, FieldOledTurn playerTurn)
+{
+}
+
+/*******************************************************************************
+ * UART1                                                                       *
+ ******************************************************************************/
+
+void Uart1Init(uint32_t brgRegister)
+{
+    memset(&uart1Rx, 0, sizeof(uart1Rx));
+    memset(&uart1Tx, 0, sizeof(uart1Tx));
+    uart1RxOverflows = 0;
+}
+
+void Uart1ChangeBaudRate(uint16_t brgRegister)
+{
+}
+
+uint8_t Uart1HasData(void)
+{
+    return uart1Rx.dataSize > 0;
+}
+
+int Uart1ReadByte(uint8_t *datum)
+{
+    return HostQueueRead(&uart1Rx, datum, 1) == 1;
+}
+
+void Uart1WriteByte(uint8_t datum)
+{
+    HostQueueWrite(&uart1Tx, &datum, 1);
+}
+
+int Uart1WriteData(const void *data, size_t length)
+{
+    return HostQueueWrite(&uart1Tx, data, length) == length ? SUCCESS : STANDARD_ERROR;
+}
+
+size_t HostUart1Receive(const void *data, size_t length)
+{
+    size_t written = HostQueueWrite(&uart1Rx, data, length);
+    uart1RxOverflows += length - written;
+    return written;
+}
+
+size_t HostUart1Transmitted(void *data, size_t length)
+{
+    return HostQueueRead(&uart1Tx, data, length);
+}
+
+uint32_t HostUart1RxOverflowCount(void)
+{
+    return uart1RxOverflows;
+}
+
+static size_t HostQueueWrite(HostQueue *q, const uint8_t *data, size_t length)
+{
+    size_t i;
+    for (i = 0; i < length && q->dataSize < HOST_UART1_QUEUE_SIZE; i++) {
+        q->data[(q->readIndex + q->dataSize) % HOST_UART1_QUEUE_SIZE] = data[i];
+        q->dataSize++;
+    }
+    return i;
+}
+
+static size_t HostQueueRead(HostQueue *q, uint8_t *data, size_t length)
+{
+    size_t i;
+    for (i = 0; i < length && q->dataSize > 0; i++) {
+        data[i] = q->data[q->readIndex];
+        q->readIndex = (q->readIndex + 1) % HOST_UART1_QUEUE_SIZE;
+        q->dataSize--;
+    }
+    return i;
+}
@@ -0,0 +1,38 @@
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+
+/**
+ * The host hardware abstraction shim lets Field.c, Protocol.c and ArtificialAgent.c be compiled
+ * and run natively on Linux. It provides do-nothing implementations of the OLED, FieldOled, LED and
+ * button interfaces, a fixed clock for BOARD_GetPBClock(), and a UART1 whose RX and TX sides are
+ * plain in-memory queues. The functions below are only available on the host and are how a
+ * simulator or benchmark feeds bytes in and reads the agent's output back out.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Pushes bytes into the UART1 receive queue, as if they had arrived on the wire. Bytes that do not
+ * fit are dropped and counted, just like an RX overflow on the real hardware.
+ * @param data The bytes to enqueue.
+ * @param length The number of bytes in `data`.
+ * @return The number of bytes actually enqueued.
+ */
+size_t HostUart1Receive(const void *data, size_t length);
+
+/**
+ * Pulls bytes out of the UART1 transmit queue, i.e. everything written via Uart1WriteData() and
+ * Uart1WriteByte() that has not been collected yet.
+ * @param data Where to store the transmitted bytes.
+ * @param length The size of `data`.
+ * @return The number of bytes copied into `data`.
+ */
+size_t HostUart1Transmitted(void *data, size_t length);
+
+/**
+ * Returns how many received bytes have been dropped because the RX queue was full.
+ */
+uint32_t HostUart1RxOverflowCount(void);
+
+#endif // HOST_HAL_H
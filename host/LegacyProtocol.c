@@ -0,0 +1,202 @@
+/*
+ * The byte-at-a-time decoder as it was before the single-pass rewrite of ProtocolDecode(), kept on
+ * the host only so that EngineBench can compare the two. The stdout echo of each message ID is
+ * left out so that only the parsing itself is measured.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "BOARD.h"
+#include "Protocol.h"
+#include "LegacyProtocol.h"
+
+typedef enum {
+    WAITING,
+    RECORDING,
+    FIRST_CHECKSUM_HALF,
+    SECOND_CHECKSUM_HALF,
+    NEWLINE
+} ProtocolStates;
+
+typedef struct {
+    int index;
+    uint8_t hash;
+    char Sentence[PROTOCOL_MAX_PAYLOAD_LEN];
+} protocolStruct;
+static protocolStruct pData;
+static ProtocolStates states = WAITING;
+static int wordCount;
+static unsigned int intTemp1, intTemp2, intTemp3;
+static int clear;
+
+static ProtocolParserStatus MSGID(char *input);
+static uint8_t Checksum(char *inStr, int wordCount);
+static uint8_t AsciiToHex(char input);
+static int CheckHex(char input);
+
+void LegacyProtocolReset(void) {
+    states = WAITING;
+    pData.index = 0;
+}
+
+ProtocolParserStatus LegacyProtocolDecode(char in, NegotiationData *nData, GuessData *gData) {
+
+    switch (states) {
+        case (WAITING):
+            if (in != '$') { //dont do anything without start char '$'
+                states = WAITING;
+                return PROTOCOL_WAITING;
+            } else if (in == '$') {
+                for (clear = 0; clear < pData.index; clear++) {
+                    pData.Sentence[clear] = '\0';
+                }
+                pData.index = 0; //start index at 0
+                states = RECORDING; //move to recording
+                return PROTOCOL_PARSING_GOOD;
+            }
+            break;
+        case (RECORDING):
+            if (in != '*') { //keep in recording until hit char '*'
+                pData.Sentence[pData.index] = in;
+                //add each char to decode sentence
+                pData.index += 1; //increments index
+                states = RECORDING;
+                return PROTOCOL_PARSING_GOOD;
+            } else if (in == '*') {
+                states = FIRST_CHECKSUM_HALF; //move onto checksum
+                return PROTOCOL_PARSING_GOOD;
+            }
+            break;
+        case (FIRST_CHECKSUM_HALF):
+            if (CheckHex(in) == SUCCESS) { //check for valid hex character
+                pData.hash = AsciiToHex(in) << 4; //shift to the top 4 bits
+                states = SECOND_CHECKSUM_HALF; //move to second half of checksum
+                return PROTOCOL_PARSING_GOOD;
+            } else return PROTOCOL_PARSING_FAILURE;
+            break;
+        case (SECOND_CHECKSUM_HALF):
+            if (states == SECOND_CHECKSUM_HALF) {
+                pData.hash = pData.hash^AsciiToHex(in);
+                //adds second half of checksum
+                wordCount = strlen(pData.Sentence);
+                if ((CheckHex(in) == SUCCESS) && (pData.hash ==
+                        (Checksum(pData.Sentence, wordCount)))) {
+                    //checks that checksum is valid hex and is correct
+                    //                    pData.Sentence[pData.index+1] = '\0';
+                    pData.hash = pData.hash & 0x00; //clears hash for reuse
+                    states = NEWLINE;
+                    return PROTOCOL_PARSING_GOOD;
+                } else return PROTOCOL_PARSING_FAILURE;
+            }
+            break;
+        case(NEWLINE):
+            if (in == '\n') { //end of the string with newline
+                states=WAITING;
+                if (MSGID(pData.Sentence) == PROTOCOL_PARSING_FAILURE) {
+                    //if parse fails if string from record isn't valid
+                    states = WAITING;
+                    return PROTOCOL_PARSING_FAILURE;
+                } else if (MSGID(pData.Sentence) == PROTOCOL_PARSED_DET_MESSAGE) {
+                    //if valid string (det,cha,coo,hit) create the decoded sentence
+                    sscanf(pData.Sentence, PAYLOAD_TEMPLATE_DET, &intTemp1, &intTemp2);
+                    nData->guess = intTemp1;
+                    nData->encryptionKey = intTemp2;
+                    return PROTOCOL_PARSED_DET_MESSAGE;
+                } else if (MSGID(pData.Sentence) == PROTOCOL_PARSED_CHA_MESSAGE) {
+                    sscanf(pData.Sentence, PAYLOAD_TEMPLATE_CHA, &intTemp1, &intTemp2);
+                    nData->encryptedGuess = intTemp1;
+                    nData->hash = intTemp2;
+                    return PROTOCOL_PARSED_CHA_MESSAGE;
+                } else if (MSGID(pData.Sentence) == PROTOCOL_PARSED_COO_MESSAGE) {
+                    sscanf(pData.Sentence, PAYLOAD_TEMPLATE_COO, &intTemp1, &intTemp2);
+                    gData->row = intTemp1;
+                    gData->col = intTemp2;
+                    return PROTOCOL_PARSED_COO_MESSAGE;
+                } else if (MSGID(pData.Sentence) == PROTOCOL_PARSED_HIT_MESSAGE) {
+                    sscanf(pData.Sentence, PAYLOAD_TEMPLATE_HIT, &intTemp1, &intTemp2, &intTemp3);
+                    gData->row = intTemp1;
+                    gData->col = intTemp2;
+                    gData->hit = intTemp3;
+                    return PROTOCOL_PARSED_HIT_MESSAGE;
+                }
+            } else { //fails if no newline char
+                states = WAITING;
+                return PROTOCOL_PARSING_FAILURE;
+            }
+            break;
+    }
+    return PROTOCOL_PARSING_FAILURE;
+}
+
+static ProtocolParserStatus MSGID(char *input) {
+    //this function checks what the recorded string is
+    int count1 = 0;
+    int count2 = 0;
+    int count3 = 0;
+    int count4 = 0;
+    char check1 = 'E';
+    char check2 = 'H';
+    char check3 = 'O';
+    char check4 = 'I';
+    if (check1 == input[1]) {
+        //checks the second char of the recorded sentence
+        count1++;
+    } else if (check2 == input[1]) {
+        count2++;
+    } else if (check3 == input[1]) {
+        count3++;
+    } else if (check4 == input[1]) {
+        count4++;
+    }
+    if (count1 == 1) {
+        //if matches pass respective parsed message
+        return PROTOCOL_PARSED_DET_MESSAGE;
+    } else if (count2 == 1) {
+        return PROTOCOL_PARSED_CHA_MESSAGE;
+    } else if (count3 == 1) {
+        return PROTOCOL_PARSED_COO_MESSAGE;
+    } else if (count4 == 1) {
+        return PROTOCOL_PARSED_HIT_MESSAGE;
+    } else return PROTOCOL_PARSING_FAILURE;
+}
+
+static uint8_t AsciiToHex(char input) {
+    //converts char to hex value
+    if (CheckHex(input) == SUCCESS) {
+        if (input == '0' || input == '1' || input == '2' || input == '3' ||
+                input == '4' || input == '5' || input == '6' || input == '7' ||
+                input == '8' || input == '9') {
+            return input - 48;
+        } else if (input == 'A' || input == 'B' || input == 'C' || input == 'D'
+                || input == 'E' || input == 'F') {
+            return input - 87;
+        } else if (input == 'a' || input == 'b' || input == 'c' || input == 'd'
+                || input == 'e' || input == 'f') {
+            return input - 87;
+        }
+    }
+    return STANDARD_ERROR;
+}
+
+static uint8_t Checksum(char *inStr, int wordCount) {
+    //xor's every recorded char to create checksum
+    uint8_t Check = 0;
+    int Index = 0;
+    while (Index < wordCount) {
+        Check ^= inStr[Index];
+        Index++;
+    }
+    return Check;
+}
+
+static int CheckHex(char input) {
+    //checks that input is a valid hex character
+    if (input == '0' || input == '1' || input == '2' || input == '3' ||
+            input == '4' || input == '5' || input == '6' || input == '7' ||
+            input == '8' || input == '9' || input == 'A' || input == 'B' ||
+            input == 'C' || input == 'D' || input == 'E' || input == 'F' ||
+            input == 'a' || input == 'b' || input == 'c' || input == 'd' ||
+            input == 'e' || input == 'f') {
+        return SUCCESS;
+    } else return STANDARD_ERROR;
+}
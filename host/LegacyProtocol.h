@@ -0,0 +1,16 @@
+#ifndef LEGACY_PROTOCOL_H
+#define LEGACY_PROTOCOL_H
+
+#include "Protocol.h"
+
+/**
+ * The previous implementation of ProtocolDecode(), for benchmarking only.
+ */
+ProtocolParserStatus LegacyProtocolDecode(char in, NegotiationData *nData, GuessData *gData);
+
+/**
+ * Puts the decoder back to waiting for a new message, as it can't always get there by itself.
+ */
+void LegacyProtocolReset(void);
+
+#endif // LEGACY_PROTOCOL_H
@@ -0,0 +1,683 @@
+/*
+ * ProtocolFuzz checks the message decoder against broken and hostile input. It first runs a corpus
+ * of valid and invalid messages through ProtocolParserDecode() and checks what each of them decodes
+ * to, then fuzzes the decoder: inputs are mutated from the corpus, and those that make the decoder
+ * take a path it hadn't taken before are kept to be mutated further. The decoders are compiled with
+ * -fsanitize-coverage=trace-pc for this, and everything with AddressSanitizer and
+ * UndefinedBehaviorSanitizer, so that any access out of bounds stops the run.
+ *
+ * Every input is fed to both ProtocolDecode() and a ProtocolParser of its own, which have to agree
+ * on every byte. Beyond that the decoder must:
+ *   * leave the memory on either side of its parser alone,
+ *   * only ever hand over what a message could have carried, so that encoding it and decoding it
+ *     again gives back the same values,
+ *   * decode a valid message whatever came before it.
+ *
+ * Usage: ProtocolFuzz [-n executions] [-s seed] [-l] [-v] [file...]
+ *
+ * Each file is added to the corpus as one more input, which is how a failure is reproduced: the
+ * input that failed is written to PROTOCOL_FUZZ_FAILURE_FILE. -l fuzzes the original decoder from
+ * LegacyProtocol.c instead, only checking that it stays within bounds. -v prints every input that
+ * finds new coverage. The exit status is 0 only if nothing failed.
+ */
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "BOARD.h"
+#include "LegacyProtocol.h"
+#include "Protocol.h"
+
+#define FUZZ_DEFAULT_EXECUTIONS 1000000
+
+// Where the input that failed is written.
+#define PROTOCOL_FUZZ_FAILURE_FILE "fuzz-failure.bin"
+
+// The longest input the fuzzer makes, several messages long.
+#define FUZZ_MAX_INPUT 256
+
+// The most inputs the corpus grows to.
+#define FUZZ_MAX_CORPUS 4096
+
+// The number of edge counters, which must be a power of two.
+#define FUZZ_MAP_SIZE 16384
+
+// What the memory on either side of the parser is filled with.
+#define FUZZ_CANARY 0xA5A5A5A5
+#define FUZZ_CANARY_WORDS 4
+
+/**
+ * An input of the corpus, and what it must decode to if it's one of the built-in cases:
+ *   * PROTOCOL_PARSED_*: The last message decoded from it, with its values. Others may come first.
+ *   * PROTOCOL_PARSING_FAILURE: Nothing, and at least one failure.
+ *   * PROTOCOL_PARSING_GOOD: Nothing, and no failure either, as the last message isn't finished.
+ *   * PROTOCOL_WAITING: Nothing at all, the decoder never leaves PROTOCOL_WAITING.
+ * The values are those FuzzValues() gives.
+ */
+typedef struct {
+    const char *bytes;
+    size_t length;
+    ProtocolParserStatus expect;
+    uint32_t values[PROTOCOL_MAX_FIELDS];
+} FuzzCase;
+
+#define FUZZ_CASE(s, expect, a, b, c) {s, sizeof(s) - 1, expect, {a, b, c}}
+
+static const FuzzCase cases[] = {
+    //every message, in each format it can be sent in
+    FUZZ_CASE("$COO,3,7*47\n", PROTOCOL_PARSED_COO_MESSAGE, 3, 7, 0),
+    FUZZ_CASE("$HIT,3,7,5*48\n", PROTOCOL_PARSED_HIT_MESSAGE, 3, 7, 5),
+    FUZZ_CASE("$CHA,43399,46*7c\n", PROTOCOL_PARSED_CHA_MESSAGE, 43399, 46, 0),
+    FUZZ_CASE("$DET,476739,489066*58\n", PROTOCOL_PARSED_DET_MESSAGE, 476739, 489066, 0),
+    FUZZ_CASE("$NAK,3*5b\n", PROTOCOL_PARSED_NAK_MESSAGE, 0, 0, 0),
+    FUZZ_CASE("$COO,3,7*ce94\n", PROTOCOL_PARSED_COO_MESSAGE, 3, 7, 0),
+    FUZZ_CASE("$HIT,3,7,5*2b3f\n", PROTOCOL_PARSED_HIT_MESSAGE, 3, 7, 5),
+    FUZZ_CASE("$COO,3,7*CE94\n", PROTOCOL_PARSED_COO_MESSAGE, 3, 7, 0),
+    FUZZ_CASE("\xa5\x80\xef\x85", PROTOCOL_PARSED_COO_MESSAGE, 3, 7, 0),
+    FUZZ_CASE("\xa5\xb4\xee\xec", PROTOCOL_PARSED_HIT_MESSAGE, 3, 7, 5),
+    FUZZ_CASE("\xa5\xcc\x80\xe8", PROTOCOL_PARSED_NAK_MESSAGE, 0, 0, 0),
+    //the edges of what's valid
+    FUZZ_CASE("$COO,0,0*43\n", PROTOCOL_PARSED_COO_MESSAGE, 0, 0, 0),
+    FUZZ_CASE("$COO,03,7*77\n", PROTOCOL_PARSED_COO_MESSAGE, 3, 7, 0),
+    FUZZ_CASE("$CHA,999999999,999999999*4a\n", PROTOCOL_PARSED_CHA_MESSAGE,
+            999999999, 999999999, 0),
+    FUZZ_CASE("$HIT,999999999,999999999,99999999*79\n", PROTOCOL_PARSED_HIT_MESSAGE,
+            999999999, 999999999, 99999999),
+    //a message cut short by the next one is dropped, and the next one decoded
+    FUZZ_CASE("$COO,1,2$COO,3,7*47\n", PROTOCOL_PARSED_COO_MESSAGE, 3, 7, 0),
+    FUZZ_CASE("$COO,1,2*\xa5\x80\xef\x85", PROTOCOL_PARSED_COO_MESSAGE, 3, 7, 0),
+    FUZZ_CASE("\xa5\x80$COO,3,7*47\n", PROTOCOL_PARSED_COO_MESSAGE, 3, 7, 0),
+    FUZZ_CASE("noise\r\n$COO,3,7*47\n", PROTOCOL_PARSED_COO_MESSAGE, 3, 7, 0),
+    //broken messages
+    FUZZ_CASE("$COO,3,7*48\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,3,7*ce95\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,3,7*4\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,3,7*047\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,3,7*ce944\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,3,7*4g\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,3,7*\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,3,7\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,3,7*4", PROTOCOL_PARSING_GOOD, 0, 0, 0),
+    FUZZ_CASE("$COO,3,7 *67\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,3*5c\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,3,7,1*5a\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,,7*74\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,3,*70\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$HIT,1,2,3,4*51\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$XYZ,3,7*5f\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COOO,3,7*08\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO*0c\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$*00\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,1000000000,1*73\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,4294967295,7*79\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$HIT,999999999,999999999,999999999*40\n", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COO,3,700000000000000000000000000000000000000000000000*47\n",
+            PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("$COOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOOO",
+            PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("\xa5\x80\xef\x86", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("\xa5\x80\x6f\x85", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    FUZZ_CASE("\xa5\xe0\x80\x80", PROTOCOL_PARSING_FAILURE, 0, 0, 0),
+    //nothing that starts a message
+    FUZZ_CASE("COO,3,7*47\n", PROTOCOL_WAITING, 0, 0, 0),
+    FUZZ_CASE("\x80\xef\x85\r\n\x00\xff", PROTOCOL_WAITING, 0, 0, 0),
+};
+#define FUZZ_NUM_CASES (sizeof(cases) / sizeof(cases[0]))
+
+/**
+ * A parser with memory on either side of it that the decoder has no business writing to.
+ */
+typedef struct {
+    uint32_t before[FUZZ_CANARY_WORDS];
+    ProtocolParser parser;
+    uint32_t after[FUZZ_CANARY_WORDS];
+} FuzzGuardedParser;
+
+typedef struct {
+    uint8_t data[FUZZ_MAX_INPUT];
+    size_t length;
+} FuzzInput;
+
+// Bytes that mean something to the decoder, which mutations favor.
+static const uint8_t fuzzTokens[] = "$*,\n0123456789abcdefABCDEF\xa5\x80\xff";
+
+static FuzzInput corpus[FUZZ_MAX_CORPUS];
+static int corpusSize;
+
+// How often each edge was taken by the current input, and which of the FuzzBucket()s of each have
+// been seen so far.
+static uint8_t edgeCounts[FUZZ_MAP_SIZE] __attribute__((aligned(8)));
+static uint8_t edgesSeen[FUZZ_MAP_SIZE];
+static uintptr_t lastPc;
+
+// The input being run, written out if a sanitizer stops the run.
+static const FuzzInput *current;
+
+static int fuzzLegacy;
+static uint32_t fuzzSeed = 0x12345678;
+
+void __sanitizer_cov_trace_pc(void);
+const char *__asan_default_options(void);
+const char *__ubsan_default_options(void);
+
+// Both sanitizers abort on the first error, so that FuzzSaveFailure() gets to run.
+const char *__asan_default_options(void)
+{
+    return "abort_on_error=1";
+}
+
+const char *__ubsan_default_options(void)
+{
+    return "abort_on_error=1:print_stacktrace=1";
+}
+
+/**
+ * Called on every basic block of the code compiled with -fsanitize-coverage=trace-pc. Counts the
+ * edge from the previous block to this one.
+ */
+void __sanitizer_cov_trace_pc(void)
+{
+    uintptr_t pc = (uintptr_t) __builtin_return_address(0);
+    uint8_t *count = &edgeCounts[(pc ^ lastPc) & (FUZZ_MAP_SIZE - 1)];
+    if (*count < UINT8_MAX) {
+        (*count)++;
+    }
+    lastPc = pc >> 1;
+}
+
+// The same xorshift generator as EngineBench, so that a run can be repeated from its seed.
+static uint32_t FuzzRandom(void)
+{
+    fuzzSeed ^= fuzzSeed << 13;
+    fuzzSeed ^= fuzzSeed >> 17;
+    fuzzSeed ^= fuzzSeed << 5;
+    return fuzzSeed;
+}
+
+/**
+ * Writes the input that failed to PROTOCOL_FUZZ_FAILURE_FILE. It's also the handler for the
+ * SIGABRT a sanitizer stops the run with, so it sticks to calls that are safe in one.
+ */
+static void FuzzSaveFailure(int sig)
+{
+    int fd;
+    if (!current) {
+        return;
+    }
+    fd = open(PROTOCOL_FUZZ_FAILURE_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        if (write(fd, current->data, current->length) == (ssize_t) current->length) {
+            write(STDERR_FILENO, "input written to " PROTOCOL_FUZZ_FAILURE_FILE "\n",
+                    sizeof("input written to " PROTOCOL_FUZZ_FAILURE_FILE "\n") - 1);
+        }
+        close(fd);
+    }
+    if (sig) {
+        _exit(1);
+    }
+}
+
+/**
+ * Gathers the values a message carries in the order its PAYLOAD_TEMPLATE_* sends them, and zeros
+ * for the fields it doesn't have.
+ */
+static void FuzzValues(ProtocolParserStatus status, const NegotiationData *nData,
+        const GuessData *gData, uint32_t values[PROTOCOL_MAX_FIELDS])
+{
+    memset(values, 0, PROTOCOL_MAX_FIELDS * sizeof(values[0]));
+    switch (status) {
+    case PROTOCOL_PARSED_HIT_MESSAGE:
+        values[2] = gData->hit;
+        //fall through
+    case PROTOCOL_PARSED_COO_MESSAGE:
+        values[0] = gData->row;
+        values[1] = gData->col;
+        break;
+    case PROTOCOL_PARSED_CHA_MESSAGE:
+        values[0] = nData->encryptedGuess;
+        values[1] = nData->hash;
+        break;
+    case PROTOCOL_PARSED_DET_MESSAGE:
+        values[0] = nData->guess;
+        values[1] = nData->encryptionKey;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Feeds bytes to a fresh parser.
+ * @return What the bytes decoded to, as FuzzCase describes it.
+ */
+static ProtocolParserStatus FuzzDecode(const uint8_t *data, size_t length,
+        uint32_t values[PROTOCOL_MAX_FIELDS])
+{
+    ProtocolParser parser;
+    NegotiationData nData;
+    GuessData gData;
+    ProtocolParserStatus status, result = PROTOCOL_WAITING;
+    size_t i;
+    ProtocolParserInit(&parser);
+    memset(values, 0, PROTOCOL_MAX_FIELDS * sizeof(values[0]));
+    for (i = 0; i < length; i++) {
+        status = ProtocolParserDecode(&parser, data[i], &nData, &gData);
+        if (status >= PROTOCOL_PARSED_COO_MESSAGE) {
+            FuzzValues(status, &nData, &gData, values);
+            result = status;
+        } else if (status == PROTOCOL_PARSING_FAILURE && result < PROTOCOL_PARSED_COO_MESSAGE) {
+            result = PROTOCOL_PARSING_FAILURE;
+        } else if (status != PROTOCOL_WAITING && result == PROTOCOL_WAITING) {
+            result = PROTOCOL_PARSING_GOOD;
+        }
+    }
+    return result;
+}
+
+/**
+ * Encodes a decoded message again as text and checks that it decodes to the same values.
+ * @return What went wrong, NULL if nothing did.
+ */
+static const char *FuzzRoundTrip(ProtocolParserStatus status,
+        const uint32_t values[PROTOCOL_MAX_FIELDS])
+{
+    char message[PROTOCOL_MAX_MESSAGE_LEN];
+    uint32_t again[PROTOCOL_MAX_FIELDS];
+    NegotiationData nData;
+    GuessData gData = {values[0], values[1], values[2]};
+    int length;
+    switch (status) {
+    case PROTOCOL_PARSED_COO_MESSAGE:
+        length = ProtocolEncodeCooMessage(message, &gData);
+        break;
+    case PROTOCOL_PARSED_HIT_MESSAGE:
+        length = ProtocolEncodeHitMessage(message, &gData);
+        break;
+    case PROTOCOL_PARSED_CHA_MESSAGE:
+        nData.encryptedGuess = values[0];
+        nData.hash = values[1];
+        length = ProtocolEncodeChaMessage(message, &nData);
+        break;
+    case PROTOCOL_PARSED_DET_MESSAGE:
+        nData.guess = values[0];
+        nData.encryptionKey = values[1];
+        length = ProtocolEncodeDetMessage(message, &nData);
+        break;
+    default: //a NAK hands over nothing
+        return NULL;
+    }
+    if (length >= PROTOCOL_MAX_MESSAGE_LEN) {
+        return "decoded a message too long to encode";
+    }
+    if (FuzzDecode((const uint8_t *) message, length, again) != status ||
+            memcmp(values, again, sizeof(again)) != 0) {
+        return "decoded a message that doesn't encode to the same values";
+    }
+    return NULL;
+}
+
+/**
+ * Runs an input through the decoder and checks everything it does.
+ * @return What went wrong, NULL if nothing did.
+ */
+static const char *FuzzRun(const FuzzInput *in)
+{
+    static const uint8_t resync[] = "$COO,3,7*47\n";
+    static FuzzGuardedParser guarded;
+    NegotiationData nData, nGlobal;
+    GuessData gData, gGlobal;
+    ProtocolParserStatus status = PROTOCOL_WAITING;
+    uint32_t values[PROTOCOL_MAX_FIELDS], globalValues[PROTOCOL_MAX_FIELDS];
+    const char *failure;
+    size_t i;
+    int w;
+
+    current = in;
+    memset(edgeCounts, 0, sizeof(edgeCounts));
+    lastPc = 0;
+    if (fuzzLegacy) {
+        LegacyProtocolReset();
+        for (i = 0; i < in->length; i++) {
+            LegacyProtocolDecode(in->data[i], &nData, &gData);
+        }
+        return NULL;
+    }
+    for (w = 0; w < FUZZ_CANARY_WORDS; w++) {
+        guarded.before[w] = guarded.after[w] = FUZZ_CANARY;
+    }
+    ProtocolParserInit(&guarded.parser);
+    //"$*" leaves ProtocolDecode() waiting for a message whatever it was doing
+    ProtocolDecode('$', &nGlobal, &gGlobal);
+    ProtocolDecode('*', &nGlobal, &gGlobal);
+
+    for (i = 0; i < in->length; i++) {
+        status = ProtocolParserDecode(&guarded.parser, in->data[i], &nData, &gData);
+        if (status != ProtocolDecode(in->data[i], &nGlobal, &gGlobal)) {
+            return "ProtocolDecode() and ProtocolParserDecode() disagree";
+        }
+        for (w = 0; w < FUZZ_CANARY_WORDS; w++) {
+            if (guarded.before[w] != FUZZ_CANARY || guarded.after[w] != FUZZ_CANARY) {
+                return "wrote outside of its parser";
+            }
+        }
+        if (status < PROTOCOL_PARSING_FAILURE || status > PROTOCOL_PARSED_NAK_MESSAGE) {
+            return "returned an unknown status";
+        }
+        if (status >= PROTOCOL_PARSED_COO_MESSAGE) {
+            FuzzValues(status, &nData, &gData, values);
+            FuzzValues(status, &nGlobal, &gGlobal, globalValues);
+            if (memcmp(values, globalValues, sizeof(values)) != 0) {
+                return "ProtocolDecode() and ProtocolParserDecode() decoded different values";
+            }
+            if ((failure = FuzzRoundTrip(status, values))) {
+                return failure;
+            }
+        }
+    }
+
+    //whatever was left half done, the next message has to come through
+    for (i = 0; i < sizeof(resync) - 1; i++) {
+        status = ProtocolParserDecode(&guarded.parser, resync[i], &nData, &gData);
+    }
+    FuzzValues(status, &nData, &gData, values);
+    if (status != PROTOCOL_PARSED_COO_MESSAGE || values[0] != 3 || values[1] != 7) {
+        return "lost the message that followed";
+    }
+    return NULL;
+}
+
+/**
+ * Returns the bucket a count of edges falls in, one bit for each, so that an input is only new if
+ * it takes an edge a different number of times.
+ */
+static uint8_t FuzzBucket(uint8_t count)
+{
+    if (count < 4) {
+        return count == 3 ? 4 : count;
+    }
+    if (count < 8) {
+        return 8;
+    }
+    if (count < 16) {
+        return 16;
+    }
+    if (count < 32) {
+        return 32;
+    }
+    return count < 128 ? 64 : 128;
+}
+
+/**
+ * Marks the edges the last input took as seen.
+ * @return TRUE if any of them, or any number of times one was taken, hadn't been seen before.
+ */
+static uint8_t FuzzNewCoverage(void)
+{
+    const uint64_t *words = (const uint64_t *) edgeCounts;
+    uint8_t found = FALSE, bucket;
+    int w, e;
+    //most edges are never taken, so skip over them eight at a time
+    for (w = 0; w < FUZZ_MAP_SIZE / 8; w++) {
+        if (!words[w]) {
+            continue;
+        }
+        for (e = w * 8; e < w * 8 + 8; e++) {
+            bucket = FuzzBucket(edgeCounts[e]);
+            if (edgeCounts[e] && !(edgesSeen[e] & bucket)) {
+                edgesSeen[e] |= bucket;
+                found = TRUE;
+            }
+        }
+    }
+    return found;
+}
+
+/**
+ * Adds an input to the corpus, if there's room.
+ */
+static void FuzzAdd(const uint8_t *data, size_t length)
+{
+    if (corpusSize < FUZZ_MAX_CORPUS) {
+        if (length > FUZZ_MAX_INPUT) {
+            length = FUZZ_MAX_INPUT;
+        }
+        memcpy(corpus[corpusSize].data, data, length);
+        corpus[corpusSize].length = length;
+        corpusSize++;
+    }
+}
+
+/**
+ * Returns a byte for a mutation, a token the decoder knows three times out of four.
+ */
+static uint8_t FuzzByte(void)
+{
+    if (FuzzRandom() & 3) {
+        return fuzzTokens[FuzzRandom() % (sizeof(fuzzTokens) - 1)];
+    }
+    return FuzzRandom();
+}
+
+/**
+ * Applies a few random changes to an input: flipping bits, changing, adding and removing bytes,
+ * repeating a run of them, or splicing in the end of another input from the corpus.
+ */
+static void FuzzMutate(FuzzInput *in)
+{
+    const FuzzInput *other;
+    size_t at, span, from;
+    int changes = 1 + FuzzRandom() % 4;
+    while (changes--) {
+        at = in->length ? FuzzRandom() % in->length : 0;
+        span = 1 + FuzzRandom() % 16;
+        switch (FuzzRandom() % 7) {
+        case 0:
+            if (in->length) {
+                in->data[at] ^= 1 << (FuzzRandom() & 7);
+            }
+            break;
+        case 1:
+            if (in->length) {
+                in->data[at] = FuzzByte();
+            }
+            break;
+        case 2: //insert a byte
+            if (in->length < FUZZ_MAX_INPUT) {
+                memmove(in->data + at + 1, in->data + at, in->length - at);
+                in->data[at] = FuzzByte();
+                in->length++;
+            }
+            break;
+        case 3: //remove some
+            if (span > in->length - at) {
+                span = in->length - at;
+            }
+            memmove(in->data + at, in->data + at + span, in->length - at - span);
+            in->length -= span;
+            break;
+        case 4: //repeat some, to make fields and messages too long
+            if (span > in->length - at) {
+                span = in->length - at;
+            }
+            if (in->length + span <= FUZZ_MAX_INPUT) {
+                memmove(in->data + at + span, in->data + at, in->length - at);
+                in->length += span;
+            }
+            break;
+        case 5: //copy some over from elsewhere in the input
+            if (in->length) {
+                from = FuzzRandom() % in->length;
+                if (span > in->length - at) {
+                    span = in->length - at;
+                }
+                if (span > in->length - from) {
+                    span = in->length - from;
+                }
+                memmove(in->data + at, in->data + from, span);
+            }
+            break;
+        default: //splice in the end of another input
+            other = &corpus[FuzzRandom() % corpusSize];
+            from = other->length ? FuzzRandom() % other->length : 0;
+            span = other->length - from;
+            if (at + span > FUZZ_MAX_INPUT) {
+                span = FUZZ_MAX_INPUT - at;
+            }
+            memcpy(in->data + at, other->data + from, span);
+            in->length = at + span;
+            break;
+        }
+    }
+}
+
+/**
+ * Prints an input with everything but printable ASCII escaped.
+ */
+static void FuzzPrint(const char *label, const uint8_t *data, size_t length)
+{
+    size_t i;
+    printf("%s \"", label);
+    for (i = 0; i < length; i++) {
+        if (data[i] == '\n') {
+            printf("\\n");
+        } else if (data[i] >= ' ' && data[i] < 0x7F && data[i] != '"' && data[i] != '\\') {
+            putchar(data[i]);
+        } else {
+            printf("\\x%02x", data[i]);
+        }
+    }
+    printf("\"\n");
+}
+
+/**
+ * Checks that every built-in case decodes to what it should.
+ * @return The number of cases that didn't.
+ */
+static int FuzzCheckCases(void)
+{
+    uint32_t values[PROTOCOL_MAX_FIELDS];
+    ProtocolParserStatus status;
+    size_t c;
+    int wrong = 0;
+    for (c = 0; c < FUZZ_NUM_CASES; c++) {
+        status = FuzzDecode((const uint8_t *) cases[c].bytes, cases[c].length, values);
+        if (status != cases[c].expect || memcmp(values, cases[c].values, sizeof(values)) != 0) {
+            FuzzPrint("wrong:", (const uint8_t *) cases[c].bytes, cases[c].length);
+            printf("  decoded %d %u,%u,%u instead of %d %u,%u,%u\n", status, values[0],
+                    values[1], values[2], cases[c].expect, cases[c].values[0],
+                    cases[c].values[1], cases[c].values[2]);
+            wrong++;
+        }
+    }
+    return wrong;
+}
+
+/**
+ * Adds the contents of a file to the corpus.
+ * @return SUCCESS, or STANDARD_ERROR if it can't be read.
+ */
+static int FuzzLoad(const char *path)
+{
+    uint8_t data[FUZZ_MAX_INPUT];
+    size_t length;
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return STANDARD_ERROR;
+    }
+    length = fread(data, 1, sizeof(data), f);
+    fclose(f);
+    FuzzAdd(data, length);
+    return SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t executions = FUZZ_DEFAULT_EXECUTIONS, n;
+    struct timespec start, end;
+    double seconds;
+    const char *failure;
+    FuzzInput child;
+    int verbose = FALSE, opt, i, edges;
+    size_t c;
+
+    while ((opt = getopt(argc, argv, "n:s:lv")) != -1) {
+        switch (opt) {
+        case 'n':
+            executions = strtoull(optarg, NULL, 0);
+            break;
+        case 's':
+            fuzzSeed = strtoul(optarg, NULL, 0);
+            if (fuzzSeed == 0) { //xorshift never leaves 0
+                fuzzSeed = 1;
+            }
+            break;
+        case 'l':
+            fuzzLegacy = TRUE;
+            break;
+        case 'v':
+            verbose = TRUE;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n executions] [-s seed] [-l] [-v] [file...]\n", argv[0]);
+            return 2;
+        }
+    }
+    signal(SIGABRT, FuzzSaveFailure);
+
+    if (!fuzzLegacy) {
+        i = FuzzCheckCases();
+        printf("corpus: %u cases, %d decoded wrong\n", (unsigned) FUZZ_NUM_CASES, i);
+        if (i) {
+            return 1;
+        }
+    }
+    for (i = optind; i < argc; i++) {
+        if (FuzzLoad(argv[i]) != SUCCESS) {
+            return 2;
+        }
+    }
+    for (c = 0; c < FUZZ_NUM_CASES; c++) {
+        FuzzAdd((const uint8_t *) cases[c].bytes, cases[c].length);
+    }
+    //run the corpus itself first, to learn what it covers
+    for (i = 0; i < corpusSize; i++) {
+        if ((failure = FuzzRun(&corpus[i]))) {
+            FuzzPrint(failure, corpus[i].data, corpus[i].length);
+            FuzzSaveFailure(0);
+            return 1;
+        }
+        FuzzNewCoverage();
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (n = 0; n < executions; n++) {
+        child = corpus[FuzzRandom() % corpusSize];
+        FuzzMutate(&child);
+        if ((failure = FuzzRun(&child))) {
+            FuzzPrint(failure, child.data, child.length);
+            FuzzSaveFailure(0);
+            return 1;
+        }
+        if (FuzzNewCoverage()) {
+            if (verbose) {
+                FuzzPrint("new:", child.data, child.length);
+            }
+            FuzzAdd(child.data, child.length);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    for (edges = 0, i = 0; i < FUZZ_MAP_SIZE; i++) {
+        edges += edgesSeen[i] != 0;
+    }
+    printf("fuzz: %llu inputs in %.2f s (%.0f/s), %d edges, corpus of %d, no failures\n",
+            (unsigned long long) executions, seconds, executions / seconds, edges, corpusSize);
+    return 0;
+}
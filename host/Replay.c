@@ -0,0 +1,449 @@
+/*
+ * Replay plays games again from their journals, see Journal.h. It reads everything printed by
+ * JournalDump(), whether from a capture of the board's UART or from Tournament -r -j, and skips
+ * any other lines. For every journal it finds it starts a fresh agent from the recorded seed and
+ * settings, feeds it the recorded input on the recorded ticks through the same AgentContextRun()
+ * or AgentContextRunBuffer() calls, and records a journal of its own. The game has been reproduced
+ * exactly if the two journals are the same; otherwise the first event where they part is shown.
+ *
+ * The agent is assumed to have been run at least once on every tick, as both BattleBoats.c and
+ * Tournament do, and a tick without any events is replayed as a single run without input. Each
+ * journal is replayed on a thread of its own, whose scheduler clock starts from zero like the
+ * board's.
+ *
+ * Usage: Replay [-v] [file]
+ *
+ * -v lists every event of each journal as it's replayed. The exit status is 0 only if every
+ * journal was reproduced.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Agent.h"
+#include "BOARD.h"
+#include "Field.h"
+#include "Journal.h"
+#include "Protocol.h"
+#include "Scheduler.h"
+
+// Longer than any line JournalDump() prints.
+#define REPLAY_LINE_LEN 256
+
+// The output buffer handed to the agent, big enough for AgentContextRunBuffer() on any run that
+// fits in a journal.
+#define REPLAY_OUT_BUFFER_LEN AGENT_RUN_BUFFER_OUT_LEN(JOURNAL_SIZE)
+
+// The most values any event carries.
+#define REPLAY_MAX_VALUES 4
+
+/**
+ * One event read back from a journal.
+ */
+typedef struct {
+    JournalEvent event;
+    uint32_t offset;                    // Where the event starts in the journal.
+    uint32_t tick;                      // The tick it happened on.
+    uint32_t values[REPLAY_MAX_VALUES]; // Its values, or the length of its bytes.
+    const uint8_t *bytes;               // Its bytes, for those that carry any.
+} ReplayEvent;
+
+/**
+ * A journal read from the input, and how replaying it went.
+ */
+typedef struct {
+    uint8_t *data;
+    uint32_t length;
+    int verbose;
+    int reproduced;
+} ReplayJob;
+
+// Where the replayed agent records its own journal and sends its output. Journals are replayed one
+// after the other, and these are too big for a thread's stack.
+static AgentContext agent;
+static Journal replayed;
+static char out[REPLAY_OUT_BUFFER_LEN];
+
+static const char *const ReplayEventNames[JOURNAL_NUM_EVENTS] = {
+    [JOURNAL_EVENT_TICK] = "tick",
+    [JOURNAL_EVENT_SEED] = "seed",
+    [JOURNAL_EVENT_POLICY] = "policy",
+    [JOURNAL_EVENT_FLEET] = "fleet",
+    [JOURNAL_EVENT_WIRE] = "wire",
+    [JOURNAL_EVENT_NAK] = "nak",
+    [JOURNAL_EVENT_RUN] = "run",
+    [JOURNAL_EVENT_RUN_BUFFER] = "run-buffer",
+    [JOURNAL_EVENT_IDLE] = "idle",
+    [JOURNAL_EVENT_DECODED] = "decoded",
+    [JOURNAL_EVENT_SENT] = "sent",
+    [JOURNAL_EVENT_STATE] = "state",
+};
+
+static const char *const ReplayStateNames[] = {
+    [AGENT_STATE_GENERATE_NEG_DATA] = "GENERATE_NEG_DATA",
+    [AGENT_STATE_SEND_CHALLENGE_DATA] = "SEND_CHALLENGE_DATA",
+    [AGENT_STATE_DETERMINE_TURN_ORDER] = "DETERMINE_TURN_ORDER",
+    [AGENT_STATE_SEND_GUESS] = "SEND_GUESS",
+    [AGENT_STATE_WAIT_FOR_HIT] = "WAIT_FOR_HIT",
+    [AGENT_STATE_WAIT_FOR_GUESS] = "WAIT_FOR_GUESS",
+    [AGENT_STATE_INVALID] = "INVALID",
+    [AGENT_STATE_LOST] = "LOST",
+    [AGENT_STATE_WON] = "WON",
+};
+
+/**
+ * Reads a value stored 7 bits at a time, see Journal.h.
+ * @return TRUE if the whole value was there.
+ */
+static int ReplayReadValue(const uint8_t *data, uint32_t length, uint32_t *pos, uint32_t *value)
+{
+    int shift;
+    *value = 0;
+    for (shift = 0; shift < 35 && *pos < length; shift += 7) {
+        uint8_t b = data[(*pos)++];
+        *value |= (uint32_t) (b & 0x7F) << shift;
+        if ((b & 0x80) == 0) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/**
+ * Reads the event at `*pos` and moves past it. Ticks are added up into `*tick` and stamped on every
+ * event, including the JOURNAL_EVENT_TICK itself.
+ * @return TRUE if there was a whole event to read.
+ */
+static int ReplayReadEvent(const uint8_t *data, uint32_t length, uint32_t *pos, uint32_t *tick,
+        ReplayEvent *e)
+{
+    int count = 1, i;
+    if (*pos >= length || data[*pos] >= JOURNAL_NUM_EVENTS) {
+        return FALSE;
+    }
+    e->offset = *pos;
+    e->event = data[(*pos)++];
+    e->bytes = NULL;
+    if (e->event == JOURNAL_EVENT_DECODED) {
+        //the status is followed by the data of the message
+        if (!ReplayReadValue(data, length, pos, &e->values[0])) {
+            return FALSE;
+        }
+        switch ((int8_t) e->values[0]) {
+        case PROTOCOL_PARSED_HIT_MESSAGE:
+            count = 3;
+            break;
+        case PROTOCOL_PARSED_COO_MESSAGE:
+        case PROTOCOL_PARSED_CHA_MESSAGE:
+        case PROTOCOL_PARSED_DET_MESSAGE:
+            count = 2;
+            break;
+        default:
+            count = 0;
+            break;
+        }
+        for (i = 1; i <= count; i++) {
+            if (!ReplayReadValue(data, length, pos, &e->values[i])) {
+                return FALSE;
+            }
+        }
+    } else if (!ReplayReadValue(data, length, pos, &e->values[0])) {
+        return FALSE;
+    }
+    if (e->event == JOURNAL_EVENT_RUN_BUFFER || e->event == JOURNAL_EVENT_SENT) {
+        if (e->values[0] > length - *pos) {
+            return FALSE;
+        }
+        e->bytes = data + *pos;
+        *pos += e->values[0];
+    }
+    if (e->event == JOURNAL_EVENT_TICK) {
+        *tick += e->values[0];
+    }
+    e->tick = *tick;
+    return TRUE;
+}
+
+/**
+ * Prints the bytes of a message, with anything that isn't printable ASCII in hex.
+ */
+static void ReplayPrintBytes(const uint8_t *bytes, uint32_t length)
+{
+    uint32_t i;
+    for (i = 0; i < length; i++) {
+        if (bytes[i] == '\n') {
+            printf("\\n");
+        } else if (bytes[i] >= ' ' && bytes[i] < 0x7F) {
+            putchar(bytes[i]);
+        } else {
+            printf("\\x%02x", bytes[i]);
+        }
+    }
+}
+
+static void ReplayPrintEvent(const char *prefix, const ReplayEvent *e)
+{
+    uint8_t in = e->values[0];
+    printf("%s%8u  %-10s ", prefix, e->tick, ReplayEventNames[e->event]);
+    switch (e->event) {
+    case JOURNAL_EVENT_RUN:
+        printf("'");
+        ReplayPrintBytes(&in, 1);
+        printf("'");
+        break;
+    case JOURNAL_EVENT_RUN_BUFFER:
+    case JOURNAL_EVENT_SENT:
+        ReplayPrintBytes(e->bytes, e->values[0]);
+        break;
+    case JOURNAL_EVENT_IDLE:
+        printf("%s", ReplayEventNames[e->values[0] < JOURNAL_NUM_EVENTS ? e->values[0] : 0]);
+        break;
+    case JOURNAL_EVENT_STATE:
+        printf("%s", e->values[0] < sizeof(ReplayStateNames) / sizeof(ReplayStateNames[0]) ?
+                ReplayStateNames[e->values[0]] : "?");
+        break;
+    case JOURNAL_EVENT_DECODED:
+        switch ((int8_t) e->values[0]) {
+        case PROTOCOL_PARSED_COO_MESSAGE:
+            printf("COO %u,%u", e->values[1], e->values[2]);
+            break;
+        case PROTOCOL_PARSED_HIT_MESSAGE:
+            printf("HIT %u,%u,%u", e->values[1], e->values[2], e->values[3]);
+            break;
+        case PROTOCOL_PARSED_NAK_MESSAGE:
+            printf("NAK");
+            break;
+        case PROTOCOL_PARSED_CHA_MESSAGE:
+            printf("CHA %u,%u", e->values[1], e->values[2]);
+            break;
+        case PROTOCOL_PARSED_DET_MESSAGE:
+            printf("DET %u,%u", e->values[1], e->values[2]);
+            break;
+        default:
+            printf("failure");
+            break;
+        }
+        break;
+    default:
+        printf("%u", e->values[0]);
+        break;
+    }
+    printf("\n");
+}
+
+/**
+ * Runs the agent without any input, the way it was in the journal.
+ * @param kind JOURNAL_EVENT_RUN or JOURNAL_EVENT_RUN_BUFFER.
+ */
+static void ReplayIdle(uint32_t kind)
+{
+    if (kind == JOURNAL_EVENT_RUN_BUFFER) {
+        AgentContextRunBuffer(&agent, NULL, 0, out);
+    } else {
+        AgentContextRun(&agent, '\0', out);
+    }
+}
+
+/**
+ * Finds the event of a journal that a byte belongs to, and prints it.
+ */
+static void ReplayPrintEventAt(const char *prefix, const uint8_t *data, uint32_t length,
+        uint32_t offset)
+{
+    ReplayEvent e;
+    uint32_t pos = 0, tick = 0;
+    while (ReplayReadEvent(data, length, &pos, &tick, &e)) {
+        if (pos > offset) {
+            ReplayPrintEvent(prefix, &e);
+            return;
+        }
+    }
+    printf("%s(end of the journal)\n", prefix);
+}
+
+/**
+ * Replays one journal on the calling thread, whose scheduler clock must not have been started.
+ */
+static void *ReplayMain(void *arg)
+{
+    ReplayJob *job = arg;
+    ReplayEvent e, settings[3];
+    uint32_t pos = 0, tick = 0, idle = JOURNAL_EVENT_RUN, t, i;
+    int started = FALSE;
+
+    job->reproduced = FALSE;
+    //runs without input are made the same way as the first runs in the journal
+    while (ReplayReadEvent(job->data, job->length, &pos, &tick, &e)) {
+        if (e.event == JOURNAL_EVENT_RUN || e.event == JOURNAL_EVENT_RUN_BUFFER) {
+            idle = e.event;
+            break;
+        } else if (e.event == JOURNAL_EVENT_IDLE) {
+            idle = e.values[0];
+            break;
+        }
+    }
+    pos = 0;
+    tick = 0;
+    while (pos < job->length) {
+        if (!ReplayReadEvent(job->data, job->length, &pos, &tick, &e)) {
+            printf("  broken event at byte %u\n", pos);
+            return NULL;
+        }
+        if (job->verbose) {
+            ReplayPrintEvent("  ", &e);
+        }
+        switch (e.event) {
+        case JOURNAL_EVENT_TICK:
+            //every tick before this one passed without anything to record
+            for (t = SchedulerNow(); t < e.tick; t++) {
+                SchedulerTick();
+                if (started && t + 1 < e.tick) {
+                    ReplayIdle(idle);
+                }
+            }
+            break;
+        case JOURNAL_EVENT_SEED:
+            //the agent's settings when the journal was started follow its seed
+            for (i = 0; i < 3; i++) {
+                if (!ReplayReadEvent(job->data, job->length, &pos, &tick, &settings[i])) {
+                    printf("  broken event at byte %u\n", pos);
+                    return NULL;
+                }
+                if (job->verbose) {
+                    ReplayPrintEvent("  ", &settings[i]);
+                }
+            }
+            AgentContextInit(&agent, e.values[0]);
+            AgentContextSetPolicy(&agent, settings[0].values[0]);
+            AgentContextSetWireFormat(&agent, settings[1].values[0]);
+            AgentContextSetNak(&agent, settings[2].values[0]);
+            AgentContextSetJournal(&agent, &replayed);
+            started = TRUE;
+            break;
+        case JOURNAL_EVENT_POLICY:
+            AgentContextSetPolicy(&agent, e.values[0]);
+            break;
+        case JOURNAL_EVENT_FLEET:
+            AgentContextSetFleet(&agent, e.values[0]);
+            break;
+        case JOURNAL_EVENT_WIRE:
+            AgentContextSetWireFormat(&agent, e.values[0]);
+            break;
+        case JOURNAL_EVENT_NAK:
+            AgentContextSetNak(&agent, e.values[0]);
+            break;
+        case JOURNAL_EVENT_RUN:
+            AgentContextRun(&agent, (char) e.values[0], out);
+            break;
+        case JOURNAL_EVENT_RUN_BUFFER:
+            AgentContextRunBuffer(&agent, (const char *) e.bytes, e.values[0], out);
+            break;
+        case JOURNAL_EVENT_IDLE:
+            idle = e.values[0];
+            ReplayIdle(idle);
+            break;
+        default:
+            //what the agent did, which the replay has to do again by itself
+            break;
+        }
+    }
+    if (!started) {
+        printf("  no seed, nothing to replay\n");
+        return NULL;
+    }
+    for (i = 0; i < job->length && i < replayed.length && job->data[i] == replayed.data[i]; i++);
+    if (i == job->length && i == replayed.length) {
+        job->reproduced = TRUE;
+        printf("  reproduced exactly: %u bytes up to tick %u, agent %s\n", job->length, tick,
+                ReplayStateNames[agent.state]);
+        return NULL;
+    }
+    printf("  differs from byte %u on:\n", i);
+    ReplayPrintEventAt("  recorded ", job->data, job->length, i);
+    ReplayPrintEventAt("  replayed ", replayed.data,
+            replayed.length < JOURNAL_SIZE ? replayed.length : JOURNAL_SIZE, i);
+    return NULL;
+}
+
+/**
+ * Reads the hex lines of a journal up to its "end" line.
+ * @return TRUE if all of the bytes announced were there.
+ */
+static int ReplayReadJournal(FILE *in, ReplayJob *job)
+{
+    char line[REPLAY_LINE_LEN];
+    uint32_t n = 0;
+    unsigned int b;
+    char *p;
+    while (fgets(line, sizeof(line), in) && strncmp(line, "end", 3) != 0) {
+        for (p = line; n < job->length && sscanf(p, "%2x", &b) == 1; p += 2) {
+            job->data[n++] = b;
+        }
+    }
+    return n == job->length;
+}
+
+int main(int argc, char *argv[])
+{
+    char line[REPLAY_LINE_LEN], fleet[REPLAY_LINE_LEN], ours[REPLAY_LINE_LEN];
+    FILE *in = stdin;
+    ReplayJob job;
+    pthread_t thread;
+    unsigned long bytes, lost;
+    int rows, cols, opt, b, journals = 0, failed = 0;
+
+    job.verbose = FALSE;
+    while ((opt = getopt(argc, argv, "v")) != -1) {
+        switch (opt) {
+        case 'v':
+            job.verbose = TRUE;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-v] [file]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (optind < argc && (in = fopen(argv[optind], "r")) == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+    ours[0] = '\0';
+    for (b = 0; b < FIELD_NUM_BOATS; b++) {
+        sprintf(ours + strlen(ours), b ? ",%d" : "%d", fieldBoatLengths[b]);
+    }
+
+    while (fgets(line, sizeof(line), in)) {
+        if (sscanf(line, "journal %dx%d fleet %255s bytes %lu lost %lu", &rows, &cols, fleet,
+                &bytes, &lost) != 5) {
+            continue;
+        }
+        printf("journal %d: %dx%d fleet %s, %lu bytes\n", ++journals, rows, cols, fleet, bytes);
+        job.length = bytes;
+        job.data = malloc(bytes ? bytes : 1);
+        if (!ReplayReadJournal(in, &job)) {
+            printf("  cut short\n");
+            failed++;
+        } else if (rows != FIELD_ROWS || cols != FIELD_COLS || strcmp(fleet, ours) != 0) {
+            printf("  recorded on another field or fleet, this build plays %dx%d fleet %s\n",
+                    FIELD_ROWS, FIELD_COLS, ours);
+            failed++;
+        } else if (lost > 0) {
+            printf("  the first %lu bytes were overwritten, so the game can't be replayed "
+                    "(see JOURNAL_SIZE)\n", lost);
+            failed++;
+        } else {
+            pthread_create(&thread, NULL, ReplayMain, &job);
+            pthread_join(thread, NULL);
+            failed += !job.reproduced;
+        }
+        free(job.data);
+    }
+    if (journals == 0) {
+        fprintf(stderr, "no journal found\n");
+        return 1;
+    }
+    return failed > 0;
+}
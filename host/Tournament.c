@@ -0,0 +1,615 @@
+/*
+ * Tournament plays the artificial agent against itself on the host. Each game wires two
+ * AgentContexts back-to-back through in-memory pipes in place of the UART, and games are spread
+ * over a work-stealing pool of threads. Every game is seeded from the tournament seed and its own
+ * index, so any single game can be replayed exactly with -r.
+ *
+ * Usage: Tournament [-n games] [-t threads] [-s seed] [-r game] [-a policy] [-b policy]
+ *                   [-f fleet] [-g fleet] [-w format[,format]] [-e rate] [-N] [-B] [-j]
+ *
+ * -a and -b select the targeting policy of agent A and B, see TournamentPolicies below. -f and -g
+ * select where the fleet of agent A and B comes from, "table" (the default) or "uniform". -w selects
+ * the best format agent A and B offer for COO and HIT messages: "binary" (the default), "crc16"
+ * (text with a CRC-16) or "text". A single format applies to both. The report includes how many
+ * bytes each turn (a COO and its HIT) took over the link, and how long that is on the wire at
+ * UART_BAUD_RATE. -B hands each agent everything waiting in its pipe at once through
+ * AgentContextRunBuffer(), instead of feeding it one byte per step.
+ *
+ * -e flips each bit sent over the link with the given probability, from a generator seeded like
+ * the agents, to see how games hold up on a noisy line. Every step is one scheduler tick, so the
+ * agents' timeouts run too. The report includes how many games were completed rather than aborted,
+ * and how many steps the completed ones took. -N keeps the agents from offering NAKs, so that the
+ * first message that fails to parse ends the game as it used to.
+ *
+ * -j records the journal of both agents (see Journal.h) in the game replayed with -r, and prints
+ * them after it, for host/Replay to play the game again from.
+ *
+ * When built with profiling (make PROFILE=1) the profile of every game is printed at the end. The
+ * profiler's statistics aren't shared safely between threads, so profiling runs on one thread.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "Agent.h"
+#include "BOARD.h"
+#include "Field.h"
+#include "Journal.h"
+#include "Profile.h"
+#include "Protocol.h"
+#include "Scheduler.h"
+
+#define TOURNAMENT_DEFAULT_GAMES 100000
+#define TOURNAMENT_MAX_THREADS 256
+
+// A game that hasn't finished after this many steps is stuck, e.g. on a turn-order tie.
+#define TOURNAMENT_MAX_STEPS 200000
+
+// Big enough for several messages in flight in one direction.
+#define PIPE_SIZE 256
+
+// The output buffer handed to the agents: as promised by AgentRun(), and big enough for
+// AgentContextRunBuffer() on a whole pipe.
+#define AGENT_OUT_BUFFER_LEN 255
+#define AGENT_BATCH_OUT_BUFFER_LEN AGENT_RUN_BUFFER_OUT_LEN(PIPE_SIZE)
+
+typedef enum {
+    GAME_ABORTED = -1,
+    GAME_WON_BY_A,
+    GAME_WON_BY_B
+} GameOutcome;
+
+typedef struct {
+    GameOutcome outcome;
+    uint32_t shots; // Shots the winner needed to sink the whole enemy fleet.
+    uint32_t steps;
+    uint32_t turns; // Shots fired by both agents.
+    uint32_t bytes; // Bytes sent by both agents.
+    uint32_t flips; // Bits flipped on the way, see -e.
+} GameResult;
+
+typedef struct {
+    uint64_t games;
+    uint64_t wins[2];
+    uint64_t shots[2];
+    uint64_t aborted;
+    uint64_t turns;
+    uint64_t bytes;
+    uint64_t steps; // Steps taken by the games that were completed.
+    uint64_t flips;
+} TournamentStats;
+
+/**
+ * A one-directional byte pipe standing in for a UART link.
+ */
+typedef struct {
+    uint16_t readIndex;
+    uint16_t dataSize;
+    char data[PIPE_SIZE];
+} Pipe;
+
+/**
+ * Each worker owns a range of game indices. It takes games from the front of its own range and,
+ * once that's empty, steals the back half of the fullest range among the other workers.
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    uint64_t next; // Only written under the lock, but read without it by thieves, so atomically.
+    uint64_t end;
+    TournamentStats stats;
+    pthread_t thread;
+} Worker;
+
+typedef struct {
+    const char *name;
+    AgentPolicy policy;
+} PolicyName;
+
+static const PolicyName TournamentPolicies[] = {
+    {"random", AGENT_POLICY_RANDOM},
+    {"density", AGENT_POLICY_DENSITY},
+    {"sampling", AGENT_POLICY_SAMPLING},
+    {"hunt", AGENT_POLICY_HUNT_TARGET},
+    {"parity", AGENT_POLICY_PARITY},
+};
+
+static const char *const TournamentWireFormats[] = {
+    [PROTOCOL_WIRE_TEXT] = "text",
+    [PROTOCOL_WIRE_TEXT_CRC16] = "crc16",
+    [PROTOCOL_WIRE_BINARY] = "binary",
+};
+
+static const char *const TournamentFleets[] = {
+    [AGENT_FLEET_UNIFORM] = "uniform",
+    [AGENT_FLEET_TABLE] = "table",
+};
+
+static uint32_t tournamentSeed = 1;
+static AgentPolicy playerPolicy[2] = {AGENT_POLICY_DENSITY, AGENT_POLICY_DENSITY};
+static AgentFleet playerFleet[2] = {AGENT_FLEET_TABLE, AGENT_FLEET_TABLE};
+static ProtocolWireFormat playerWire[2] = {PROTOCOL_WIRE_BINARY, PROTOCOL_WIRE_BINARY};
+static int batchInput = FALSE;
+static int offerNak = TRUE;
+static int recordJournals = FALSE;
+static double bitErrorRate;
+static int workerCount;
+static Worker workers[TOURNAMENT_MAX_THREADS];
+
+static void PipeWrite(Pipe *p, const char *data, int length)
+{
+    int i;
+    for (i = 0; i < length && p->dataSize < PIPE_SIZE; i++) {
+        p->data[(p->readIndex + p->dataSize) % PIPE_SIZE] = data[i];
+        p->dataSize++;
+    }
+}
+
+static char PipeRead(Pipe *p)
+{
+    char c;
+    if (p->dataSize == 0) {
+        return '\0';
+    }
+    c = p->data[p->readIndex];
+    p->readIndex = (p->readIndex + 1) % PIPE_SIZE;
+    p->dataSize--;
+    return c;
+}
+
+/**
+ * Empties a pipe into `data`, which must be at least PIPE_SIZE long.
+ * @return The number of bytes read.
+ */
+static size_t PipeReadAll(Pipe *p, char *data)
+{
+    size_t length = 0;
+    while (p->dataSize > 0) {
+        data[length++] = PipeRead(p);
+    }
+    return length;
+}
+
+/**
+ * Flips each bit of `data` with probability `bitErrorRate`.
+ * @param noise The state of the xorshift generator deciding which bits flip.
+ * @return The number of bits flipped.
+ */
+static uint32_t TournamentAddNoise(char *data, int length, uint32_t *noise)
+{
+    //a flip whenever a 32-bit draw falls below this
+    uint32_t threshold = bitErrorRate * 4294967296.0 > UINT32_MAX ?
+            UINT32_MAX : (uint32_t) (bitErrorRate * 4294967296.0);
+    uint32_t flips = 0, x = *noise;
+    int i, b;
+    for (i = 0; i < length; i++) {
+        for (b = 0; b < 8; b++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            if (x < threshold) {
+                data[i] ^= 1 << b;
+                flips++;
+            }
+        }
+    }
+    *noise = x;
+    return flips;
+}
+
+/**
+ * Derives the seed of one agent in one game from the tournament seed, so that every game is
+ * independent of which thread plays it and in which order.
+ */
+static uint32_t TournamentGameSeed(uint64_t game, int player)
+{
+    uint64_t z = ((uint64_t) tournamentSeed << 32) + game * 2 + player + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return (uint32_t) (z ^ (z >> 31));
+}
+
+/**
+ * Prints what an agent sent for -r. Text messages are printed as they are and binary frames in hex.
+ */
+static void TournamentTrace(char agent, const char *out, int length)
+{
+    int i;
+    while (length > 0) {
+        if ((uint8_t) out[0] != PROTOCOL_FRAME_SYNC) {
+            //a text message, up to its newline
+            const char *end = memchr(out, '\n', length);
+            int n = end ? end - out + 1 : length;
+            printf("%c: %.*s", agent, n, out);
+            out += n;
+            length -= n;
+            continue;
+        }
+        printf("%c:", agent);
+        for (i = 0; i < PROTOCOL_FRAME_LEN && i < length; i++) {
+            printf(" %02x", (uint8_t) out[i]);
+        }
+        printf("\n");
+        out += i;
+        length -= i;
+    }
+}
+
+/**
+ * Plays a single game between two fresh agents. Each step feeds every agent the next byte waiting
+ * for it (or '\0' when there is none), or with -B everything waiting for it at once, just like the
+ * main loop in BattleBoats.c does with the UART. Each step advances the scheduler's clock by a tick.
+ * @param game The index of the game, which determines both agents' seeds.
+ * @param trace If TRUE, every message is printed as it is sent.
+ * @param journals Where to record the journals of agent A and B, NULL not to.
+ * @param result Receives the outcome of the game.
+ */
+static void TournamentPlayGame(uint64_t game, int trace, Journal *journals, GameResult *result)
+{
+    AgentContext agents[2];
+    Pipe pipes[2]; // pipes[i] carries the bytes travelling to agents[i]
+    char out[AGENT_OUT_BUFFER_LEN + 1 > AGENT_BATCH_OUT_BUFFER_LEN ?
+            AGENT_OUT_BUFFER_LEN + 1 : AGENT_BATCH_OUT_BUFFER_LEN];
+    char in[PIPE_SIZE];
+    uint32_t step;
+    uint32_t noise = TournamentGameSeed(game, 2) | 1;
+    int p;
+
+    AgentContextInit(&agents[0], TournamentGameSeed(game, 0));
+    AgentContextInit(&agents[1], TournamentGameSeed(game, 1));
+    if (journals != NULL) {
+        AgentContextSetJournal(&agents[0], &journals[0]);
+        AgentContextSetJournal(&agents[1], &journals[1]);
+    }
+    AgentContextSetPolicy(&agents[0], playerPolicy[0]);
+    AgentContextSetPolicy(&agents[1], playerPolicy[1]);
+    AgentContextSetFleet(&agents[0], playerFleet[0]);
+    AgentContextSetFleet(&agents[1], playerFleet[1]);
+    AgentContextSetWireFormat(&agents[0], playerWire[0]);
+    AgentContextSetWireFormat(&agents[1], playerWire[1]);
+    AgentContextSetNak(&agents[0], offerNak);
+    AgentContextSetNak(&agents[1], offerNak);
+    memset(pipes, 0, sizeof(pipes));
+    result->outcome = GAME_ABORTED;
+    result->shots = 0;
+    result->turns = 0;
+    result->bytes = 0;
+    result->flips = 0;
+
+    for (step = 0; step < TOURNAMENT_MAX_STEPS; step++) {
+        SchedulerTick();
+        for (p = 0; p < 2; p++) {
+            int length;
+            if (batchInput) {
+                size_t inLength = PipeReadAll(&pipes[p], in);
+                PROFILE(PROFILE_AGENT_RUN,
+                        length = AgentContextRunBuffer(&agents[p], in, inLength, out));
+            } else {
+                in[0] = PipeRead(&pipes[p]);
+                PROFILE(PROFILE_AGENT_RUN, length = AgentContextRun(&agents[p], in[0], out));
+            }
+            if (length > 0) {
+                if (trace) {
+                    TournamentTrace('A' + p, out, length);
+                }
+                if (bitErrorRate > 0) {
+                    result->flips += TournamentAddNoise(out, length, &noise);
+                }
+                PipeWrite(&pipes[!p], out, length);
+                result->bytes += length;
+            }
+            if (AgentContextGetEnemyStatus(&agents[p]) == 0) {
+                result->outcome = p == 0 ? GAME_WON_BY_A : GAME_WON_BY_B;
+                result->shots = FIELD_ROWS * FIELD_COLS -
+                        FieldCountPositions(&agents[p].yourField, FIELD_POSITION_UNKNOWN);
+                result->turns = result->shots + FIELD_ROWS * FIELD_COLS -
+                        FieldCountPositions(&agents[!p].yourField, FIELD_POSITION_UNKNOWN);
+                result->steps = step;
+                return;
+            }
+            if (agents[p].state == AGENT_STATE_INVALID) {
+                result->steps = step;
+                return;
+            }
+        }
+    }
+    result->steps = step;
+}
+
+/**
+ * Takes the next game for worker `w`, stealing from another worker if it has run out.
+ * @return TRUE if a game was taken and stored in `game`, FALSE once there is no work left at all.
+ */
+static int WorkerTakeGame(Worker *w, uint64_t *game)
+{
+    uint64_t next, end;
+    int i;
+    pthread_mutex_lock(&w->lock);
+    if (w->next < w->end) {
+        *game = w->next;
+        __atomic_store_n(&w->next, w->next + 1, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&w->lock);
+        return TRUE;
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    while (TRUE) {
+        Worker *victim = NULL;
+        uint64_t most = 0;
+        for (i = 0; i < workerCount; i++) {
+            //a peek without the lock, the steal itself is checked again under the victim's lock
+            next = __atomic_load_n(&workers[i].next, __ATOMIC_RELAXED);
+            end = __atomic_load_n(&workers[i].end, __ATOMIC_RELAXED);
+            if (&workers[i] != w && next < end && end - next > most) {
+                victim = &workers[i];
+                most = end - next;
+            }
+        }
+        if (victim == NULL) {
+            return FALSE;
+        }
+        pthread_mutex_lock(&victim->lock);
+        if (victim->next < victim->end) {
+            uint64_t half = (victim->end - victim->next + 1) / 2;
+            uint64_t begin = victim->end - half;
+            __atomic_store_n(&victim->end, begin, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&victim->lock);
+
+            pthread_mutex_lock(&w->lock);
+            __atomic_store_n(&w->next, begin + 1, __ATOMIC_RELAXED);
+            __atomic_store_n(&w->end, begin + half, __ATOMIC_RELAXED);
+            pthread_mutex_unlock(&w->lock);
+            *game = begin;
+            return TRUE;
+        }
+        pthread_mutex_unlock(&victim->lock);
+    }
+}
+
+static void *WorkerMain(void *arg)
+{
+    Worker *w = arg;
+    GameResult result;
+    uint64_t game;
+    while (WorkerTakeGame(w, &game)) {
+        TournamentPlayGame(game, FALSE, NULL, &result);
+        w->stats.games++;
+        w->stats.flips += result.flips;
+        if (result.outcome == GAME_ABORTED) {
+            w->stats.aborted++;
+        } else {
+            w->stats.wins[result.outcome]++;
+            w->stats.shots[result.outcome] += result.shots;
+            w->stats.turns += result.turns;
+            w->stats.bytes += result.bytes;
+            w->stats.steps += result.steps;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Looks up a policy by name for the -a and -b options.
+ * @return TRUE if `name` was found and stored in `policy`.
+ */
+static int TournamentParsePolicy(const char *name, AgentPolicy *policy)
+{
+    size_t i;
+    for (i = 0; i < sizeof(TournamentPolicies) / sizeof(TournamentPolicies[0]); i++) {
+        if (strcmp(name, TournamentPolicies[i].name) == 0) {
+            *policy = TournamentPolicies[i].policy;
+            return TRUE;
+        }
+    }
+    fprintf(stderr, "unknown policy '%s'\n", name);
+    return FALSE;
+}
+
+/**
+ * Looks up a fleet source by name for the -f and -g options.
+ * @return TRUE if `name` was found and stored in `fleet`.
+ */
+static int TournamentParseFleet(const char *name, AgentFleet *fleet)
+{
+    size_t i;
+    for (i = 0; i < sizeof(TournamentFleets) / sizeof(TournamentFleets[0]); i++) {
+        if (strcmp(name, TournamentFleets[i]) == 0) {
+            *fleet = i;
+            return TRUE;
+        }
+    }
+    fprintf(stderr, "unknown fleet '%s'\n", name);
+    return FALSE;
+}
+
+/**
+ * Parses the -w option: one format for both agents, or two separated by a comma.
+ * @return TRUE if every format was known.
+ */
+static int TournamentParseWireFormats(const char *list)
+{
+    size_t i, p = 0, length;
+    while (p < 2) {
+        length = strcspn(list, ",");
+        for (i = 0; i < sizeof(TournamentWireFormats) / sizeof(TournamentWireFormats[0]); i++) {
+            if (strlen(TournamentWireFormats[i]) == length &&
+                    strncmp(list, TournamentWireFormats[i], length) == 0) {
+                break;
+            }
+        }
+        if (i == sizeof(TournamentWireFormats) / sizeof(TournamentWireFormats[0])) {
+            fprintf(stderr, "unknown wire format '%.*s'\n", (int) length, list);
+            return FALSE;
+        }
+        playerWire[p++] = i;
+        if (list[length] == '\0') {
+            break;
+        }
+        list += length + 1;
+    }
+    if (p == 1) {
+        playerWire[1] = playerWire[0];
+    }
+    return TRUE;
+}
+
+static const char *TournamentPolicyName(AgentPolicy policy)
+{
+    size_t i;
+    for (i = 0; i < sizeof(TournamentPolicies) / sizeof(TournamentPolicies[0]); i++) {
+        if (TournamentPolicies[i].policy == policy) {
+            return TournamentPolicies[i].name;
+        }
+    }
+    return "?";
+}
+
+static void TournamentReport(const TournamentStats *s, int threads, double seconds)
+{
+    int p;
+    uint64_t decided = s->wins[0] + s->wins[1];
+    printf("games            %llu (%llu aborted) on %d threads\n", (unsigned long long) s->games,
+            (unsigned long long) s->aborted, threads);
+    for (p = 0; p < 2; p++) {
+        printf("agent %c %-8s win rate %6.2f%%  mean shots-to-win %6.2f  fleet %s\n", 'A' + p,
+                TournamentPolicyName(playerPolicy[p]),
+                decided ? 100.0 * s->wins[p] / decided : 0.0,
+                s->wins[p] ? (double) s->shots[p] / s->wins[p] : 0.0,
+                TournamentFleets[playerFleet[p]]);
+    }
+    printf("overall          mean shots-to-win %6.2f\n",
+            decided ? (double) (s->shots[0] + s->shots[1]) / decided : 0.0);
+    if (s->turns) {
+        //a UART byte is 10 bits on the wire with its start and stop bits
+        double bytes = (double) s->bytes / s->turns;
+        printf("wire             %.2f bytes/turn, %.0f us/turn at %d baud (%s/%s)\n", bytes,
+                bytes * 10 * 1e6 / UART_BAUD_RATE, UART_BAUD_RATE,
+                TournamentWireFormats[playerWire[0]], TournamentWireFormats[playerWire[1]]);
+    }
+    if (bitErrorRate > 0 || s->aborted) {
+        printf("link             %.2f%% completed, %.0f steps/game, bit error rate %g (%llu flips), "
+                "NAKs %s\n", s->games ? 100.0 * decided / s->games : 0.0,
+                decided ? (double) s->steps / decided : 0.0, bitErrorRate,
+                (unsigned long long) s->flips, offerNak ? "on" : "off");
+    }
+    printf("throughput       %.0f games/s (%.3f s)\n", s->games / seconds, seconds);
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t games = TOURNAMENT_DEFAULT_GAMES;
+    long replay = -1;
+    TournamentStats total;
+    struct timespec start, end;
+    double seconds;
+    int opt, i;
+
+    workerCount = sysconf(_SC_NPROCESSORS_ONLN);
+    while ((opt = getopt(argc, argv, "n:t:s:r:a:b:f:g:w:e:NBj")) != -1) {
+        switch (opt) {
+        case 'n':
+            games = strtoull(optarg, NULL, 0);
+            break;
+        case 't':
+            workerCount = atoi(optarg);
+            break;
+        case 's':
+            tournamentSeed = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            replay = atol(optarg);
+            break;
+        case 'B':
+            batchInput = TRUE;
+            break;
+        case 'e':
+            bitErrorRate = atof(optarg);
+            break;
+        case 'N':
+            offerNak = FALSE;
+            break;
+        case 'j':
+            recordJournals = TRUE;
+            break;
+        case 'a':
+        case 'b':
+            if (!TournamentParsePolicy(optarg, &playerPolicy[opt - 'a'])) {
+                return 1;
+            }
+            break;
+        case 'f':
+        case 'g':
+            if (!TournamentParseFleet(optarg, &playerFleet[opt - 'f'])) {
+                return 1;
+            }
+            break;
+        case 'w':
+            if (!TournamentParseWireFormats(optarg)) {
+                return 1;
+            }
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n games] [-t threads] [-s seed] [-r game] "
+                    "[-a policy] [-b policy] [-f fleet] [-g fleet] [-w format[,format]] [-e rate] "
+                    "[-N] [-B] [-j]\n", argv[0]);
+            return 1;
+        }
+    }
+#ifdef PROFILE_ENABLED
+    workerCount = 1;
+#endif
+    if (workerCount < 1) {
+        workerCount = 1;
+    } else if (workerCount > TOURNAMENT_MAX_THREADS) {
+        workerCount = TOURNAMENT_MAX_THREADS;
+    }
+
+    if (replay >= 0) {
+        //too big for the stack
+        static Journal journals[2];
+        GameResult result;
+        TournamentPlayGame(replay, TRUE, recordJournals ? journals : NULL, &result);
+        printf("game %ld: %s after %u steps, %u shots\n", replay,
+                result.outcome == GAME_ABORTED ? "aborted" :
+                result.outcome == GAME_WON_BY_A ? "A won" : "B won", result.steps, result.shots);
+        if (recordJournals) {
+            JournalDump(&journals[0]);
+            JournalDump(&journals[1]);
+        }
+        PROFILE_REPORT();
+        return 0;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < workerCount; i++) {
+        pthread_mutex_init(&workers[i].lock, NULL);
+        workers[i].next = games * i / workerCount;
+        workers[i].end = games * (i + 1) / workerCount;
+        memset(&workers[i].stats, 0, sizeof(workers[i].stats));
+    }
+    for (i = 0; i < workerCount; i++) {
+        pthread_create(&workers[i].thread, NULL, WorkerMain, &workers[i]);
+    }
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < workerCount; i++) {
+        pthread_join(workers[i].thread, NULL);
+        total.games += workers[i].stats.games;
+        total.aborted += workers[i].stats.aborted;
+        total.wins[0] += workers[i].stats.wins[0];
+        total.wins[1] += workers[i].stats.wins[1];
+        total.shots[0] += workers[i].stats.shots[0];
+        total.shots[1] += workers[i].stats.shots[1];
+        total.turns += workers[i].stats.turns;
+        total.bytes += workers[i].stats.bytes;
+        total.steps += workers[i].stats.steps;
+        total.flips += workers[i].stats.flips;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    TournamentReport(&total, workerCount, seconds);
+    PROFILE_REPORT();
+    return 0;
+}
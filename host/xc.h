@@ -0,0 +1,17 @@
+#ifndef XC_H
+#define XC_H
+
+/**
+ * Host stand-in for the Microchip <xc.h> device header. Only the special function registers that
+ * the game sources and support headers actually touch are declared here, as plain variables
+ * defined in HostHal.c, so that LEDS_SET(), BUTTON_STATES() and friends compile unchanged on a
+ * desktop machine.
+ */
+
+#include <stdint.h>
+
+extern volatile uint32_t TRISE, LATE;
+extern volatile uint32_t TRISD, PORTD;
+extern volatile uint32_t TRISF, PORTF, LATF;
+
+#endif // XC_H